@@ -375,6 +375,11 @@ struct GCEVENT
 
 EXTERN_C MIR_APP_DLL(int) Chat_Event(GCEVENT*);
 
+// adds nCount users to the nick list of a session at once, sorting it only once.
+// every item is processed as GC_EVENT_JOIN with time = 0, only its wide pszNick, pszUID,
+// pszStatus & bIsMe are used; a non-zero dwItemData sets the contact status too
+EXTERN_C MIR_APP_DLL(int) Chat_AddUsers(const char *szModule, const wchar_t *wszId, const GCEVENT *pUsers, int nCount);
+
 EXTERN_C MIR_APP_DLL(void*) Chat_GetUserInfo(const char *szModule, const wchar_t *wszId);
 EXTERN_C MIR_APP_DLL(int) Chat_SetUserInfo(const char *szModule, const wchar_t *wszId, void *pItemData);
 
@@ -122,6 +122,10 @@ struct LOGINFO
 	time_t   time;
 	int      iType;
 	LOGINFO *next, *prev;
+
+	char    *pszRtf;          // cached RTF fragment, rebuilt when iRtfGen gets outdated
+	int      cbRtfHead;       // length of its part before the timestamp
+	int      iRtfGen;
 };
 
 struct STATUSINFO
@@ -163,6 +167,7 @@ struct MIR_APP_EXPORT GCSessionInfoBase : public MZeroedObject, public MNonCopya
 
 	CMsgDialog *pDlg;
 	LOGINFO *pLog, *pLogEnd;
+	void    *pLogChunk;       // current chunk of the events' arena
 	USERINFO *pMe;
 	STATUSINFO *pStatuses;
 	MODULEINFO *pMI;
@@ -96,6 +96,15 @@ EXTERN_C MIR_APP_DLL(bool) Contact_OnList(MCONTACT hContact);
 EXTERN_C MIR_APP_DLL(void) Contact_PutOnList(MCONTACT hContact);
 EXTERN_C MIR_APP_DLL(void) Contact_RemoveFromList(MCONTACT hContact);
 
+/////////////////////////////////////////////////////////////////////////////////////////
+// finds an account's contact by the value of its unique id setting (see Proto_GetUniqueId)
+// uses an index maintained by the core, so there's no need to scan all contacts
+// numeric ids are compared as decimal strings, text ones - in utf8
+// returns 0 if not found
+
+EXTERN_C MIR_APP_DLL(MCONTACT) Contact_FindByUniqueId(const char *szProto, const char *pszUniqueId);
+EXTERN_C MIR_APP_DLL(MCONTACT) Contact_FindByUniqueIdInt(const char *szProto, uint32_t dwUniqueId);
+
 /////////////////////////////////////////////////////////////////////////////////////////
 // Add contact's dialog
 
@@ -496,6 +496,49 @@ MIR_CORE_DLL(void) Thread_SetName(const char *szThreadName);
 
 MIR_CORE_DLL(void) KillObjectThreads(void* pObject);
 
+///////////////////////////////////////////////////////////////////////////////
+// shared thread pool
+//
+// short background jobs (avatar fetches, searches, one-shot HTTP requests) should
+// be queued to the pool instead of creating a thread with mir_forkthread.
+// if an owner is specified, KillObjectThreads(owner) cancels its queued tasks and
+// waits for the running ones. unlike threads, tasks are never killed, so it waits for
+// them without a timeout: a long task must check Task_IsCancelled() from time to time
+
+#define TASK_PRIORITY_LOW    0
+#define TASK_PRIORITY_NORMAL 1
+#define TASK_PRIORITY_HIGH   2
+
+#if defined( __cplusplus )
+// queues a task, returns 0 on error
+MIR_CORE_DLL(int) mir_forktask(pThreadFunc aFunc, void *arg = nullptr, void *owner = nullptr, int iPriority = TASK_PRIORITY_NORMAL);
+
+// queues a task and returns its handle, that must be freed with Task_Close
+MIR_CORE_DLL(HANDLE) Task_Create(pThreadFunc aFunc, void *arg = nullptr, void *owner = nullptr, int iPriority = TASK_PRIORITY_NORMAL);
+
+// waits till the task finishes or gets cancelled: WAIT_OBJECT_0, WAIT_TIMEOUT or WAIT_FAILED.
+// being called from a pool task, executes other tasks meanwhile instead of blocking a worker
+MIR_CORE_DLL(int) Task_Wait(HANDLE hTask, uint32_t dwTimeout = INFINITE);
+#else
+MIR_CORE_DLL(int) mir_forktask(pThreadFunc aFunc, void *arg, void *owner, int iPriority);
+MIR_CORE_DLL(HANDLE) Task_Create(pThreadFunc aFunc, void *arg, void *owner, int iPriority);
+MIR_CORE_DLL(int) Task_Wait(HANDLE hTask, uint32_t dwTimeout);
+#endif
+
+// queues a continuation to be run after hTask is finished, with the same owner & priority.
+// if hTask is cancelled, the continuation is cancelled too. returns a new handle
+MIR_CORE_DLL(HANDLE) Task_Then(HANDLE hTask, pThreadFunc aFunc, void *arg);
+
+// frees a task's handle, doesn't affect the task itself
+MIR_CORE_DLL(void) Task_Close(HANDLE hTask);
+
+// removes all queued tasks of the owner, marks the running ones as cancelled and waits
+// for them dwTimeout msecs. returns the number of tasks removed from queues
+MIR_CORE_DLL(int) Task_CancelOwner(void *owner, uint32_t dwTimeout);
+
+// being called from a pool task, returns true if its owner is being cancelled
+MIR_CORE_DLL(bool) Task_IsCancelled(void);
+
 ///////////////////////////////////////////////////////////////////////////////
 // utf8 interface
 
@@ -177,6 +177,7 @@ struct CRYPTO_PROVIDER;
 class MIR_APP_EXPORT MDatabaseCommon : public MIDatabase, public MNonCopyable
 {
 	HANDLE m_hLock = nullptr;
+	struct CEventIdFilter *m_pEventIdFilter;
 
 protected:
 	bool m_bEncrypted = false, m_bUsesPassword = false;
@@ -193,6 +194,13 @@ protected:
 	bool LockName(const wchar_t *pwszProfileName);
 	void UnlockName();
 
+	// in-memory Bloom filter over server ids of events. a driver fills it when a
+	// profile is opened and updates it on each write, then EventIdFilterCheck()
+	// returning false means that there's surely no such id in the database
+	void EventIdFilterInit(uint32_t nExpected);
+	void EventIdFilterAdd(const char *szId);
+	bool EventIdFilterCheck(const char *szId);
+
 	STDMETHOD_(BOOL, GetContactSettingWorker)(MCONTACT contactID, LPCSTR szModule, LPCSTR szSetting, DBVARIANT *dbv, int isStatic);
 	STDMETHOD_(BOOL, WriteContactSettingWorker)(MCONTACT contactID, DBCONTACTWRITESETTING &dbcws) PURE;
 
@@ -716,6 +716,38 @@ struct NETLIBPACKETRECVER
 
 EXTERN_C MIR_APP_DLL(int) Netlib_GetMorePackets(HANDLE hReceiver, NETLIBPACKETRECVER *nlprParam);
 
+/////////////////////////////////////////////////////////////////////////////////////////
+// Create a buffered stream reader
+//
+// Returns a HANDLE on success, NULL on failure
+// The stream reader fills its buffer with one large MS_NETLIB_RECV and serves small
+// reads (packet headers, lengths etc) from memory, so that a protocol doesn't pay
+// for a full netlib round trip for every byte. iBufSize = 0 means the default size,
+// the buffer grows if a peek requires more. flags are passed to MS_NETLIB_RECV.
+// Data read by the reader but not consumed yet isn't visible to Netlib_Select, so
+// check Netlib_StreamPending() before waiting on a connection.
+// Closing the stream reader via Netlib_CloseHandle doesn't close the connection,
+// but discards any buffered data.
+// Errors: ERROR_INVALID_PARAMETER
+
+EXTERN_C MIR_APP_DLL(HANDLE) Netlib_CreateStreamReader(HNETLIBCONN hConnection, int iBufSize = 0, int flags = 0);
+
+// Returns the number of buffered bytes, that can be read without touching a socket
+EXTERN_C MIR_APP_DLL(int) Netlib_StreamPending(HANDLE hReader);
+
+// All these functions return the number of bytes processed on success, SOCKET_ERROR
+// on failure, 0 if the connection has been closed
+
+// copies exactly len bytes into buf without removing them from the stream
+EXTERN_C MIR_APP_DLL(int) Netlib_StreamPeek(HANDLE hReader, void *buf, int len);
+
+// reads exactly len bytes into buf
+EXTERN_C MIR_APP_DLL(int) Netlib_StreamRead(HANDLE hReader, void *buf, int len);
+
+// reads a variable length integer (7 bits per byte, least significant group first,
+// high bit set means continuation), as used by MQTT & protobuf
+EXTERN_C MIR_APP_DLL(int) Netlib_StreamReadVarInt(HANDLE hReader, uint32_t *pValue);
+
 /////////////////////////////////////////////////////////////////////////////////////////
 // Sets a gateway polling timeout interval
 //
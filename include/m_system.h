@@ -487,6 +487,9 @@ public:
 	// adds a buffer to the beginning
 	void appendBefore(const void *pBuf, size_t bufLen);
 
+	// adds bufLen uninitialized bytes to the end, returns a pointer to them or nullptr
+	char* appendSpace(size_t bufLen);
+
 	// replaces buffer contents
 	void assign(const void *pBuf, size_t bufLen);
 
@@ -33,10 +33,12 @@ CacheNode::~CacheNode()
 void CacheNode::wipeInfo()
 {
 	MCONTACT saveContact = hContact;
+	bool saveLoading = bLoading;
 	if (hbmPic)
 		DeleteObject(hbmPic);
 	memset(this, 0, sizeof(CacheNode));
 	hContact = saveContact;
+	bLoading = saveLoading;
 }
 
 static int CompareNodes(const CacheNode *p1, const CacheNode *p2)
@@ -216,76 +218,112 @@ int SetAvatarAttribute(MCONTACT hContact, uint32_t attrib, int mode)
 	return 0;
 }
 
-// this thread scans the cache and handles nodes which have mustLoad set to > 0 (must be loaded/reloaded) or
-// nodes where mustLoad is < 0 (must be deleted).
-// its waken up by the event and tries to lock the cache only when absolutely necessary.
+// loads one node in a pool task. nodes being loaded are marked with bLoading, so that
+// the same contact isn't processed by two tasks simultaneously
 
-void PicLoader(LPVOID)
+static volatile long g_iLoaders;
+
+static void LoadNode(CacheNode *node)
 {
-	Thread_SetName("AVS: PicLoader");
-	MThreadLock threadLock(hLoaderThread);
+	if (db_get_b(node->hContact, "ContactPhoto", "NeedUpdate", 0))
+		QueueAdd(node->hContact);
 
-	uint32_t dwDelay = g_plugin.getDword("picloader_sleeptime", 80);
+	AVATARCACHEENTRY ace_temp;
+	memcpy(&ace_temp, node, sizeof(AVATARCACHEENTRY));
+	ace_temp.hbmPic = nullptr;
 
-	if (dwDelay < 30)
-		dwDelay = 30;
-	else if (dwDelay > 100)
-		dwDelay = 100;
+	int result = CreateAvatarInCache(node->hContact, &ace_temp, nullptr);
+	if (result == -2) {
+		char *szProto = Proto_GetBaseAccountName(node->hContact);
+		if (szProto == nullptr || Proto_NeedDelaysForAvatars(szProto))
+			QueueAdd(node->hContact);
+		else if (FetchAvatarFor(node->hContact, szProto) == GAIR_SUCCESS) // Try to create again
+			result = CreateAvatarInCache(node->hContact, &ace_temp, nullptr);
+	}
 
-	while (!g_shutDown) {
-		CacheNode *node;
+	if (result == 1 && ace_temp.hbmPic != nullptr) { // Loaded
+		HBITMAP oldPic = node->hbmPic;
 		{
-			mir_cslock all(alloccs);
-			node = arQueue[0];
-			if (node)
-				arQueue.remove(0);
+			mir_cslock l(cachecs);
+			memcpy(node, &ace_temp, sizeof(AVATARCACHEENTRY));
+			node->bLoaded = true;
+		}
+		if (oldPic)
+			DeleteObject(oldPic);
+		NotifyMetaAware(node->hContact, node);
+	}
+	else if (result == 0 || result == -3) { // Has no avatar
+		HBITMAP oldPic = node->hbmPic;
+		{
+			mir_cslock l(cachecs);
+			memcpy(node, &ace_temp, sizeof(AVATARCACHEENTRY));
+			node->bLoaded = false;
 		}
+		if (oldPic)
+			DeleteObject(oldPic);
+		NotifyMetaAware(node->hContact, node);
+	}
+}
+
+static void __cdecl LoaderTask(void *param)
+{
+	CacheNode *node = (CacheNode *)param;
+	if (!g_shutDown && !Task_IsCancelled())
+		LoadNode(node);
+	{
+		mir_cslock all(alloccs);
+		node->bLoading = false;
+	}
+
+	InterlockedDecrement(&g_iLoaders);
+	SetEvent(hLoaderEvent);
+}
+
+static CacheNode* PopNode()
+{
+	mir_cslock all(alloccs);
+	for (auto &it : arQueue) {
+		if (it->bLoading) // will be taken when the current task finishes
+			continue;
+
+		CacheNode *node = it;
+		arQueue.removeItem(&it);
+		node->bLoading = true;
+		return node;
+	}
+	return nullptr;
+}
+
+// this thread scans the queue and passes nodes which must be loaded/reloaded to the pool,
+// keeping not more than LoaderThreads tasks running at once.
+// its waken up by the event, either when a node is queued or when a task is finished.
+
+void PicLoader(LPVOID)
+{
+	Thread_SetName("AVS: PicLoader");
+	MThreadLock threadLock(hLoaderThread);
+
+	SYSTEM_INFO si;
+	GetSystemInfo(&si);
+	long iMaxLoaders = g_plugin.getByte("LoaderThreads", 0);
+	if (iMaxLoaders <= 0)
+		iMaxLoaders = min(4, max(1, (long)si.dwNumberOfProcessors - 1));
 
+	while (!g_shutDown) {
+		CacheNode *node = (g_iLoaders < iMaxLoaders) ? PopNode() : nullptr;
 		if (node == nullptr) {
 			WaitForSingleObject(hLoaderEvent, INFINITE);
 			ResetEvent(hLoaderEvent);
 			continue;
 		}
 
-		if (db_get_b(node->hContact, "ContactPhoto", "NeedUpdate", 0))
-			QueueAdd(node->hContact);
-
-		AVATARCACHEENTRY ace_temp;
-		memcpy(&ace_temp, node, sizeof(AVATARCACHEENTRY));
-		ace_temp.hbmPic = nullptr;
-
-		int result = CreateAvatarInCache(node->hContact, &ace_temp, nullptr);
-		if (result == -2) {
-			char *szProto = Proto_GetBaseAccountName(node->hContact);
-			if (szProto == nullptr || Proto_NeedDelaysForAvatars(szProto))
-				QueueAdd(node->hContact);
-			else if (FetchAvatarFor(node->hContact, szProto) == GAIR_SUCCESS) // Try to create again
-				result = CreateAvatarInCache(node->hContact, &ace_temp, nullptr);
-		}
-
-		if (result == 1 && ace_temp.hbmPic != nullptr) { // Loaded
-			HBITMAP oldPic = node->hbmPic;
-			{
-				mir_cslock l(cachecs);
-				memcpy(node, &ace_temp, sizeof(AVATARCACHEENTRY));
-				node->bLoaded = true;
-			}
-			if (oldPic)
-				DeleteObject(oldPic);
-			NotifyMetaAware(node->hContact, node);
-		}
-		else if (result == 0 || result == -3) { // Has no avatar
-			HBITMAP oldPic = node->hbmPic;
-			{
-				mir_cslock l(cachecs);
-				memcpy(node, &ace_temp, sizeof(AVATARCACHEENTRY));
-				node->bLoaded = false;
-			}
-			if (oldPic)
-				DeleteObject(oldPic);
-			NotifyMetaAware(node->hContact, node);
+		InterlockedIncrement(&g_iLoaders);
+		if (!mir_forktask(LoaderTask, node, &g_plugin, TASK_PRIORITY_LOW)) {
+			InterlockedDecrement(&g_iLoaders);
+			mir_cslock all(alloccs);
+			node->bLoading = false;
+			arQueue.insert(node);
+			break;
 		}
-
-		mir_sleep(dwDelay);
 	}
 }
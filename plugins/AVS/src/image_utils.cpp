@@ -159,6 +159,8 @@ void SetHIMETRICtoDP(HDC hdc, SIZE* sz)
 	sz->cy = pt.y;
 }
 
+#define THUMB_MAX_SIZE 128 // pictures are scaled down to this size
+
 HBITMAP BmpFilterLoadBitmap(BOOL *bIsTransparent, const wchar_t *ptszFilename)
 {
 	FIBITMAP *dib = (FIBITMAP*)Image_Load(ptszFilename, IMGL_RETURNDIB);
@@ -179,8 +181,8 @@ HBITMAP BmpFilterLoadBitmap(BOOL *bIsTransparent, const wchar_t *ptszFilename)
 		if (bIsTransparent)
 			*bIsTransparent = TRUE;
 
-	if (FreeImage_GetWidth(dib32) > 128 || FreeImage_GetHeight(dib32) > 128) {
-		FIBITMAP *dib_new = FreeImage_MakeThumbnail(dib32, 128, FALSE);
+	if (FreeImage_GetWidth(dib32) > THUMB_MAX_SIZE || FreeImage_GetHeight(dib32) > THUMB_MAX_SIZE) {
+		FIBITMAP *dib_new = FreeImage_MakeThumbnail(dib32, THUMB_MAX_SIZE, FALSE);
 		FreeImage_Unload(dib32);
 		if (dib_new == nullptr)
 			return nullptr;
@@ -193,6 +195,223 @@ HBITMAP BmpFilterLoadBitmap(BOOL *bIsTransparent, const wchar_t *ptszFilename)
 	return bitmap;
 }
 
+/////////////////////////////////////////////////////////////////////////////////////////
+// thumbnails cache
+// decoded & scaled 32bpp bitmaps are stored in %miranda_userdata%\AvatarCache, so that
+// the next start doesn't decode them again. a thumbnail is keyed by the source's content
+// hash, its size & the requested dimensions, the header repeats them to be verified.
+// each hit refreshes the file's time, so that the pruning removes unused ones only
+
+#define THUMB_SIGNATURE 0x4D485441 // 'ATHM'
+#define THUMB_VERSION   3
+#define THUMB_MAX_FILE  (16 * 1024 * 1024) // larger pictures aren't cached
+
+struct ThumbHeader
+{
+	uint32_t dwSignature, dwVersion;
+	uint32_t dwFileHash, dwFileSize;
+	int32_t  iMaxSize;
+	int32_t  iWidth, iHeight;
+	uint32_t bTransparent;
+};
+
+static uint32_t GetContentHash(const wchar_t *pwszFile, uint32_t cbSize)
+{
+	HANDLE hFile = CreateFileW(pwszFile, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (hFile == INVALID_HANDLE_VALUE)
+		return 0;
+
+	uint32_t dwHash = 0;
+	mir_ptr<uint8_t> pBuf((uint8_t *)mir_alloc(cbSize));
+	DWORD dwRead = 0;
+	if (pBuf && ReadFile(hFile, pBuf, cbSize, &dwRead, nullptr) && dwRead == cbSize)
+		dwHash = mir_hash(pBuf, cbSize);
+
+	CloseHandle(hFile);
+	return dwHash;
+}
+
+static void TouchThumb(const wchar_t *pwszThumb)
+{
+	HANDLE hFile = CreateFileW(pwszThumb, FILE_WRITE_ATTRIBUTES, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, 0, nullptr);
+	if (hFile == INVALID_HANDLE_VALUE)
+		return;
+
+	FILETIME ft;
+	GetSystemTimeAsFileTime(&ft);
+	SetFileTime(hFile, nullptr, nullptr, &ft);
+	CloseHandle(hFile);
+}
+
+static HBITMAP LoadThumb(const wchar_t *pwszThumb, const ThumbHeader &hdr, BOOL *bIsTransparent)
+{
+	FILE *in = _wfopen(pwszThumb, L"rb");
+	if (in == nullptr)
+		return nullptr;
+
+	HBITMAP hBmp = nullptr;
+	ThumbHeader tmp;
+	if (fread(&tmp, sizeof(tmp), 1, in) == 1 && tmp.dwSignature == THUMB_SIGNATURE && tmp.dwVersion == THUMB_VERSION) {
+		if (tmp.dwFileHash == hdr.dwFileHash && tmp.dwFileSize == hdr.dwFileSize && tmp.iMaxSize == hdr.iMaxSize
+			&& tmp.iWidth > 0 && tmp.iWidth <= hdr.iMaxSize && tmp.iHeight > 0 && tmp.iHeight <= hdr.iMaxSize) {
+			BITMAPINFO bmi = {};
+			bmi.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+			bmi.bmiHeader.biWidth = tmp.iWidth;
+			bmi.bmiHeader.biHeight = tmp.iHeight;
+			bmi.bmiHeader.biPlanes = 1;
+			bmi.bmiHeader.biBitCount = 32;
+			bmi.bmiHeader.biCompression = BI_RGB;
+
+			void *pBits = nullptr;
+			hBmp = CreateDIBSection(nullptr, &bmi, DIB_RGB_COLORS, &pBits, nullptr, 0);
+			if (hBmp != nullptr) {
+				size_t cbPixels = size_t(tmp.iWidth) * tmp.iHeight;
+				if (pBits == nullptr || fread(pBits, 4, cbPixels, in) != cbPixels) {
+					DeleteObject(hBmp);
+					hBmp = nullptr;
+				}
+				else if (tmp.bTransparent && bIsTransparent)
+					*bIsTransparent = TRUE;
+			}
+		}
+	}
+
+	fclose(in);
+	return hBmp;
+}
+
+static void SaveThumb(const wchar_t *pwszThumb, ThumbHeader &hdr, HBITMAP hBmp, BOOL bIsTransparent)
+{
+	DIBSECTION ds;
+	if (GetObject(hBmp, sizeof(ds), &ds) != sizeof(ds) || ds.dsBm.bmBits == nullptr || ds.dsBm.bmBitsPixel != 32)
+		return;
+
+	hdr.iWidth = ds.dsBm.bmWidth;
+	hdr.iHeight = ds.dsBm.bmHeight;
+	hdr.bTransparent = bIsTransparent != 0;
+
+	// several loaders might cache the same picture at once, so we write a temporary file first
+	wchar_t wszTemp[MAX_PATH];
+	mir_snwprintf(wszTemp, L"%s.%u", pwszThumb, GetCurrentThreadId());
+
+	FILE *out = _wfopen(wszTemp, L"wb");
+	if (out == nullptr) {
+		CreatePathToFileW(wszTemp);
+		if ((out = _wfopen(wszTemp, L"wb")) == nullptr)
+			return;
+	}
+
+	size_t cbPixels = size_t(hdr.iWidth) * hdr.iHeight;
+	bool bOk = fwrite(&hdr, sizeof(hdr), 1, out) == 1 && fwrite(ds.dsBm.bmBits, 4, cbPixels, out) == cbPixels;
+	fclose(out);
+
+	if (!bOk || !MoveFileExW(wszTemp, pwszThumb, MOVEFILE_REPLACE_EXISTING))
+		DeleteFileW(wszTemp);
+}
+
+HBITMAP BmpFilterLoadCached(BOOL *bIsTransparent, const wchar_t *ptszFilename)
+{
+	if (!g_plugin.getByte("ThumbCache", 1))
+		return BmpFilterLoadBitmap(bIsTransparent, ptszFilename);
+
+	WIN32_FILE_ATTRIBUTE_DATA fad;
+	if (!GetFileAttributesExW(ptszFilename, GetFileExInfoStandard, &fad) || fad.nFileSizeHigh != 0 || fad.nFileSizeLow == 0 || fad.nFileSizeLow > THUMB_MAX_FILE)
+		return BmpFilterLoadBitmap(bIsTransparent, ptszFilename);
+
+	ThumbHeader hdr = {};
+	hdr.dwSignature = THUMB_SIGNATURE;
+	hdr.dwVersion = THUMB_VERSION;
+	hdr.dwFileSize = fad.nFileSizeLow;
+	hdr.dwFileHash = GetContentHash(ptszFilename, hdr.dwFileSize);
+	hdr.iMaxSize = THUMB_MAX_SIZE;
+	if (hdr.dwFileHash == 0)
+		return BmpFilterLoadBitmap(bIsTransparent, ptszFilename);
+
+	wchar_t wszThumb[MAX_PATH];
+	mir_snwprintf(wszThumb, L"%sAvatarCache\\%08x%08x_%d.thumb", g_szDataPath, hdr.dwFileHash, hdr.dwFileSize, hdr.iMaxSize);
+
+	HBITMAP hBmp = LoadThumb(wszThumb, hdr, bIsTransparent);
+	if (hBmp != nullptr) {
+		TouchThumb(wszThumb);
+		return hBmp;
+	}
+
+	BOOL bTransparent = FALSE;
+	hBmp = BmpFilterLoadBitmap(&bTransparent, ptszFilename);
+	if (hBmp == nullptr)
+		return nullptr;
+
+	SaveThumb(wszThumb, hdr, hBmp, bTransparent);
+	if (bTransparent && bIsTransparent)
+		*bIsTransparent = TRUE;
+	return hBmp;
+}
+
+// called once at startup: removes thumbnails that weren't used for ThumbCacheDays days,
+// and then the oldest ones till the cache fits ThumbCacheSize megabytes
+
+struct ThumbFile
+{
+	ThumbFile(const wchar_t *pwszName, const FILETIME &ft, uint32_t _size) :
+		wszName(pwszName),
+		qwTime((uint64_t(ft.dwHighDateTime) << 32) | ft.dwLowDateTime),
+		dwSize(_size)
+	{}
+
+	CMStringW wszName;
+	uint64_t qwTime;
+	uint32_t dwSize;
+};
+
+static int CompareThumbFiles(const ThumbFile *p1, const ThumbFile *p2)
+{
+	if (p1->qwTime != p2->qwTime)
+		return (p1->qwTime < p2->qwTime) ? -1 : 1;
+	return mir_wstrcmp(p1->wszName, p2->wszName);
+}
+
+void __cdecl PruneThumbsTask(void *)
+{
+	CMStringW wszPath(FORMAT, L"%sAvatarCache\\", g_szDataPath);
+
+	WIN32_FIND_DATAW fd;
+	HANDLE hFind = FindFirstFileW(wszPath + L"*.thumb*", &fd);
+	if (hFind == INVALID_HANDLE_VALUE)
+		return;
+
+	FILETIME ftNow;
+	GetSystemTimeAsFileTime(&ftNow);
+	uint64_t qwExpired = (uint64_t(ftNow.dwHighDateTime) << 32) | ftNow.dwLowDateTime;
+	qwExpired -= uint64_t(g_plugin.getWord("ThumbCacheDays", 30)) * 24 * 3600 * 10000000; // in 100 ns units
+
+	OBJLIST<ThumbFile> arFiles(50, CompareThumbFiles);
+	uint64_t cbTotal = 0;
+	do {
+		if (fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+			continue;
+
+		auto *p = new ThumbFile(fd.cFileName, fd.ftLastWriteTime, fd.nFileSizeLow);
+		if (p->qwTime < qwExpired) {
+			DeleteFileW(wszPath + p->wszName);
+			delete p;
+			continue;
+		}
+
+		arFiles.insert(p);
+		cbTotal += p->dwSize;
+	} while (FindNextFileW(hFind, &fd) && !Task_IsCancelled());
+	FindClose(hFind);
+
+	uint64_t cbMax = uint64_t(g_plugin.getWord("ThumbCacheSize", 16)) * 1024 * 1024;
+	for (auto &it : arFiles) {
+		if (cbTotal <= cbMax || Task_IsCancelled())
+			break;
+
+		if (DeleteFileW(wszPath + it->wszName))
+			cbTotal -= it->dwSize;
+	}
+}
+
 static HWND hwndClui = nullptr;
 
 //
@@ -2,6 +2,8 @@
 # define __IMAGE_UTILS_H__
 
 HBITMAP BmpFilterLoadBitmap(BOOL *bIsTransparent, const wchar_t *ptszFilename);
+HBITMAP BmpFilterLoadCached(BOOL *bIsTransparent, const wchar_t *ptszFilename);
+void    __cdecl PruneThumbsTask(void *);
 int     BmpFilterSaveBitmap(HBITMAP hBmp, const wchar_t *ptszFile, int flags);
 
 HBITMAP CopyBitmapTo32(HBITMAP hBitmap);
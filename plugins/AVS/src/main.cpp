@@ -316,6 +316,7 @@ static int ModulesLoaded(WPARAM, LPARAM)
 	hLoaderEvent = CreateEvent(nullptr, TRUE, FALSE, szEventName);
 
 	SetThreadPriority(mir_forkthread(PicLoader), THREAD_PRIORITY_IDLE);
+	mir_forktask(PruneThumbsTask, nullptr, &g_plugin, TASK_PRIORITY_LOW);
 
 	// Folders plugin support
 	hMyAvatarsFolder = FoldersRegisterCustomPathW(LPGEN("Avatars"), LPGEN("My Avatars"), MIRANDA_USERDATAW L"\\Avatars");
@@ -378,15 +379,18 @@ int CMPlugin::Unload()
 	UnregisterClassW(AVATAR_CONTROL_CLASS, 0);
 
 	UninitPolls();
+
+	// the loader must be stopped before the cache is destroyed
+	if (hLoaderThread)
+		WaitForSingleObject(hLoaderThread, INFINITE);
+	Task_CancelOwner(&g_plugin, INFINITE);
+
 	UnloadCache();
 
 	DestroyHookableEvent(hEventChanged);
 	DestroyHookableEvent(hEventContactAvatarChanged);
 	DestroyHookableEvent(hMyAvatarChanged);
 
-	if (hLoaderThread)
-		WaitForSingleObject(hLoaderThread, INFINITE);
-
 	CloseHandle(hLoaderEvent);
 	CloseHandle(hShutdownEvent);
 	return 0;
@@ -183,6 +183,54 @@ void ProcessAvatarInfo(MCONTACT hContact, int type, PROTO_AVATAR_INFORMATION *pa
 	}
 }
 
+// avatar requests might come from several loader tasks at once, and protocols don't
+// expect that. so only one thread at a time talks to a protocol, the others put their
+// contacts into the protocol's queue, and that thread requests them after its own one
+
+struct ProtoQueue
+{
+	ProtoQueue(const char *_proto) :
+		szProto(mir_strdup(_proto)),
+		arPending(10, HandleKeySortT)
+	{}
+
+	~ProtoQueue()
+	{
+		mir_free(szProto);
+	}
+
+	char *szProto;
+	bool bBusy = false;
+	LIST<void> arPending;
+};
+
+static OBJLIST<ProtoQueue> arProtoQueues(5);
+static mir_cs csProtoQueues;
+
+static ProtoQueue* GetProtoQueue(const char *szProto)
+{
+	for (auto &it : arProtoQueues)
+		if (!mir_strcmp(it->szProto, szProto))
+			return it;
+
+	ProtoQueue *pq = new ProtoQueue(szProto);
+	arProtoQueues.insert(pq);
+	return pq;
+}
+
+static int RequestAvatarInfo(MCONTACT hContact, const char *szProto)
+{
+	int result = GAIR_NOAVATAR;
+
+	PROTO_AVATAR_INFORMATION ai = { 0 };
+	ai.hContact = hContact;
+	INT_PTR res = CallProtoService(szProto, PS_GETAVATARINFO, GAIF_FORCE, (LPARAM)&ai);
+	if (res != CALLSERVICE_NOTFOUND)
+		result = res;
+	ProcessAvatarInfo(ai.hContact, result, &ai, szProto);
+	return result;
+}
+
 int FetchAvatarFor(MCONTACT hContact, char *szProto)
 {
 	int result = GAIR_NOAVATAR;
@@ -194,13 +242,36 @@ int FetchAvatarFor(MCONTACT hContact, char *szProto)
 		// Can have avatar, but must request it?
 		if ((g_AvatarHistoryAvail && CallService(MS_AVATARHISTORY_ENABLED, hContact, 0)) || (PollCheckProtocol(szProto) && PollCheckContact(hContact)))
 		{
-			// Request it
-			PROTO_AVATAR_INFORMATION ai = { 0 };
-			ai.hContact = hContact;
-			INT_PTR res = CallProtoService(szProto, PS_GETAVATARINFO, GAIF_FORCE, (LPARAM)&ai);
-			if (res != CALLSERVICE_NOTFOUND)
-				result = res;
-			ProcessAvatarInfo(ai.hContact, result, &ai, szProto);
+			// Request it, unless somebody else is requesting this protocol now
+			ProtoQueue *pq;
+			{
+				mir_cslock lck(csProtoQueues);
+				pq = GetProtoQueue(szProto);
+				if (pq->bBusy) {
+					// the result will be processed by that thread
+					if (pq->arPending.find((void *)hContact) == nullptr)
+						pq->arPending.insert((void *)hContact);
+					return result;
+				}
+				pq->bBusy = true;
+			}
+
+			result = RequestAvatarInfo(hContact, szProto);
+
+			// and the contacts queued meanwhile
+			while (true) {
+				MCONTACT hNext;
+				{
+					mir_cslock lck(csProtoQueues);
+					if (pq->arPending.getCount() == 0) {
+						pq->bBusy = false;
+						break;
+					}
+					hNext = (UINT_PTR)pq->arPending[0];
+					pq->arPending.remove(0);
+				}
+				RequestAvatarInfo(hNext, szProto);
+			}
 		}
 	}
 
@@ -82,6 +82,7 @@ struct CacheNode : public AVATARCACHEENTRY, public MZeroedObject
 	~CacheNode();
 
 	bool   bLoaded, bNotify;
+	bool   bLoading;        // being processed by a loader task
 	int    pa_format;
 
 	void   wipeInfo();
@@ -145,7 +145,7 @@ int CreateAvatarInCache(MCONTACT hContact, AVATARCACHEENTRY *ace, const char *sz
 		return -2;
 
 	BOOL isTransparentImage = 0;
-	ace->hbmPic = BmpFilterLoadBitmap(&isTransparentImage, tszFilename);
+	ace->hbmPic = BmpFilterLoadCached(&isTransparentImage, tszFilename);
 	ace->dwFlags = 0;
 	ace->bmHeight = 0;
 	ace->bmWidth = 0;
@@ -27,6 +27,9 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include <commctrl.h>
 #include <time.h>
 
+#include <vector>
+#include <unordered_map>
+
 #include <newpluginapi.h>
 #include <m_clist.h>
 #include <m_database.h>
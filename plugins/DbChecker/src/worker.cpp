@@ -70,6 +70,154 @@ static bool CompareContents(const DBEVENTINFO &ev1, const DBEVENTINFO &ev2)
 	return !memcmp(ev1.pBlob, ev2.pBlob, ev1.cbBlob);
 }
 
+/////////////////////////////////////////////////////////////////////////////////////////
+// contacts' histories are read in parallel by pool tasks, each task makes a list of fixes
+// for its contact, and the worker thread applies them in one batch. converted events are
+// the exception: their blobs are written by the task itself in chunks, not to keep them all
+
+#define MAX_HISTORY_JOBS 16 // number of contacts being read simultaneously
+#define MAX_PENDING_EDITS 100 // converted events kept in memory by a task
+
+struct HistoryEdit
+{
+	HistoryEdit(MEVENT _1) :
+		hEvent(_1)
+	{}
+
+	MEVENT hEvent;
+	DB::EventInfo dbei;
+	ptrA szId;
+	int iSeen = -1; // index in the task's list of seen events, if it's there
+};
+
+struct HistoryItem
+{
+	MEVENT hEvent;
+	HistoryEdit *pEdit; // if an event is converted, its new contents aren't written yet
+};
+
+struct HistoryJob
+{
+	HistoryJob(DbToolOptions *_1, MCONTACT _2) :
+		opts(_1),
+		hContact(_2),
+		arEdits(10)
+	{}
+
+	DbToolOptions *opts;
+	MCONTACT hContact;
+	HANDLE hTask = nullptr;
+	int nEdits = 0;
+
+	std::vector<MEVENT> arRead, arDelete;
+	OBJLIST<HistoryEdit> arEdits;
+
+	// once written, the new contents are compared with the database's ones
+	void ApplyEdits(std::vector<HistoryItem> &arSeen)
+	{
+		for (auto &it : arEdits) {
+			opts->db->EditEvent(hContact, it->hEvent, &it->dbei);
+			if (it->iSeen != -1)
+				arSeen[it->iSeen].pEdit = nullptr;
+		}
+
+		nEdits += arEdits.getCount();
+		arEdits.destroy();
+	}
+};
+
+static uint32_t HashEvent(const DBEVENTINFO &dbei)
+{
+	uint32_t hash = (dbei.cbBlob && dbei.pBlob) ? mir_hash(dbei.pBlob, dbei.cbBlob) : 0;
+	return hash ^ dbei.timestamp ^ (uint32_t(dbei.eventType) << 16) ^ (dbei.flags & DBEF_SENT);
+}
+
+// events with the same hash are compared completely, the hash might collide
+static bool IsSameEvent(MDatabaseCommon *db, const HistoryItem &item, const DBEVENTINFO &dbei)
+{
+	if (item.pEdit)
+		return item.pEdit->dbei == dbei && CompareContents(item.pEdit->dbei, dbei);
+
+	DB::EventInfo dbold;
+	dbold.cbBlob = -1;
+	if (db->GetEvent(item.hEvent, &dbold))
+		return false;
+
+	return dbold == dbei && CompareContents(dbold, dbei);
+}
+
+static void __cdecl ReadHistoryTask(void *param)
+{
+	auto *pJob = (HistoryJob *)param;
+	auto *opts = pJob->opts;
+
+	DBCachedContact *cc = opts->db->getCache()->GetCachedContact(pJob->hContact);
+	bool bIsMeta = cc != nullptr && cc->IsMeta();
+
+	// duplicates are searched in the whole history, not only among neighbours
+	std::vector<HistoryItem> arSeen;
+	std::unordered_multimap<uint32_t, size_t> arHashes;
+
+	DB::ECPTR pCursor(opts->db->EventCursor(pJob->hContact, 0));
+	while (MEVENT hEvent = pCursor.FetchNext()) {
+		// a meta's history includes its subs' events, they are checked with the subs
+		if (bIsMeta && opts->db->GetEventContact(hEvent) != pJob->hContact)
+			continue;
+
+		DB::EventInfo dbei;
+		if (opts->bCheckUtf || opts->bCheckDups) // read also event's body
+			dbei.cbBlob = -1;
+		if (opts->db->GetEvent(hEvent, &dbei))
+			continue;
+
+		HistoryEdit *pEdit = nullptr;
+		if (opts->bCheckUtf && dbei.eventType == EVENTTYPE_MESSAGE) {
+			ptrA szId(mir_strdup(dbei.szId)); // might point to the blob being replaced
+			if (ConvertOldEvent(dbei)) {
+				pEdit = new HistoryEdit(hEvent);
+				pEdit->szId = szId.detach();
+				(DBEVENTINFO &)pEdit->dbei = dbei;
+				pEdit->dbei.szId = pEdit->szId;
+				dbei.pBlob = nullptr;
+			}
+		}
+
+		const DBEVENTINFO &ev = (pEdit) ? pEdit->dbei : dbei;
+
+		if (opts->bCheckDups) {
+			uint32_t hash = HashEvent(ev);
+
+			bool bDup = false;
+			auto range = arHashes.equal_range(hash);
+			for (auto it = range.first; it != range.second && !bDup; ++it)
+				bDup = IsSameEvent(opts->db, arSeen[it->second], ev);
+
+			if (bDup) {
+				delete pEdit;
+				pJob->arDelete.push_back(hEvent);
+				continue;
+			}
+
+			if (pEdit)
+				pEdit->iSeen = (int)arSeen.size();
+
+			arHashes.emplace(hash, arSeen.size());
+			arSeen.push_back({ hEvent, pEdit });
+		}
+
+		if (opts->bMarkRead && !ev.markedRead())
+			pJob->arRead.push_back(hEvent);
+
+		if (pEdit) {
+			pJob->arEdits.insert(pEdit);
+			if (pJob->arEdits.getCount() >= MAX_PENDING_EDITS)
+				pJob->ApplyEdits(arSeen);
+		}
+	}
+
+	pJob->ApplyEdits(arSeen);
+}
+
 void __cdecl WorkerThread(DbToolOptions *opts)
 {
 	time_t ts = time(nullptr);
@@ -81,47 +229,56 @@ void __cdecl WorkerThread(DbToolOptions *opts)
 	if (opts->bMarkRead || opts->bCheckUtf || opts->bCheckDups) {
 		int nCount = 0, nUtfCount = 0, nDups = 0;
 
-		for (auto &cc : Contacts()) {
-			DB::ECPTR pCursor(DB::Events(cc));
-			DBEVENTINFO dboldev = {};
-			while (MEVENT hEvent = pCursor.FetchNext()) {
-				DB::EventInfo dbei;
-				if (opts->bCheckUtf || opts->bCheckDups) // read also event's body
-					dbei.cbBlob = -1;
-				if (db_event_get(hEvent, &dbei))
-					continue;
-
-				if (opts->bMarkRead && !dbei.markedRead()) {
-					db_event_markRead(cc, hEvent);
-					nCount++;
-				}
+		// writes are committed once per contact, not on each fix
+		opts->db->SetCacheSafetyMode(false);
 
-				if (opts->bCheckUtf && dbei.eventType == EVENTTYPE_MESSAGE) {
-					if (ConvertOldEvent(dbei)) {
-						db_event_edit(cc, hEvent, &dbei);
-						nUtfCount++;
-					}
+		OBJLIST<HistoryJob> arJobs(MAX_HISTORY_JOBS);
+		MCONTACT hContact = opts->db->FindFirstContact();
+		while (hContact || arJobs.getCount()) {
+			while (hContact && arJobs.getCount() < MAX_HISTORY_JOBS) {
+				if (WaitForSingleObject(opts->hEventAbort, 0) == WAIT_OBJECT_0) {
+					hContact = 0;
+					break;
 				}
 
-				if (opts->bCheckDups) {
-					if (dbei == dboldev && CompareContents(dbei, dboldev)) {
-						pCursor.DeleteEvent();
-						nDups++;
-					}
-					else {
-						mir_free(dboldev.pBlob);
-						dboldev = dbei;
-						if (dboldev.cbBlob) {
-							dboldev.pBlob = (uint8_t *)mir_alloc(dboldev.cbBlob);
-							memcpy(dboldev.pBlob, dbei.pBlob, dboldev.cbBlob);
-						}
-						else dboldev.pBlob = nullptr;
-					}
-				}
+				auto *pJob = new HistoryJob(opts, hContact);
+				if ((pJob->hTask = Task_Create(ReadHistoryTask, pJob)) == nullptr)
+					ReadHistoryTask(pJob);
+				arJobs.insert(pJob);
+
+				hContact = opts->db->FindNextContact(hContact);
+			}
+
+			// aborted before anything was queued
+			if (arJobs.getCount() == 0)
+				break;
+
+			// fixes are applied in the contacts' order
+			auto &job = arJobs[0];
+			if (job.hTask) {
+				Task_Wait(job.hTask);
+				Task_Close(job.hTask);
 			}
-			mir_free(dboldev.pBlob);
+
+			for (auto &it : job.arRead)
+				opts->db->MarkEventRead(job.hContact, it);
+
+			for (auto &it : job.arDelete)
+				opts->db->DeleteEvent(it);
+
+			if (job.nEdits || job.arRead.size() || job.arDelete.size()) {
+				opts->db->Flush();
+
+				nUtfCount += job.nEdits;
+				nCount += (int)job.arRead.size();
+				nDups += (int)job.arDelete.size();
+			}
+
+			arJobs.remove(0);
 		}
 
+		opts->db->SetCacheSafetyMode(true);
+
 		if (nCount)
 			AddToStatus(STATUS_MESSAGE, TranslateT("%d events marked as read"), nCount);
 
@@ -24,34 +24,270 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "stdafx.h"
 
 /////////////////////////////////////////////////////////////////////////////////////////
-// we are tracing EventsSort table to verify that they have correct event ids
+// the tables are streamed in their key order by parallel readers, each one inside its
+// own read-only snapshot, and then cross-checked in memory by merge joins & bitmaps.
+// all fixes are applied by the calling thread within the write transaction, and as the
+// profile might be changed since the snapshot, each candidate is re-checked there first
 
-int CDbxMDBX::CheckEvents1(void)
+struct CheckScan
 {
-	txn_ptr trnlck(this);
-	cursor_ptr cursor(trnlck, m_dbEventsSort);
+	CDbxMDBX *pDb;
+	size_t (CDbxMDBX::*pFunc)(MDBX_txn *txn);
+	const wchar_t *pwszTable;
+
+	MDBX_txn *txn;
+	size_t nRecords;
+	uint32_t dwTicks;
+};
+
+void __cdecl CDbxMDBX::CheckScanTask(void *param)
+{
+	auto *p = (CheckScan *)param;
+	uint32_t dwTicks = GetTickCount();
+
+	p->nRecords = (p->pDb->*p->pFunc)(p->txn);
+	p->dwTicks = GetTickCount() - dwTicks;
+}
+
+void CDbxMDBX::CheckReport(const wchar_t *pwszTable, size_t nRecords, uint32_t dwTicks)
+{
+	cb->pfnAddLogMessage(STATUS_MESSAGE, CMStringW(FORMAT, TranslateT("%s: %u records processed in %u ms (%u records/sec)"),
+		pwszTable, unsigned(nRecords), dwTicks, unsigned(nRecords * 1000 / (dwTicks + 1))));
+}
+
+bool CDbxMDBX::CheckContactExists(MCONTACT hContact) const
+{
+	return hContact == 0 || (hContact < m_checkContactBits.size() && m_checkContactBits[hContact]);
+}
+
+const CDbxMDBX::CheckEventRec* CDbxMDBX::CheckFindEvent(MEVENT hEvent) const
+{
+	auto it = std::lower_bound(m_checkEvents.begin(), m_checkEvents.end(), hEvent, [](const CheckEventRec &ev, MEVENT id) { return ev.hEvent < id; });
+	return (it != m_checkEvents.end() && it->hEvent == hEvent) ? &*it : nullptr;
+}
+
+void CDbxMDBX::CheckFillEvent(MEVENT hEvent, const MDBX_val &data, CheckEventRec &ev)
+{
+	memset(&ev, 0, sizeof(ev));
+	ev.hEvent = hEvent;
+
+	auto *dbe = (const DBEvent *)data.iov_base;
+	if (data.iov_len < sizeof(DBEvent) || data.iov_len < sizeof(DBEvent) + dbe->cbBlob)
+		ev.bBroken = true;
+	else {
+		ev.hContact = dbe->dwContactID;
+		ev.ts = dbe->timestamp;
+		ev.bRead = dbe->markedRead();
+		ev.bHasId = (dbe->flags & DBEF_HAS_ID) != 0;
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////
+// live data, as it's seen by the write transaction
+
+bool CDbxMDBX::CheckLiveContact(MDBX_txn *txn, MCONTACT hContact)
+{
+	if (hContact == 0)
+		return true;
+
+	MDBX_val key = { &hContact, sizeof(MCONTACT) }, data;
+	return mdbx_get(txn, m_dbContacts, &key, &data) == MDBX_SUCCESS;
+}
+
+bool CDbxMDBX::CheckLiveEvent(MDBX_txn *txn, MEVENT hEvent, CheckEventRec &ev)
+{
+	MDBX_val key = { &hEvent, sizeof(MEVENT) }, data;
+	if (mdbx_get(txn, m_dbEvents, &key, &data) != MDBX_SUCCESS)
+		return false;
+
+	CheckFillEvent(hEvent, data, ev);
+	return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////
+// table readers
+
+size_t CDbxMDBX::CheckScanContacts(MDBX_txn *txn)
+{
+	cursor_ptr cursor(txn, m_dbContacts);
+
+	size_t nRecords = 0;
+	MDBX_val key, data;
+	for (int ret = mdbx_cursor_get(cursor, &key, &data, MDBX_FIRST); ret == MDBX_SUCCESS; ret = mdbx_cursor_get(cursor, &key, &data, MDBX_NEXT), nRecords++) {
+		MCONTACT hContact = *(const MCONTACT *)key.iov_base;
+		if (hContact >= m_checkContactBits.size())
+			m_checkContactBits.resize(hContact + 1);
+		m_checkContactBits[hContact] = true;
+	}
+
+	return nRecords;
+}
+
+size_t CDbxMDBX::CheckScanEvents(MDBX_txn *txn)
+{
+	MDBX_stat st;
+	if (mdbx_dbi_stat(txn, m_dbEvents, &st, sizeof(st)) == MDBX_SUCCESS)
+		m_checkEvents.reserve(st.ms_entries);
+
+	cursor_ptr cursor(txn, m_dbEvents);
 
 	MDBX_val key, data;
 	for (int ret = mdbx_cursor_get(cursor, &key, &data, MDBX_FIRST); ret == MDBX_SUCCESS; ret = mdbx_cursor_get(cursor, &key, &data, MDBX_NEXT)) {
-		auto *pData = (DBEventSortingKey *)key.iov_base;
+		CheckEventRec ev;
+		CheckFillEvent(*(const MEVENT *)key.iov_base, data, ev);
+		m_checkEvents.push_back(ev);
+	}
 
-		// if that's not a member of system event, check contact's existence first
-		if (pData->hContact != 0) {
-			auto *cc = m_cache->GetCachedContact(pData->hContact);
-			if (cc == nullptr) {
-				mdbx_cursor_del(cursor, MDBX_UPSERT);
-				cb->pfnAddLogMessage(STATUS_ERROR, CMStringW(FORMAT, TranslateT("Orphaned sorting event with wrong contact ID %d, deleting"), pData->hContact));
-				continue;
+	return m_checkEvents.size();
+}
+
+size_t CDbxMDBX::CheckScanSortingKeys(MDBX_txn *txn)
+{
+	MDBX_stat st;
+	if (mdbx_dbi_stat(txn, m_dbEventsSort, &st, sizeof(st)) == MDBX_SUCCESS)
+		m_checkKeys.reserve(st.ms_entries);
+
+	cursor_ptr cursor(txn, m_dbEventsSort);
+
+	MDBX_val key, data;
+	for (int ret = mdbx_cursor_get(cursor, &key, &data, MDBX_FIRST); ret == MDBX_SUCCESS; ret = mdbx_cursor_get(cursor, &key, &data, MDBX_NEXT))
+		m_checkKeys.push_back(*(const DBEventSortingKey *)key.iov_base);
+
+	return m_checkKeys.size();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////
+// we are reading contacts, events & sorting keys to verify that events belong to the
+// existing contacts and that each event has exactly one correct sorting key
+
+int CDbxMDBX::CheckEvents1(void)
+{
+	CheckScan scans[] = {
+		{ this, &CDbxMDBX::CheckScanContacts, L"contacts" },
+		{ this, &CDbxMDBX::CheckScanEvents, L"events" },
+		{ this, &CDbxMDBX::CheckScanSortingKeys, L"eventsrt" }
+	};
+
+	// readers see only the committed data, and all of them must see the same snapshot,
+	// so nobody can commit between their starts
+	bool bFailed = false;
+	{
+		mir_cslock lck(m_csDbAccess);
+		DBFlush(true);
+
+		for (auto &it : scans)
+			if (mdbx_txn_begin(m_env, nullptr, MDBX_TXN_RDONLY, &it.txn) != MDBX_SUCCESS) {
+				it.txn = nullptr;
+				bFailed = true;
 			}
+	}
+
+	// partial data would make us delete valid records
+	if (bFailed) {
+		for (auto &it : scans)
+			if (it.txn)
+				mdbx_txn_abort(it.txn);
+
+		cb->pfnAddLogMessage(STATUS_FATAL, TranslateT("Cannot read the database"));
+		return ERROR_READ_FAULT;
+	}
+
+	LIST<void> arTasks(3);
+	for (auto &it : scans) {
+		if (HANDLE hTask = Task_Create(CheckScanTask, &it))
+			arTasks.insert(hTask);
+		else
+			CheckScanTask(&it);
+	}
+
+	for (auto &it : arTasks) {
+		Task_Wait(it);
+		Task_Close(it);
+	}
+
+	for (auto &it : scans) {
+		mdbx_txn_abort(it.txn);
+		CheckReport(it.pwszTable, it.nRecords, it.dwTicks);
+	}
+
+	uint32_t dwTicks = GetTickCount();
+	txn_ptr trnlck(this);
+
+	// events of missing contacts and broken records are removed, unless they were
+	// deleted or fixed after the snapshot
+	CheckEventRec live;
+	for (auto &it : m_checkEvents) {
+		if (!it.bBroken && CheckContactExists(it.hContact))
+			continue;
+
+		if (!CheckLiveEvent(trnlck, it.hEvent, live)) {
+			it.hEvent = 0;
+			continue;
 		}
 
-		if (GetBlobSize(pData->hEvent) == -1) {
-			mdbx_cursor_del(cursor, MDBX_UPSERT);
-			cb->pfnAddLogMessage(STATUS_ERROR, CMStringW(FORMAT, TranslateT("Orphaned sorting event with wrong event ID %d:%08X, deleting"), pData->hContact, pData->hEvent));
+		if (!live.bBroken && CheckLiveContact(trnlck, live.hContact))
+			continue;
+
+		MDBX_val key = { &it.hEvent, sizeof(MEVENT) };
+		mdbx_del(trnlck, m_dbEvents, &key, nullptr);
+		if (live.bBroken)
+			cb->pfnAddLogMessage(STATUS_ERROR, CMStringW(FORMAT, TranslateT("Event %08X is damaged, deleting"), it.hEvent));
+		else
+			cb->pfnAddLogMessage(STATUS_ERROR, CMStringW(FORMAT, TranslateT("Orphaned event %08X with wrong contact ID %d, deleting"), it.hEvent, live.hContact));
+		it.hEvent = 0;
+	}
+
+	m_checkEvents.erase(std::remove_if(m_checkEvents.begin(), m_checkEvents.end(), [](const CheckEventRec &ev) { return ev.hEvent == 0; }), m_checkEvents.end());
+
+	// sorting keys are joined with events by the event id
+	std::sort(m_checkKeys.begin(), m_checkKeys.end(), [](const DBEventSortingKey &a, const DBEventSortingKey &b) { return a.hEvent < b.hEvent; });
+
+	auto ev = m_checkEvents.begin();
+	for (auto &it : m_checkKeys) {
+		while (ev != m_checkEvents.end() && ev->hEvent < it.hEvent)
+			++ev;
+
+		if (ev != m_checkEvents.end() && ev->hEvent == it.hEvent && ev->hContact == it.hContact && ev->ts == it.ts && !ev->bIndexed) {
+			ev->bIndexed = true;
 			continue;
 		}
+
+		// the event could be changed after the snapshot, so its key might be valid now
+		if (CheckLiveEvent(trnlck, it.hEvent, live) && !live.bBroken && live.hContact == it.hContact && live.ts == it.ts)
+			continue;
+
+		DBEventSortingKey keyVal = it;
+		MDBX_val key = { &keyVal, sizeof(keyVal) };
+		if (mdbx_del(trnlck, m_dbEventsSort, &key, nullptr) != MDBX_SUCCESS)
+			continue;
+
+		if (!CheckContactExists(it.hContact))
+			cb->pfnAddLogMessage(STATUS_ERROR, CMStringW(FORMAT, TranslateT("Orphaned sorting event with wrong contact ID %d, deleting"), it.hContact));
+		else if (ev == m_checkEvents.end() || ev->hEvent != it.hEvent)
+			cb->pfnAddLogMessage(STATUS_ERROR, CMStringW(FORMAT, TranslateT("Orphaned sorting event with wrong event ID %d:%08X, deleting"), it.hContact, it.hEvent));
+		else
+			cb->pfnAddLogMessage(STATUS_ERROR, CMStringW(FORMAT, TranslateT("Sorting event %d:%08X doesn't match its event, deleting"), it.hContact, it.hEvent));
 	}
 
+	// and the events without keys get them back, if they still exist
+	for (auto &it : m_checkEvents) {
+		m_checkEventBits.resize(it.hEvent + 1);
+		m_checkEventBits[it.hEvent] = true;
+
+		if (it.bIndexed)
+			continue;
+
+		if (!CheckLiveEvent(trnlck, it.hEvent, live) || live.bBroken)
+			continue;
+
+		DBEventSortingKey keyVal = { live.hContact, it.hEvent, live.ts };
+		MDBX_val key = { &keyVal, sizeof(keyVal) }, data = { (void *)"", 1 };
+		if (mdbx_put(trnlck, m_dbEventsSort, &key, &data, MDBX_NOOVERWRITE) == MDBX_SUCCESS)
+			cb->pfnAddLogMessage(STATUS_ERROR, CMStringW(FORMAT, TranslateT("Event %08X is missing in the sorting index, restoring"), it.hEvent));
+	}
+
+	CheckReport(L"eventsrt", m_checkKeys.size(), GetTickCount() - dwTicks);
+	std::vector<DBEventSortingKey>().swap(m_checkKeys);
 	return 0;
 }
 
@@ -60,19 +296,64 @@ int CDbxMDBX::CheckEvents1(void)
 
 int CDbxMDBX::CheckEvents2(void)
 {
+	uint32_t dwTicks = GetTickCount();
+	size_t nRecords = 0;
+
 	txn_ptr trnlck(this);
-	cursor_ptr cursor(trnlck, m_dbEventIds);
+	{
+		cursor_ptr cursor(trnlck, m_dbEventIds);
 
-	MDBX_val key, data;
-	for (int ret = mdbx_cursor_get(cursor, &key, &data, MDBX_FIRST); ret == MDBX_SUCCESS; ret = mdbx_cursor_get(cursor, &key, &data, MDBX_NEXT)) {
-		MEVENT hDbEvent = *(MEVENT *)data.iov_base;
-		if (GetBlobSize(hDbEvent) == -1) {
-			mdbx_cursor_del(cursor, MDBX_UPSERT);
-			cb->pfnAddLogMessage(STATUS_ERROR, CMStringW(FORMAT, TranslateT("Orphaned event id with wrong event ID %08X, deleting"), hDbEvent));
-			continue;
+		std::vector<bool> arRefs(m_checkEventBits.size());
+
+		MDBX_val key, data;
+		for (int ret = mdbx_cursor_get(cursor, &key, &data, MDBX_FIRST); ret == MDBX_SUCCESS; ret = mdbx_cursor_get(cursor, &key, &data, MDBX_NEXT), nRecords++) {
+			MEVENT hDbEvent = *(MEVENT *)data.iov_base;
+			if (hDbEvent >= m_checkEventBits.size() || !m_checkEventBits[hDbEvent]) {
+				// the event might be added after the snapshot
+				MDBX_val keyEvent = { &hDbEvent, sizeof(MEVENT) }, dataEvent;
+				if (mdbx_get(trnlck, m_dbEvents, &keyEvent, &dataEvent) == MDBX_SUCCESS)
+					continue;
+
+				mdbx_cursor_del(cursor, MDBX_UPSERT);
+				cb->pfnAddLogMessage(STATUS_ERROR, CMStringW(FORMAT, TranslateT("Orphaned event id with wrong event ID %08X, deleting"), hDbEvent));
+				continue;
+			}
+			arRefs[hDbEvent] = true;
+		}
+
+		// events with server ids, that aren't referenced by the table, are restored.
+		// that's rare, so the records are read directly
+		for (auto &it : m_checkEvents) {
+			if (!it.bHasId || arRefs[it.hEvent])
+				continue;
+
+			key.iov_len = sizeof(MEVENT); key.iov_base = &it.hEvent;
+			if (mdbx_get(trnlck, m_dbEvents, &key, &data) != MDBX_SUCCESS)
+				continue;
+
+			auto *dbe = (const DBEvent *)data.iov_base;
+			if (data.iov_len < sizeof(DBEvent) || !(dbe->flags & DBEF_HAS_ID))
+				continue;
+
+			const char *pszId = (const char *)data.iov_base + sizeof(DBEvent) + dbe->cbBlob + 1;
+			size_t cbId = (data.iov_len > sizeof(DBEvent) + dbe->cbBlob + 1) ? strnlen(pszId, data.iov_len - sizeof(DBEvent) - dbe->cbBlob - 1) : 0;
+			if (cbId == 0 || cbId >= sizeof(DBEventIdKey::szEventId))
+				continue;
+
+			DBEventIdKey keyId;
+			keyId.iModuleId = dbe->iModuleId;
+			memcpy(keyId.szEventId, pszId, cbId);
+			keyId.szEventId[cbId] = 0;
+
+			MDBX_val keyid = { &keyId, sizeof(MEVENT) + cbId + 1 }, dataid = { &it.hEvent, sizeof(MEVENT) };
+			if (mdbx_put(trnlck, m_dbEventIds, &keyid, &dataid, MDBX_NOOVERWRITE) == MDBX_SUCCESS) {
+				EventIdFilterAdd(keyId.szEventId);
+				cb->pfnAddLogMessage(STATUS_ERROR, CMStringW(FORMAT, TranslateT("Server id of event %08X is missing, restoring"), it.hEvent));
+			}
 		}
 	}
 
+	CheckReport(L"eventids", nRecords, GetTickCount() - dwTicks);
 	return 0;
 }
 
@@ -81,37 +362,199 @@ int CDbxMDBX::CheckEvents2(void)
 
 int CDbxMDBX::CheckEvents3(void)
 {
+	uint32_t dwTicks = GetTickCount();
+	size_t nRecords = 0;
+
 	txn_ptr trnlck(this);
-	cursor_ptr cursor(trnlck, m_dbSettings);
+	{
+		cursor_ptr cursor(trnlck, m_dbSettings);
 
-	MDBX_val key, data;
-	for (int ret = mdbx_cursor_get(cursor, &key, &data, MDBX_FIRST); ret == MDBX_SUCCESS; ret = mdbx_cursor_get(cursor, &key, &data, MDBX_NEXT)) {
-		auto *pKey = (DBSettingKey *)key.iov_base;
+		// settings are sorted by contact, so each contact is checked once
+		MCONTACT hLast = 0;
+		bool bExists = true;
 
-		if (pKey->hContact) {
-			auto *cc = m_cache->GetCachedContact(pKey->hContact);
-			if (cc == nullptr) {
-				mdbx_cursor_del(cursor, MDBX_UPSERT);
+		MDBX_val key, data;
+		for (int ret = mdbx_cursor_get(cursor, &key, &data, MDBX_FIRST); ret == MDBX_SUCCESS; ret = mdbx_cursor_get(cursor, &key, &data, MDBX_NEXT), nRecords++) {
+			auto *pKey = (DBSettingKey *)key.iov_base;
+			if (pKey->hContact != hLast) {
+				hLast = pKey->hContact;
+				bExists = CheckContactExists(hLast) || CheckLiveContact(trnlck, hLast); // might be added after the snapshot
+			}
+
+			if (!bExists) {
 				cb->pfnAddLogMessage(STATUS_ERROR, CMStringW(FORMAT, TranslateT("Orphaned setting with wrong contact ID %08X, deleting"), pKey->hContact));
-				continue;
+				mdbx_cursor_del(cursor, MDBX_UPSERT);
 			}
 		}
 	}
 
+	CheckReport(L"settings", nRecords, GetTickCount() - dwTicks);
 	return 0;
 }
 
+/////////////////////////////////////////////////////////////////////////////////////////
+// we are verifying contacts' event counters and their first unread events. a meta's
+// history is merged from its subs, so it gets their events too
+
+struct CheckTotals
+{
+	uint32_t dwCount;
+	MEVENT   evFirstUnread;
+	uint64_t tsFirstUnread;
+
+	void Add(const MEVENT hEvent, uint64_t ts, bool bRead)
+	{
+		dwCount++;
+		if (!bRead && (evFirstUnread == 0 || ts < tsFirstUnread || (ts == tsFirstUnread && hEvent < evFirstUnread))) {
+			evFirstUnread = hEvent;
+			tsFirstUnread = ts;
+		}
+	}
+};
+
+// the first unread event might be a later one, if events were read out of order,
+// but it must be an unread event of this history
+bool CDbxMDBX::CheckFirstUnread(DBCachedContact *cc, const CheckTotals &tot, const CheckEventRec *ev)
+{
+	const DBContact &dbc = cc->dbc;
+	if (dbc.evFirstUnread == 0)
+		return tot.evFirstUnread == 0;
+
+	if (ev == nullptr || ev->bBroken || ev->bRead || ev->ts != dbc.tsFirstUnread)
+		return false;
+
+	if (ev->hContact == cc->contactID)
+		return true;
+
+	DBCachedContact *ccSub = m_cache->GetCachedContact(ev->hContact);
+	return ccSub != nullptr && ccSub->parentID == cc->contactID;
+}
+
+void CDbxMDBX::CheckLiveTotals(MDBX_txn *txn, MCONTACT hContact, CheckTotals &tot)
+{
+	cursor_ptr cursor(txn, m_dbEventsSort);
+
+	DBEventSortingKey keyVal = { hContact, 0, 0 };
+	MDBX_val key = { &keyVal, sizeof(keyVal) }, data;
+
+	CheckEventRec ev;
+	for (int ret = mdbx_cursor_get(cursor, &key, &data, MDBX_SET_RANGE); ret == MDBX_SUCCESS; ret = mdbx_cursor_get(cursor, &key, &data, MDBX_NEXT)) {
+		auto *pKey = (const DBEventSortingKey *)key.iov_base;
+		if (pKey->hContact != hContact)
+			break;
+
+		if (CheckLiveEvent(txn, pKey->hEvent, ev) && !ev.bBroken)
+			tot.Add(ev.hEvent, ev.ts, ev.bRead);
+	}
+}
+
+bool CDbxMDBX::CheckCounters(const txn_ptr &txn, DBCachedContact *cc, const CheckTotals &snapshot)
+{
+	DBContact &dbc = cc->dbc;
+	if (dbc.dwEventCount == snapshot.dwCount && CheckFirstUnread(cc, snapshot, CheckFindEvent(dbc.evFirstUnread)))
+		return false;
+
+	// the history might be changed after the snapshot, so it's recalculated before fixing
+	CheckTotals tot = {};
+	CheckLiveTotals(txn, cc->contactID, tot);
+	for (int i = 0; i < cc->nSubs; i++)
+		CheckLiveTotals(txn, cc->pSubs[i], tot);
+
+	bool bChanged = false;
+	if (dbc.dwEventCount != tot.dwCount) {
+		cb->pfnAddLogMessage(STATUS_ERROR, CMStringW(FORMAT, TranslateT("Contact %d has wrong event count %u instead of %u, fixing"), cc->contactID, dbc.dwEventCount, tot.dwCount));
+		dbc.dwEventCount = tot.dwCount;
+		bChanged = true;
+	}
+
+	CheckEventRec ev;
+	if (!CheckFirstUnread(cc, tot, CheckLiveEvent(txn, dbc.evFirstUnread, ev) ? &ev : nullptr)) {
+		cb->pfnAddLogMessage(STATUS_ERROR, CMStringW(FORMAT, TranslateT("Contact %d has wrong first unread event, fixing"), cc->contactID));
+		dbc.evFirstUnread = tot.evFirstUnread;
+		dbc.tsFirstUnread = tot.tsFirstUnread;
+		bChanged = true;
+	}
+
+	if (!bChanged)
+		return false;
+
+	MDBX_val key, data = { &dbc, sizeof(dbc) };
+	uint32_t keyVal = 2;
+	if (cc->contactID == 0) {
+		key.iov_len = sizeof(keyVal); key.iov_base = &keyVal;
+		mdbx_put(txn, m_dbGlobal, &key, &data, MDBX_UPSERT);
+	}
+	else {
+		key.iov_len = sizeof(MCONTACT); key.iov_base = &cc->contactID;
+		mdbx_put(txn, m_dbContacts, &key, &data, MDBX_UPSERT);
+	}
+	return true;
+}
+
+int CDbxMDBX::CheckEvents4(void)
+{
+	uint32_t dwTicks = GetTickCount();
+
+	// events of the contacts created after the snapshot were kept by the live re-check,
+	// but these contacts aren't verified here, so their events are simply skipped. if a
+	// meta misses some, CheckCounters() recalculates it from the live history anyway
+	size_t nContacts = m_checkContactBits.size();
+	std::vector<CheckTotals> arTotals(nContacts + 1);
+	for (auto &it : m_checkEvents) {
+		if (it.hContact >= nContacts)
+			continue;
+
+		arTotals[it.hContact].Add(it.hEvent, it.ts, it.bRead);
+
+		if (it.hContact != 0) {
+			DBCachedContact *cc = m_cache->GetCachedContact(it.hContact);
+			if (cc && cc->IsSub() && CheckContactExists(cc->parentID))
+				arTotals[cc->parentID].Add(it.hEvent, it.ts, it.bRead);
+		}
+	}
+
+	txn_ptr trnlck(this);
+	CheckCounters(trnlck, &m_ccDummy, arTotals[0]);
+
+	for (MCONTACT hContact = 1; hContact < m_checkContactBits.size(); hContact++) {
+		if (!m_checkContactBits[hContact])
+			continue;
+
+		if (DBCachedContact *cc = m_cache->GetCachedContact(hContact))
+			CheckCounters(trnlck, cc, arTotals[hContact]);
+	}
+
+	CheckReport(L"contacts", m_checkContactBits.size(), GetTickCount() - dwTicks);
+	return 0;
+}
 
 ///////////////////////////////////////////////////////////////////////////////
 // MIDatabaseChecker
 
+BOOL CDbxMDBX::Start(DBCHeckCallback *callback)
+{
+	cb = callback;
+	Destroy();
+	return ERROR_SUCCESS;
+}
+
 int CDbxMDBX::CheckDb(int phase)
 {
 	switch (phase) {
 	case 0: return CheckEvents1();
 	case 1: return CheckEvents2();
 	case 2: return CheckEvents3();
+	case 3: return CheckEvents4();
 	}
 
+	DBFlush();
 	return ERROR_OUT_OF_PAPER;
 }
+
+void CDbxMDBX::Destroy()
+{
+	std::vector<CheckEventRec>().swap(m_checkEvents);
+	std::vector<DBEventSortingKey>().swap(m_checkKeys);
+	std::vector<bool>().swap(m_checkEventBits);
+	std::vector<bool>().swap(m_checkContactBits);
+}
@@ -137,9 +137,9 @@ void CDbxMDBX::GatherContactHistory(MCONTACT hContact, OBJLIST<EventItem> &list)
 	DBEventSortingKey keyVal = { hContact, 0, 0 };
 	MDBX_val key = { &keyVal, sizeof(keyVal) }, data;
 
-	mdbx_cursor_bind(StartTran(), m_curEventsSort, m_dbEventsSort);
+	cursor_ptr cursor(StartTran(), m_dbEventsSort);
 
-	for (int res = mdbx_cursor_get(m_curEventsSort, &key, &data, MDBX_SET_RANGE); res == MDBX_SUCCESS; res = mdbx_cursor_get(m_curEventsSort, &key, &data, MDBX_NEXT)) {
+	for (int res = mdbx_cursor_get(cursor, &key, &data, MDBX_SET_RANGE); res == MDBX_SUCCESS; res = mdbx_cursor_get(cursor, &key, &data, MDBX_NEXT)) {
 		const DBEventSortingKey *pKey = (const DBEventSortingKey*)key.iov_base;
 		if (pKey->hContact != hContact)
 			return;
@@ -148,21 +148,12 @@ void CDbxMDBX::GatherContactHistory(MCONTACT hContact, OBJLIST<EventItem> &list)
 	}
 }
 
+// metacontact's history isn't stored, it's merged from the subs' sorting keys on the fly
+// (see FindMetaEvent), so merging or splitting a sub changes only the number of events
+
 BOOL CDbxMDBX::MetaMergeHistory(DBCachedContact *ccMeta, DBCachedContact *ccSub)
 {
-	OBJLIST<EventItem> list(1000);
-	GatherContactHistory(ccSub->contactID, list);
-
-	for (auto &EI : list) {
-		txn_ptr trnlck(this);
-
-		DBEventSortingKey insVal = { ccMeta->contactID, EI->eventId, EI->ts };
-		MDBX_val key = { &insVal, sizeof(insVal) }, data = { (void*)"", 1 };
-		if (mdbx_put(trnlck, m_dbEventsSort, &key, &data, MDBX_UPSERT) != MDBX_SUCCESS)
-			return 1;
-
-		ccMeta->dbc.dwEventCount++;
-	}
+	ccMeta->dbc.dwEventCount += ccSub->dbc.dwEventCount;
 	{
 		MDBX_val keyc = { &ccMeta->contactID, sizeof(MCONTACT) }, datac = { &ccMeta->dbc, sizeof(ccMeta->dbc) };
 
@@ -179,18 +170,10 @@ BOOL CDbxMDBX::MetaMergeHistory(DBCachedContact *ccMeta, DBCachedContact *ccSub)
 
 BOOL CDbxMDBX::MetaSplitHistory(DBCachedContact *ccMeta, DBCachedContact *ccSub)
 {
-	OBJLIST<EventItem> list(1000);
-	GatherContactHistory(ccSub->contactID, list);
-
-	for (auto &EI : list) {
-		txn_ptr trnlck(this);
-		DBEventSortingKey insVal = { ccMeta->contactID, EI->eventId, EI->ts };
-		MDBX_val key = { &insVal, sizeof(insVal) };
-		if (mdbx_del(trnlck, m_dbEventsSort, &key, nullptr) != MDBX_SUCCESS)
-			return 1;
-
-		ccMeta->dbc.dwEventCount--;
-	}
+	if (ccMeta->dbc.dwEventCount > ccSub->dbc.dwEventCount)
+		ccMeta->dbc.dwEventCount -= ccSub->dbc.dwEventCount;
+	else
+		ccMeta->dbc.dwEventCount = 0;
 	{
 		txn_ptr trnlck(this);
 		MDBX_val keyc = { &ccMeta->contactID, sizeof(MCONTACT) }, datac = { &ccMeta->dbc, sizeof(ccMeta->dbc) };
@@ -203,14 +186,15 @@ BOOL CDbxMDBX::MetaSplitHistory(DBCachedContact *ccMeta, DBCachedContact *ccSub)
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////
+// sub is being deleted, its events become the meta's own ones
 
 BOOL CDbxMDBX::MetaRemoveSubHistory(DBCachedContact *ccSub)
 {
 	OBJLIST<EventItem> list(1000);
 	GatherContactHistory(ccSub->contactID, list);
 
+	txn_ptr trnlck(this);
 	for (auto &EI : list) {
-		txn_ptr trnlck(this);
 		{
 			MDBX_val key = { &EI->eventId, sizeof(MEVENT) }, data;
 			if (mdbx_get(trnlck, m_dbEvents, &key, &data) == MDBX_SUCCESS) {
@@ -224,9 +208,13 @@ BOOL CDbxMDBX::MetaRemoveSubHistory(DBCachedContact *ccSub)
 
 		DBEventSortingKey sortKey = { ccSub->contactID, EI->eventId, EI->ts };
 		{
-			MDBX_val key = { &sortKey, sizeof(sortKey) };
+			MDBX_val key = { &sortKey, sizeof(sortKey) }, data = { (void*)"", 1 };
 			if (mdbx_del(trnlck, m_dbEventsSort, &key, nullptr) != MDBX_SUCCESS)
 				return 1;
+
+			sortKey.hContact = ccSub->parentID;
+			if (mdbx_put(trnlck, m_dbEventsSort, &key, &data, MDBX_UPSERT) != MDBX_SUCCESS)
+				return 1;
 		}
 	}
 
@@ -234,6 +222,27 @@ BOOL CDbxMDBX::MetaRemoveSubHistory(DBCachedContact *ccSub)
 	return 0;
 }
 
+/////////////////////////////////////////////////////////////////////////////////////////
+// profiles of version 1.4 kept copies of subs' sorting keys in the metas' ranges,
+// they are recognized by the event's owner which differs from the key's contact
+
+void CDbxMDBX::DropMetaSortingKeys()
+{
+	cursor_ptr cursor(m_pWriteTran, m_dbEventsSort);
+
+	MDBX_val key, data;
+	for (int res = mdbx_cursor_get(cursor, &key, &data, MDBX_FIRST); res == MDBX_SUCCESS; res = mdbx_cursor_get(cursor, &key, &data, MDBX_NEXT)) {
+		const DBEventSortingKey *pKey = (const DBEventSortingKey *)key.iov_base;
+
+		MDBX_val key2 = { (void*)&pKey->hEvent, sizeof(MEVENT) }, data2;
+		if (mdbx_get(m_pWriteTran, m_dbEvents, &key2, &data2) != MDBX_SUCCESS)
+			continue;
+
+		if (((const DBEvent *)data2.iov_base)->dwContactID != pKey->hContact)
+			mdbx_cursor_del(cursor, MDBX_UPSERT);
+	}
+}
+
 /////////////////////////////////////////////////////////////////////////////////////////
 
 void DBCachedContact::Advance(MEVENT id, DBEvent &dbe)
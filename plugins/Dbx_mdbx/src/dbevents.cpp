@@ -99,12 +99,9 @@ BOOL CDbxMDBX::DeleteEvent(MEVENT hDbEvent)
 				return 0;
 		}
 
+		// cc2 is a meta, it has no sorting key for a sub's event
 		if (cc2) {
 			key2.hContact = cc2->contactID;
-			if (mdbx_del(trnlck, m_dbEventsSort, &key, nullptr) != MDBX_SUCCESS)
-				return 1;
-
-			key.iov_len = sizeof(MCONTACT); key.iov_base = &dbe.dwContactID;
 			cc2->dbc.dwEventCount--;
 			if (cc2->dbc.evFirstUnread == hDbEvent)
 				FindNextUnread(trnlck, cc2, key2);
@@ -223,8 +220,8 @@ bool CDbxMDBX::EditEvent(MCONTACT contactID, MEVENT hDbEvent, const DBEVENTINFO
 		if (mdbx_put(trnlck, m_dbEvents, &key, &data, MDBX_UPSERT) != MDBX_SUCCESS)
 			return false;
 
-		// add a sorting key
-		DBEventSortingKey key2 = { contactID, hDbEvent, dbe.timestamp };
+		// add a sorting key, only to the sub's history if it's a sub: a meta's history is merged from its subs
+		DBEventSortingKey key2 = { (ccSub != nullptr) ? ccSub->contactID : contactID, hDbEvent, dbe.timestamp };
 		key.iov_len = sizeof(key2); key.iov_base = &key2;
 		data.iov_len = 1; data.iov_base = (char*)("");
 		if (mdbx_put(trnlck, m_dbEventsSort, &key, &data, MDBX_UPSERT) != MDBX_SUCCESS)
@@ -236,12 +233,7 @@ bool CDbxMDBX::EditEvent(MCONTACT contactID, MEVENT hDbEvent, const DBEVENTINFO
 			if (mdbx_put(trnlck, m_dbContacts, &keyc, &datac, MDBX_UPSERT) != MDBX_SUCCESS)
 				return false;
 
-			// insert an event into a sub's history too
 			if (ccSub != nullptr) {
-				key2.hContact = ccSub->contactID;
-				if (mdbx_put(trnlck, m_dbEventsSort, &key, &data, MDBX_UPSERT) != MDBX_SUCCESS)
-					return false;
-
 				ccSub->Advance(hDbEvent, dbe);
 				datac.iov_base = &ccSub->dbc;
 				keyc.iov_base = &ccSub->contactID;
@@ -264,6 +256,8 @@ bool CDbxMDBX::EditEvent(MCONTACT contactID, MEVENT hDbEvent, const DBEVENTINFO
 			MDBX_val keyid = { &keyId, sizeof(MEVENT) + strlen(keyId.szEventId) + 1 }, dataid = { &hDbEvent, sizeof(hDbEvent) };
 			if (mdbx_put(trnlck, m_dbEventIds, &keyid, &dataid, MDBX_UPSERT) != MDBX_SUCCESS)
 				return false;
+
+			EventIdFilterAdd(keyId.szEventId);
 		}
 	}
 
@@ -280,8 +274,10 @@ bool CDbxMDBX::EditEvent(MCONTACT contactID, MEVENT hDbEvent, const DBEVENTINFO
 
 int CDbxMDBX::GetBlobSize(MEVENT hDbEvent)
 {
+	txn_ptr_ro txn(this);
+
 	MDBX_val key = { &hDbEvent, sizeof(MEVENT) }, data;
-	if (mdbx_get(StartTran(), m_dbEvents, &key, &data) != MDBX_SUCCESS)
+	if (mdbx_get(txn, m_dbEvents, &key, &data) != MDBX_SUCCESS)
 		return -1;
 	return ((const DBEvent*)data.iov_base)->cbBlob;
 }
@@ -296,10 +292,13 @@ BOOL CDbxMDBX::GetEvent(MEVENT hDbEvent, DBEVENTINFO *dbei)
 		return 1;
 	}
 
+	// the snapshot must stay alive while dbe is used
+	txn_ptr_ro txn(this);
+
 	const DBEvent *dbe;
 	{
 		MDBX_val key = { &hDbEvent, sizeof(MEVENT) }, data;
-		if (mdbx_get(StartTran(), m_dbEvents, &key, &data) != MDBX_SUCCESS)
+		if (mdbx_get(txn, m_dbEvents, &key, &data) != MDBX_SUCCESS)
 			return 1;
 
 		dbe = (const DBEvent*)data.iov_base;
@@ -347,6 +346,22 @@ void CDbxMDBX::FindNextUnread(const txn_ptr &txn, DBCachedContact *cc, DBEventSo
 {
 	cursor_ptr cursor(txn, m_dbEventsSort);
 
+	if (cc->IsMeta()) {
+		DBEventSortingKey pos = key2, keyVal;
+		for (bool bInclusive = true; FindMetaEvent(cursor, cc, pos, true, bInclusive, keyVal); bInclusive = false) {
+			MDBX_val key = { &keyVal.hEvent, sizeof(MEVENT) }, data;
+			if (mdbx_get(txn, m_dbEvents, &key, &data) == MDBX_SUCCESS && !((const DBEvent *)data.iov_base)->markedRead()) {
+				cc->dbc.evFirstUnread = keyVal.hEvent;
+				cc->dbc.tsFirstUnread = keyVal.ts;
+				return;
+			}
+			pos = keyVal;
+		}
+
+		cc->dbc.evFirstUnread = cc->dbc.tsFirstUnread = 0;
+		return;
+	}
+
 	MDBX_val key = { &key2, sizeof(key2) }, data;
 
 	for (int res = mdbx_cursor_get(cursor, &key, &data, MDBX_SET_KEY); res == MDBX_SUCCESS; res = mdbx_cursor_get(cursor, &key, &data, MDBX_NEXT)) {
@@ -452,16 +467,23 @@ MEVENT CDbxMDBX::GetEventById(const char *szModule, const char *szId)
 		return 0;
 	
 	DBEventIdKey keyId;
-	keyId.iModuleId = GetModuleID(szModule);
 	strncpy_s(keyId.szEventId, szId, _TRUNCATE);
 
+	// most lookups during history sync are misses, skip the b-tree for them
+	if (!EventIdFilterCheck(keyId.szEventId))
+		return 0;
+
+	keyId.iModuleId = GetModuleID(szModule);
+
+	txn_ptr_ro txn(this);
+
 	MDBX_val key = { &keyId, sizeof(MEVENT) + strlen(keyId.szEventId) + 1 }, data;
-	if (mdbx_get(StartTran(), m_dbEventIds, &key, &data) != MDBX_SUCCESS)
+	if (mdbx_get(txn, m_dbEventIds, &key, &data) != MDBX_SUCCESS)
 		return 0;
 
 	MEVENT hDbEvent = *(MEVENT *)data.iov_base;
 	MDBX_val key2 = { &hDbEvent, sizeof(MEVENT) }, data2;
-	if (mdbx_get(StartTran(), m_dbEvents, &key2, &data2) != MDBX_SUCCESS)
+	if (mdbx_get(txn, m_dbEvents, &key2, &data2) != MDBX_SUCCESS)
 		return 0;
 
 	return hDbEvent;
@@ -474,13 +496,65 @@ MCONTACT CDbxMDBX::GetEventContact(MEVENT hDbEvent)
 	if (hDbEvent == 0)
 		return INVALID_CONTACT_ID;
 
+	txn_ptr_ro txn(this);
+
 	MDBX_val key = { &hDbEvent, sizeof(MEVENT) }, data;
-	if (mdbx_get(StartTran(), m_dbEvents, &key, &data) != MDBX_SUCCESS)
+	if (mdbx_get(txn, m_dbEvents, &key, &data) != MDBX_SUCCESS)
 		return INVALID_CONTACT_ID;
 
 	return ((const DBEvent*)data.iov_base)->dwContactID;
 }
 
+/////////////////////////////////////////////////////////////////////////////////////////
+// metacontact's history is a merge of its own sorting keys and the ones of its subs.
+// finds the nearest key after (or before) pos in any of them
+
+bool CDbxMDBX::FindMetaEvent(MDBX_cursor *cursor, DBCachedContact *cc, const DBEventSortingKey &pos, bool bForward, bool bInclusive, DBEventSortingKey &result)
+{
+	bool bFound = false;
+
+	for (int i = -1; i < cc->nSubs; i++) {
+		MCONTACT hSource = cc->contactID;
+		if (i != -1) {
+			DBCachedContact *ccSub = m_cache->GetCachedContact(cc->pSubs[i]);
+			if (ccSub == nullptr || ccSub->parentID != cc->contactID) // a sub being detached
+				continue;
+			hSource = ccSub->contactID;
+		}
+
+		// SET_RANGE stands on the first key >= pos, move from it if needed
+		DBEventSortingKey keyVal = { hSource, pos.hEvent, pos.ts };
+		MDBX_val key = { &keyVal, sizeof(keyVal) }, data;
+		int res = mdbx_cursor_get(cursor, &key, &data, MDBX_SET_RANGE);
+
+		const DBEventSortingKey *pKey = (const DBEventSortingKey *)key.iov_base;
+		bool bExact = (res == MDBX_SUCCESS) && pKey->hContact == hSource && pKey->ts == pos.ts && pKey->hEvent == pos.hEvent;
+		if (bForward) {
+			if (bExact && !bInclusive)
+				res = mdbx_cursor_get(cursor, &key, &data, MDBX_NEXT);
+		}
+		else if (res != MDBX_SUCCESS)
+			res = mdbx_cursor_get(cursor, &key, &data, MDBX_LAST);
+		else if (!bExact || !bInclusive)
+			res = mdbx_cursor_get(cursor, &key, &data, MDBX_PREV);
+
+		if (res != MDBX_SUCCESS)
+			continue;
+
+		pKey = (const DBEventSortingKey *)key.iov_base;
+		if (pKey->hContact != hSource)
+			continue;
+
+		bool bLess = (pKey->ts < result.ts) || (pKey->ts == result.ts && pKey->hEvent < result.hEvent);
+		if (!bFound || bLess == bForward) {
+			result = *pKey;
+			bFound = true;
+		}
+	}
+
+	return bFound;
+}
+
 /////////////////////////////////////////////////////////////////////////////////////////
 
 MEVENT CDbxMDBX::FindFirstEvent(MCONTACT contactID)
@@ -496,8 +570,18 @@ MEVENT CDbxMDBX::FindFirstEvent(MCONTACT contactID)
 	DBEventSortingKey keyVal = { contactID, 0, 0 };
 	MDBX_val key = { &keyVal, sizeof(keyVal) }, data;
 
-	mdbx_cursor_bind(StartTran(), m_curEventsSort, m_dbEventsSort);
-	if (mdbx_cursor_get(m_curEventsSort, &key, &data, MDBX_SET_RANGE) != MDBX_SUCCESS)
+	txn_ptr_ro txn(this);
+	MDBX_cursor *cursor = txn.sortCursor();
+	if (cc->IsMeta()) {
+		DBEventSortingKey dbKey;
+		if (!FindMetaEvent(cursor, cc, keyVal, true, true, dbKey))
+			return cc->t_evLast = 0;
+
+		cc->t_tsLast = dbKey.ts;
+		return cc->t_evLast = dbKey.hEvent;
+	}
+
+	if (mdbx_cursor_get(cursor, &key, &data, MDBX_SET_RANGE) != MDBX_SUCCESS)
 		return cc->t_evLast = 0;
 
 	const DBEventSortingKey *pKey = (const DBEventSortingKey*)key.iov_base;
@@ -531,14 +615,23 @@ MEVENT CDbxMDBX::FindLastEvent(MCONTACT contactID)
 	DBEventSortingKey keyVal = { contactID, 0xFFFFFFFF, 0xFFFFFFFFFFFFFFFF };
 	MDBX_val key = { &keyVal, sizeof(keyVal) }, data;
 
-	mdbx_cursor_bind(StartTran(), m_curEventsSort, m_dbEventsSort);
+	txn_ptr_ro txn(this);
+	MDBX_cursor *cursor = txn.sortCursor();
+	if (cc->IsMeta()) {
+		DBEventSortingKey dbKey;
+		if (!FindMetaEvent(cursor, cc, keyVal, false, true, dbKey))
+			return cc->t_evLast = 0;
 
-	if (mdbx_cursor_get(m_curEventsSort, &key, &data, MDBX_SET_RANGE) != MDBX_SUCCESS) {
-		if (mdbx_cursor_get(m_curEventsSort, &key, &data, MDBX_LAST) != MDBX_SUCCESS)
+		cc->t_tsLast = dbKey.ts;
+		return cc->t_evLast = dbKey.hEvent;
+	}
+
+	if (mdbx_cursor_get(cursor, &key, &data, MDBX_SET_RANGE) != MDBX_SUCCESS) {
+		if (mdbx_cursor_get(cursor, &key, &data, MDBX_LAST) != MDBX_SUCCESS)
 			return cc->t_evLast = 0;
 	}
 	else {
-		if (mdbx_cursor_get(m_curEventsSort, &key, &data, MDBX_PREV) != MDBX_SUCCESS)
+		if (mdbx_cursor_get(cursor, &key, &data, MDBX_PREV) != MDBX_SUCCESS)
 			return cc->t_evLast = 0;
 	}
 
@@ -565,9 +658,11 @@ MEVENT CDbxMDBX::FindNextEvent(MCONTACT contactID, MEVENT hDbEvent)
 	if (hDbEvent == 0)
 		return cc->t_evLast = 0;
 
+	txn_ptr_ro txn(this);
+
 	if (cc->t_evLast != hDbEvent) {
 		MDBX_val key = { &hDbEvent, sizeof(MEVENT) }, data;
-		if (mdbx_get(StartTran(), m_dbEvents, &key, &data) != MDBX_SUCCESS)
+		if (mdbx_get(txn, m_dbEvents, &key, &data) != MDBX_SUCCESS)
 			return 0;
 		cc->t_tsLast = ((DBEvent*)data.iov_base)->timestamp;
 	}
@@ -575,11 +670,20 @@ MEVENT CDbxMDBX::FindNextEvent(MCONTACT contactID, MEVENT hDbEvent)
 	DBEventSortingKey keyVal = { contactID, hDbEvent, cc->t_tsLast };
 	MDBX_val key = { &keyVal, sizeof(keyVal) }, data;
 
-	mdbx_cursor_bind(StartTran(), m_curEventsSort, m_dbEventsSort);
-	if (mdbx_cursor_get(m_curEventsSort, &key, nullptr, MDBX_SET) != MDBX_SUCCESS)
+	MDBX_cursor *cursor = txn.sortCursor();
+	if (cc->IsMeta()) {
+		DBEventSortingKey dbKey;
+		if (!FindMetaEvent(cursor, cc, keyVal, true, false, dbKey))
+			return cc->t_evLast = 0;
+
+		cc->t_tsLast = dbKey.ts;
+		return cc->t_evLast = dbKey.hEvent;
+	}
+
+	if (mdbx_cursor_get(cursor, &key, nullptr, MDBX_SET) != MDBX_SUCCESS)
 		return cc->t_evLast = 0;
 
-	if (mdbx_cursor_get(m_curEventsSort, &key, &data, MDBX_NEXT) != MDBX_SUCCESS)
+	if (mdbx_cursor_get(cursor, &key, &data, MDBX_NEXT) != MDBX_SUCCESS)
 		return cc->t_evLast = 0;
 
 	const DBEventSortingKey *pKey = (const DBEventSortingKey*)key.iov_base;
@@ -602,11 +706,12 @@ MEVENT CDbxMDBX::FindPrevEvent(MCONTACT contactID, MEVENT hDbEvent)
 	if (hDbEvent == 0)
 		return cc->t_evLast = 0;
 
+	txn_ptr_ro txn(this);
 	MDBX_val data;
 
 	if (cc->t_evLast != hDbEvent) {
 		MDBX_val key = { &hDbEvent, sizeof(MEVENT) };
-		if (mdbx_get(StartTran(), m_dbEvents, &key, &data) != MDBX_SUCCESS)
+		if (mdbx_get(txn, m_dbEvents, &key, &data) != MDBX_SUCCESS)
 			return 0;
 		cc->t_tsLast = ((DBEvent*)data.iov_base)->timestamp;
 	}
@@ -614,11 +719,20 @@ MEVENT CDbxMDBX::FindPrevEvent(MCONTACT contactID, MEVENT hDbEvent)
 	DBEventSortingKey keyVal = { contactID, hDbEvent, cc->t_tsLast };
 	MDBX_val key = { &keyVal, sizeof(keyVal) };
 
-	mdbx_cursor_bind(StartTran(), m_curEventsSort, m_dbEventsSort);
-	if (mdbx_cursor_get(m_curEventsSort, &key, nullptr, MDBX_SET) != MDBX_SUCCESS)
+	MDBX_cursor *cursor = txn.sortCursor();
+	if (cc->IsMeta()) {
+		DBEventSortingKey dbKey;
+		if (!FindMetaEvent(cursor, cc, keyVal, false, false, dbKey))
+			return cc->t_evLast = 0;
+
+		cc->t_tsLast = dbKey.ts;
+		return cc->t_evLast = dbKey.hEvent;
+	}
+
+	if (mdbx_cursor_get(cursor, &key, nullptr, MDBX_SET) != MDBX_SUCCESS)
 		return cc->t_evLast = 0;
 
-	if (mdbx_cursor_get(m_curEventsSort, &key, &data, MDBX_PREV) != MDBX_SUCCESS)
+	if (mdbx_cursor_get(cursor, &key, &data, MDBX_PREV) != MDBX_SUCCESS)
 		return cc->t_evLast = 0;
 
 	const DBEventSortingKey *pKey = (const DBEventSortingKey*)key.iov_base;
@@ -666,15 +780,27 @@ public:
 			return m_key.hEvent;
 		}
 
-		mdbx_cursor_bind(m_pOwner->StartTran(), m_pOwner->m_curEventsSort, m_pOwner->m_dbEventsSort);
+		txn_ptr_ro txn(m_pOwner);
+		MDBX_cursor *cursor = txn.sortCursor();
+
+		// metacontact's history is merged from the subs, its keys are found in their ranges
+		if (m_cc->IsMeta()) {
+			DBEventSortingKey dbKey;
+			if (!m_pOwner->FindMetaEvent(cursor, m_cc, m_key, m_bForward, false, dbKey))
+				return 0;
+
+			m_key.hEvent = dbKey.hEvent;
+			m_key.ts = dbKey.ts;
+			return dbKey.hEvent;
+		}
 
 		// this is precise key position, if it doesn't exist - return
 		MDBX_val key = { &m_key, sizeof(m_key) }, data;
-		if (mdbx_cursor_get(m_pOwner->m_curEventsSort, &key, &data, MDBX_SET) != MDBX_SUCCESS)
+		if (mdbx_cursor_get(cursor, &key, &data, MDBX_SET) != MDBX_SUCCESS)
 			return 0;
 
 		// move one record ahead or backward
-		if (mdbx_cursor_get(m_pOwner->m_curEventsSort, &key, &data, (m_bForward) ? MDBX_NEXT : MDBX_PREV) != MDBX_SUCCESS)
+		if (mdbx_cursor_get(cursor, &key, &data, (m_bForward) ? MDBX_NEXT : MDBX_PREV) != MDBX_SUCCESS)
 			return 0;
 
 		// and this record should belong to the same contact
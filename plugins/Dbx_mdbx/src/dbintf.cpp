@@ -29,6 +29,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 CDbxMDBX::CDbxMDBX(const wchar_t *tszFileName, int iMode) :
 	m_bReadOnly((iMode & DBMODE_READONLY) != 0),
 	m_pwszProfileName(mir_wstrdup(tszFileName)),
+	m_arReaders(10, NumericKeySortT),
 	m_impl(*this)
 {
 	m_ccDummy.nSubs = -1;
@@ -39,9 +40,7 @@ CDbxMDBX::~CDbxMDBX()
 	if (m_pWriteTran)
 		mdbx_txn_commit(m_pWriteTran);
 
-	if (m_curEventsSort)
-		mdbx_cursor_close(m_curEventsSort);
-
+	CloseReaders();
 	mdbx_env_close(m_env);
 
 	if (!m_bReadOnly)
@@ -67,6 +66,7 @@ BOOL CDbxMDBX::Backup(const wchar_t *pwszPath)
 	if (m_pWriteTran) {
 		mdbx_txn_commit(m_pWriteTran);
 		m_pWriteTran = nullptr;
+		OnCommit();
 	}
 
 	int res = mdbx_env_copy2fd(m_env, pFile, MDBX_CP_COMPACT);
@@ -120,6 +120,7 @@ BOOL CDbxMDBX::Compact()
 	if (res)
 		return res;
 
+	CloseReaders();
 	mdbx_env_close(m_env);
 
 	DeleteFileW(m_pwszProfileName);
@@ -140,6 +141,7 @@ void CDbxMDBX::DBFlush(bool bForce)
 		if (m_pWriteTran) {
 			mdbx_txn_commit(m_pWriteTran);
 			mdbx_env_sync(m_env);
+			OnCommit();
 
 			m_pWriteTran = nullptr;
 			m_dbError = mdbx_txn_begin(m_env, nullptr, MDBX_TXN_READWRITE, &m_pWriteTran);
@@ -185,10 +187,17 @@ int CDbxMDBX::Load()
 			const DBHeader *hdr = (const DBHeader *)data.iov_base;
 			if (hdr->dwSignature != DBHEADER_SIGNATURE)
 				return EGROKPRF_DAMAGED;
-			if (hdr->dwVersion != DBHEADER_VERSION)
-				return EGROKPRF_OBSOLETE;
-
 			m_header = *hdr;
+			if (m_header.dwVersion != DBHEADER_VERSION) {
+				if (m_header.dwVersion != DBHEADER_VERSION_14 || m_bReadOnly)
+					return EGROKPRF_OBSOLETE;
+
+				DropMetaSortingKeys();
+
+				m_header.dwVersion = DBHEADER_VERSION;
+				data.iov_base = &m_header; data.iov_len = sizeof(m_header);
+				mdbx_put(m_pWriteTran, m_dbGlobal, &key, &data, MDBX_UPSERT);
+			}
 		} else {
 			m_header.dwSignature = DBHEADER_SIGNATURE;
 			m_header.dwVersion = DBHEADER_VERSION;
@@ -202,7 +211,7 @@ int CDbxMDBX::Load()
 			m_ccDummy.dbc = *(const DBContact *)data.iov_base;
 	}
 
-	m_curEventsSort = mdbx_cursor_create(nullptr);
+	m_dwReadersSerial = InterlockedIncrement(&g_dwReadersSerial);
 
 	MDBX_val key, val;
 	{
@@ -215,6 +224,15 @@ int CDbxMDBX::Load()
 		if (mdbx_cursor_get(pCursor, &key, &val, MDBX_LAST) == MDBX_SUCCESS)
 			m_maxContactId = *(MCONTACT *)key.iov_base;
 	}
+	{
+		MDBX_stat st;
+		mdbx_dbi_stat(m_pWriteTran, m_dbEventIds, &st, sizeof(st));
+		EventIdFilterInit((uint32_t)st.ms_entries);
+
+		cursor_ptr pCursor(m_pWriteTran, m_dbEventIds);
+		for (int res = mdbx_cursor_get(pCursor, &key, &val, MDBX_FIRST); res == MDBX_SUCCESS; res = mdbx_cursor_get(pCursor, &key, &val, MDBX_NEXT))
+			EventIdFilterAdd(((const DBEventIdKey *)key.iov_base)->szEventId);
+	}
 
 	mdbx_txn_commit(m_pWriteTran); m_pWriteTran = nullptr;
 
@@ -283,6 +301,34 @@ int CDbxMDBX::Map()
 	return EGROKPRF_NOERROR;
 }
 
+/////////////////////////////////////////////////////////////////////////////////////////
+// makes the readers see the committed data
+
+void CDbxMDBX::OnCommit()
+{
+	InterlockedIncrement(&m_dwGeneration);
+	m_bWriteDirty = false;
+	ParkReaders();
+}
+
+// a reader of another thread needs the changes, which are waiting for the flush timer.
+// the environment isn't synced here, the timer does it later
+
+void CDbxMDBX::CommitPending()
+{
+	mir_cslock lck(m_csDbAccess);
+	if (!m_bWriteDirty || m_pWriteTran == nullptr)
+		return;
+
+	mdbx_txn_commit(m_pWriteTran);
+	OnCommit();
+
+	m_pWriteTran = nullptr;
+	m_dbError = mdbx_txn_begin(m_env, nullptr, (m_bReadOnly) ? MDBX_TXN_RDONLY : MDBX_TXN_READWRITE, &m_pWriteTran);
+	// FIXME: throw an exception
+	_ASSERT(m_dbError == MDBX_SUCCESS);
+}
+
 /////////////////////////////////////////////////////////////////////////////////////////
 
 int CDbxMDBX::PrepareCheck()
@@ -36,7 +36,8 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 #include <pshpack1.h>
 
-#define DBHEADER_VERSION    MAKELONG(1, 4)
+#define DBHEADER_VERSION    MAKELONG(1, 5)
+#define DBHEADER_VERSION_14 MAKELONG(1, 4) // stored copies of subs' sorting keys in metacontacts
 #define DBHEADER_SIGNATURE  0x40DECADEu
 struct DBHeader
 {
@@ -133,6 +134,35 @@ struct EventItem
 	MEVENT eventId;
 };
 
+/////////////////////////////////////////////////////////////////////////////////////////
+// per-thread read-only snapshot, renewed lazily after the writer commits
+
+struct DBReader
+{
+	DBReader(uint32_t _threadId) :
+		dwThreadId(_threadId),
+		curEventsSort(mdbx_cursor_create(nullptr))
+	{}
+
+	~DBReader()
+	{
+		mdbx_cursor_close(curEventsSort);
+		if (txn)
+			mdbx_txn_abort(txn);
+	}
+
+	uint32_t     dwThreadId;    // must be the first field, the list is sorted by it
+	MDBX_txn    *txn = nullptr;
+	MDBX_cursor *curEventsSort;
+	uint32_t     dwGeneration = 0;
+	bool         bActive = false;  // snapshot is acquired and holds a reader slot
+	bool         bWriter = false;  // current scope reads the pending write transaction
+	int          iDepth = 0;       // nesting level of txn_ptr_ro on the owner thread
+	volatile long lBusy = 0;       // 1 while the owner thread reads, or while the writer parks it
+};
+
+struct CheckTotals;
+
 class CDbxMDBX : public MDatabaseCommon, public MIDatabaseChecker, public MZeroedObject
 {
 	friend class CMdbxEventCursor;
@@ -161,6 +191,13 @@ class CDbxMDBX : public MDatabaseCommon, public MIDatabaseChecker, public MZeroe
 
 	MDBX_txn* StartTran();
 
+	DBReader* GetReader();
+	bool      RenewReader(DBReader *pReader);
+	void      ParkReaders();
+	void      CloseReaders();
+	void      CommitPending();
+	void      OnCommit();
+
 	bool CheckEvent(DBCachedContact *cc, const DBEvent *dbe, DBCachedContact *&cc2);
 	bool EditEvent(MCONTACT contactID, MEVENT hDbEvent, const DBEVENTINFO *dbe, bool bNew);
 	int  PrepareCheck(void);
@@ -175,6 +212,16 @@ class CDbxMDBX : public MDatabaseCommon, public MIDatabaseChecker, public MZeroe
 	MDBX_env    *m_env;
 	MDBX_txn    *m_pWriteTran;
 	int 			 m_dbError;
+	bool         m_bWriteDirty;  // m_pWriteTran contains uncommitted changes
+	uint32_t     m_dwWriterThread; // thread inside txn_ptr scope, if any
+
+	////////////////////////////////////////////////////////////////////////////
+	// readers
+
+	mir_cs       m_csReaders;
+	OBJLIST<DBReader> m_arReaders;
+	uint32_t     m_dwReadersSerial; // identifies m_arReaders in threads' local caches
+	volatile long m_dwGeneration;   // incremented on each commit of m_pWriteTran
 
 	MDBX_dbi     m_dbGlobal;
 	DBHeader     m_header;
@@ -202,10 +249,11 @@ class CDbxMDBX : public MDatabaseCommon, public MIDatabaseChecker, public MZeroe
 	// events
 
 	MDBX_dbi	    m_dbEvents, m_dbEventsSort, m_dbEventIds;
-	MDBX_cursor *m_curEventsSort;
 	MEVENT       m_dwMaxEventId;
 
 	void         FindNextUnread(const txn_ptr &_txn, DBCachedContact *cc, DBEventSortingKey &key2);
+	bool         FindMetaEvent(MDBX_cursor *cursor, DBCachedContact *cc, const DBEventSortingKey &pos, bool bForward, bool bInclusive, DBEventSortingKey &result);
+	void         DropMetaSortingKeys(void);
 
 	////////////////////////////////////////////////////////////////////////////
 	// modules
@@ -223,6 +271,38 @@ class CDbxMDBX : public MDatabaseCommon, public MIDatabaseChecker, public MZeroe
 
 	MDBX_dbi m_dbCrypto;
 
+	////////////////////////////////////////////////////////////////////////////
+	// checker
+
+	struct CheckEventRec
+	{
+		MEVENT   hEvent;
+		MCONTACT hContact;
+		uint64_t ts;
+		bool     bRead, bHasId, bBroken, bIndexed;
+	};
+
+	std::vector<CheckEventRec> m_checkEvents;   // all events, sorted by id
+	std::vector<DBEventSortingKey> m_checkKeys; // the whole sorting index, during the first phase
+	std::vector<bool> m_checkEventBits, m_checkContactBits;
+
+	static void __cdecl CheckScanTask(void *param);
+
+	size_t CheckScanContacts(MDBX_txn *txn);
+	size_t CheckScanEvents(MDBX_txn *txn);
+	size_t CheckScanSortingKeys(MDBX_txn *txn);
+
+	bool   CheckContactExists(MCONTACT hContact) const;
+	bool   CheckCounters(const txn_ptr &txn, DBCachedContact *cc, const CheckTotals &snapshot);
+	const  CheckEventRec* CheckFindEvent(MEVENT hEvent) const;
+	bool   CheckFirstUnread(DBCachedContact *cc, const CheckTotals &tot, const CheckEventRec *ev);
+	bool   CheckLiveContact(MDBX_txn *txn, MCONTACT hContact);
+	bool   CheckLiveEvent(MDBX_txn *txn, MEVENT hEvent, CheckEventRec &ev);
+	void   CheckLiveTotals(MDBX_txn *txn, MCONTACT hContact, CheckTotals &tot);
+
+	static void CheckFillEvent(MEVENT hEvent, const MDBX_val &data, CheckEventRec &ev);
+	void   CheckReport(const wchar_t *pwszTable, size_t nRecords, uint32_t dwTicks);
+
 public:
 	CDbxMDBX(const wchar_t *tszFileName, int mode);
 	virtual ~CDbxMDBX();
@@ -235,6 +315,7 @@ public:
 	int  CheckEvents1(void);
 	int  CheckEvents2(void);
 	int  CheckEvents3(void);
+	int  CheckEvents4(void);
 
 public:
 	STDMETHODIMP_(BOOL)     IsRelational(void) override { return TRUE; }
@@ -296,16 +377,9 @@ protected:
 		return this;
 	}
 
-	STDMETHODIMP_(BOOL) Start(DBCHeckCallback *callback)
-	{
-		cb = callback;
-		return ERROR_SUCCESS;
-	}
-
-	STDMETHODIMP_(VOID) Destroy()
-	{}
-
+	STDMETHODIMP_(BOOL) Start(DBCHeckCallback *callback);
 	STDMETHODIMP_(BOOL) CheckDb(int phase);
+	STDMETHODIMP_(VOID) Destroy();
 
 	DBCHeckCallback *cb;
 };
@@ -57,14 +57,156 @@ int DBSettingKey::Compare(const MDBX_val *ax, const MDBX_val *bx) MDBX_CXX17_NOE
 /////////////////////////////////////////////////////////////////////////////////////////
 // txn_ptr class 
 
+// readers of this thread must see the changes made in this scope, so they read the write
+// transaction till its end. the transaction is supposed to be dirty till then too, and
+// then it's checked whether anything was written
+
 txn_ptr::txn_ptr(CDbxMDBX *_db) :
 	pDb(_db),
 	txn(_db->StartTran())
 {
 	_db->m_csDbAccess.Lock();
+	bWasDirty = _db->m_bWriteDirty;
+	_db->m_bWriteDirty = true;
+	dwPrevWriter = _db->m_dwWriterThread;
+	_db->m_dwWriterThread = ::GetCurrentThreadId();
 }
 
 txn_ptr::~txn_ptr()
 {
+	if (!bWasDirty) {
+		MDBX_txn_info info;
+		if (mdbx_txn_info(txn, &info, false) == MDBX_SUCCESS && info.txn_space_dirty == 0)
+			pDb->m_bWriteDirty = false;
+	}
+
+	pDb->m_dwWriterThread = dwPrevWriter;
 	pDb->m_csDbAccess.Unlock();
 }
+
+/////////////////////////////////////////////////////////////////////////////////////////
+// txn_ptr_ro class 
+
+txn_ptr_ro::txn_ptr_ro(CDbxMDBX *_db) :
+	pDb(_db),
+	pReader(_db->GetReader())
+{
+	if (pReader->iDepth++ == 0) {
+		// the writer might be parking our snapshot right now, wait for it
+		while (InterlockedCompareExchange(&pReader->lBusy, 1, 0))
+			YieldProcessor();
+
+		// only the writer's own thread reads its transaction. the others commit the pending
+		// changes first and take a fresh snapshot, so they never share the transaction
+		if (pDb->m_dwWriterThread == pReader->dwThreadId)
+			pReader->bWriter = true;
+		else {
+			if (pDb->m_bWriteDirty)
+				pDb->CommitPending();
+			pReader->bWriter = !pDb->RenewReader(pReader);
+		}
+	}
+
+	txn = (pReader->bWriter) ? pDb->StartTran() : pReader->txn;
+}
+
+txn_ptr_ro::~txn_ptr_ro()
+{
+	if (--pReader->iDepth == 0)
+		InterlockedExchange(&pReader->lBusy, 0);
+}
+
+MDBX_cursor* txn_ptr_ro::sortCursor() const
+{
+	mdbx_cursor_bind(txn, pReader->curEventsSort, pDb->m_dbEventsSort);
+	return pReader->curEventsSort;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////
+// readers' cache
+
+volatile long g_dwReadersSerial;
+
+static thread_local uint32_t tls_dwReadersSerial;
+static thread_local DBReader *tls_pReader;
+
+static bool IsThreadAlive(uint32_t dwThreadId)
+{
+	HANDLE hThread = ::OpenThread(SYNCHRONIZE, FALSE, dwThreadId);
+	if (hThread == nullptr)
+		return false;
+
+	bool bAlive = ::WaitForSingleObject(hThread, 0) == WAIT_TIMEOUT;
+	::CloseHandle(hThread);
+	return bAlive;
+}
+
+DBReader* CDbxMDBX::GetReader()
+{
+	if (tls_dwReadersSerial == m_dwReadersSerial)
+		return tls_pReader;
+
+	uint32_t dwThreadId = ::GetCurrentThreadId();
+
+	mir_cslock lck(m_csReaders);
+	DBReader *pReader = m_arReaders.find((DBReader *)&dwThreadId);
+	if (pReader == nullptr) {
+		// a new thread is a good moment to free the reader slots of finished ones.
+		// nobody else could refer to them, because a reader is used by its thread only
+		for (int i = m_arReaders.getCount() - 1; i >= 0; i--)
+			if (!IsThreadAlive(m_arReaders[i].dwThreadId))
+				m_arReaders.remove(i);
+
+		m_arReaders.insert(pReader = new DBReader(dwThreadId));
+	}
+
+	tls_dwReadersSerial = m_dwReadersSerial;
+	tls_pReader = pReader;
+	return pReader;
+}
+
+bool CDbxMDBX::RenewReader(DBReader *pReader)
+{
+	uint32_t dwGeneration = m_dwGeneration;
+	if (pReader->bActive) {
+		if (pReader->dwGeneration == dwGeneration)
+			return true;
+
+		mdbx_txn_reset(pReader->txn);
+		pReader->bActive = false;
+	}
+
+	int rc = (pReader->txn == nullptr) ? mdbx_txn_begin(m_env, nullptr, MDBX_TXN_RDONLY, &pReader->txn) : mdbx_txn_renew(pReader->txn);
+	if (rc != MDBX_SUCCESS) // reader table is full, for example
+		return false;
+
+	pReader->bActive = true;
+	pReader->dwGeneration = dwGeneration;
+	return true;
+}
+
+// releases idle snapshots, so that they don't keep the old pages from being reused
+
+void CDbxMDBX::ParkReaders()
+{
+	mir_cslock lck(m_csReaders);
+	for (auto &it : m_arReaders) {
+		if (!it->bActive)
+			continue;
+
+		if (InterlockedCompareExchange(&it->lBusy, 1, 0) == 0) {
+			if (it->bActive) {
+				mdbx_txn_reset(it->txn);
+				it->bActive = false;
+			}
+			InterlockedExchange(&it->lBusy, 0);
+		}
+	}
+}
+
+void CDbxMDBX::CloseReaders()
+{
+	mir_cslock lck(m_csReaders);
+	m_arReaders.destroy();
+	m_dwReadersSerial = InterlockedIncrement(&g_dwReadersSerial);
+}
@@ -83,6 +83,8 @@ class txn_ptr
 {
 	CDbxMDBX *pDb;
 	MDBX_txn *txn;
+	uint32_t dwPrevWriter;
+	bool bWasDirty;
 
 public:
 	txn_ptr(CDbxMDBX *_db);
@@ -91,6 +93,24 @@ public:
 	__forceinline operator MDBX_txn*() const { return txn; }
 };
 
+// read-only access: a thread's own snapshot, or the write transaction inside this thread's
+// txn_ptr scope. the snapshot stays valid till the end of the object's scope
+
+class txn_ptr_ro
+{
+	CDbxMDBX *pDb;
+	DBReader *pReader;
+	MDBX_txn *txn;
+
+public:
+	txn_ptr_ro(CDbxMDBX *_db);
+	~txn_ptr_ro();
+
+	MDBX_cursor* sortCursor() const;
+
+	__forceinline operator MDBX_txn*() const { return txn; }
+};
+
 #include "resource.h"
 #include "version.h"
 
@@ -101,3 +121,5 @@ struct CMPlugin : public PLUGIN<CMPlugin>
 	int Load() override;
 };
 
+
+extern volatile long g_dwReadersSerial;
@@ -21,6 +21,20 @@ void CDbxSQLite::InitEvents()
 	}
 	logError(rc, __FILE__, __LINE__);
 	sqlite3_finalize(stmt);
+
+	stmt = nullptr;
+	sqlite3_prepare_v2(m_db, "SELECT COUNT(1) FROM events WHERE server_id <> '';", -1, &stmt, nullptr);
+	rc = sqlite3_step(stmt);
+	logError(rc, __FILE__, __LINE__);
+	EventIdFilterInit((rc == SQLITE_ROW) ? (uint32_t)sqlite3_column_int64(stmt, 0) : 0);
+	sqlite3_finalize(stmt);
+
+	stmt = nullptr;
+	sqlite3_prepare_v2(m_db, "SELECT server_id FROM events WHERE server_id <> '';", -1, &stmt, nullptr);
+	while ((rc = sqlite3_step(stmt)) == SQLITE_ROW)
+		EventIdFilterAdd((char*)sqlite3_column_text(stmt, 0));
+	logError(rc, __FILE__, __LINE__);
+	sqlite3_finalize(stmt);
 }
 
 void CDbxSQLite::UninitEvents()
@@ -143,6 +157,9 @@ MEVENT CDbxSQLite::AddEvent(MCONTACT hContact, const DBEVENTINFO *dbei)
 	if (module == nullptr)
 		m_modules.insert(mir_strdup(tmp.szModule));
 
+	if (*szEventId)
+		EventIdFilterAdd(szEventId);
+
 	lock.unlock();
 
 	DBFlush();
@@ -623,6 +640,10 @@ MEVENT CDbxSQLite::GetEventById(LPCSTR szModule, LPCSTR szId)
 	if (szModule == nullptr || szId == nullptr)
 		return 0;
 
+	// most lookups during history sync are misses, skip the lock and the index for them
+	if (!EventIdFilterCheck(szId))
+		return 0;
+
 	mir_cslock lock(m_csDbAccess);
 	sqlite3_stmt *stmt = InitQuery("SELECT id, timestamp FROM events WHERE module = ? AND server_id = ? LIMIT 1;", qEvGetById);
 	sqlite3_bind_text(stmt, 1, szModule, (int)mir_strlen(szModule), nullptr);
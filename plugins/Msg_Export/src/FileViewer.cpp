@@ -368,6 +368,7 @@ void UpdateFileViews(const wchar_t *pszFile)
 bool bOpenExternaly(MCONTACT hContact)
 {
 	wstring sPath = GetFilePathFromUser(hContact);
+	CloseExportFile(sPath);
 
 	if (sFileViewerPrg.empty()) {
 		SHELLEXECUTEINFO st = { 0 };
@@ -469,6 +470,8 @@ bool bLoadFile(HWND hwndDlg, CLHistoryDlg *pclDlg)
 	if (!hRichEdit)
 		return false;
 
+	FlushExportFile(pclDlg->sPath);
+
 	HANDLE hFile = CreateFile(pclDlg->sPath.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
 	if (hFile == INVALID_HANDLE_VALUE) {
 		wchar_t szTmp[1500];
@@ -96,6 +96,7 @@ static INT_PTR ExportContactHistory(WPARAM hContact, LPARAM)
 int nSystemShutdown(WPARAM /*wparam*/, LPARAM /*lparam*/)
 {
 	WindowList_Broadcast(hInternalWindowList, WM_CLOSE, 0, 0);
+	UninitExportFiles();
 	return 0;
 }
 
@@ -117,6 +118,7 @@ int MainInit(WPARAM /*wparam*/, LPARAM /*lparam*/)
 {
 	bReadMirandaDirAndPath();
 	UpdateFileToColWidth();
+	InitExportFiles();
 
 	CMenuItem mi(&g_plugin);
 	SET_UID(mi, 0x4e889089, 0x2304, 0x425f, 0x8f, 0xaa, 0x4f, 0x8a, 0x7b, 0x26, 0x4d, 0x4d); // {4E889089-2304-425F-8FAA-4F8A7B264D4D}
@@ -159,6 +161,7 @@ int CMPlugin::Load()
 	HookEvent(ME_DB_EVENT_ADDED, nExportEvent);
 	HookEvent(ME_DB_EVENT_EDITED, nExportEvent);
 	HookEvent(ME_DB_CONTACT_DELETED, nContactDeleted);
+	HookEvent(ME_DB_CONTACT_SETTINGCHANGED, nContactSettingChanged);
 	HookEvent(ME_OPT_INITIALISE, OptionsInitialize);
 	HookEvent(ME_SYSTEM_MODULESLOADED, MainInit);
 
@@ -211,6 +214,7 @@ int CMPlugin::Load()
 
 int CMPlugin::Unload()
 {
+	CloseExportFiles();
 	WindowList_Destroy(hInternalWindowList);
 	bUseInternalViewer(false);
 	return 0;
@@ -167,29 +167,16 @@ void __cdecl exportContactsMessages(struct ExportDialogData *data)
 		// events with same time will not be swaped, they will 
 		// remain in there original order
 
-		// Open/create file for writing
-		wstring sFilePath = F.first;
-		HANDLE hFile = openCreateFile(sFilePath);
-		if (hFile == INVALID_HANDLE_VALUE) {
-			DisplayErrorDialog(LPGENW("Failed to open or create file:\n"), sFilePath, nullptr);
-			continue;
-		}
-
-		// At first write we need to have this false (to write file header, etc.), for each next write to same file use true
-		bool bAppendOnly = false;
-
+		const wstring &sFilePath = F.first;
 		for (auto &E : F.second) {
 			MEVENT hDbEvent = E.hDbEvent;
 			MCONTACT hContact = E.hUser;
-			if (!bExportEvent(hContact, hDbEvent, hFile, sFilePath, bAppendOnly))
+			if (!bExportEvent(hContact, hDbEvent, sFilePath))
 				break; // serious error, we should close the file and don't continue with it
-
-			// Set this flag, because we're appending to same file now
-			bAppendOnly = true;
 		}
 
-		// Close the file
-		CloseHandle(hFile);
+		// Write the rest and close the file
+		CloseExportFile(sFilePath);
 
 		SendMessage(hProg, PBM_SETPOS, ++nCur, 0);
 		RedrawWindow(hDlg, nullptr, nullptr, RDW_ALLCHILDREN | RDW_UPDATENOW);
@@ -324,6 +311,9 @@ public:
 
 		g_bUseLessAndGreaterInExport = IsDlgButtonChecked(m_hwnd, IDC_USE_LESS_AND_GREATER_IN_EXPORT) == BST_CHECKED;
 		g_plugin.setByte("UseLessAndGreaterInExport", g_bUseLessAndGreaterInExport);
+
+		// file names and format might have changed
+		CloseExportFiles();
 		return true;
 	}
 
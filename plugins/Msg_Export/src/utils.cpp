@@ -188,30 +188,31 @@ void LogLastError(const wchar_t *pszError)
 /////////////////////////////////////////////////////////////////////
 // Member Function : bWriteToFile
 // Type            : Global
-// Parameters      : hFile  - ?
+// Parameters      : sOut   - output buffer
 //                   pszSrc - in UTF8 or ANSII
 //                   nLen   - ?
-// Returns         : Returns true if all the data was written to the file
+// Returns         : Returns true if all the data was written to the buffer
 
-static bool bWriteToFile(HANDLE hFile, const char *pszSrc, int nLen = -1)
+static bool bWriteToFile(string &sOut, const char *pszSrc, int nLen = -1)
 {
 	if (nLen < 0)
 		nLen = (int)mir_strlen(pszSrc);
 
-	DWORD dwBytesWritten;
-	return WriteFile(hFile, pszSrc, nLen, &dwBytesWritten, nullptr) && (dwBytesWritten == (uint32_t)nLen);
+	if (nLen > 0)
+		sOut.append(pszSrc, nLen);
+	return true;
 }
 
 
 /////////////////////////////////////////////////////////////////////
 // Member Function : bWriteTextToFile
 // Type            : Global
-// Parameters      : hFile     - ?
+// Parameters      : sOut      - output buffer
 //                   pszSrc    - ?
 //                   bUtf8File - ?
 // Returns         : Returns true if 
 
-static bool bWriteTextToFile(HANDLE hFile, const wchar_t *pszSrc, bool bUtf8File, int nLen = -1)
+static bool bWriteTextToFile(string &sOut, const wchar_t *pszSrc, bool bUtf8File, int nLen = -1)
 {
 	if (nLen != -1) {
 		wchar_t *tmp = (wchar_t*)alloca(sizeof(wchar_t)*(nLen + 1));
@@ -222,17 +223,17 @@ static bool bWriteTextToFile(HANDLE hFile, const wchar_t *pszSrc, bool bUtf8File
 	if (!bUtf8File) {
 		// We need to downgrade text to ansi
 		ptrA pszAstr(mir_u2a(pszSrc));
-		return bWriteToFile(hFile, pszAstr, -1);
+		return bWriteToFile(sOut, pszAstr, -1);
 	}
 
-	return bWriteToFile(hFile, T2Utf(pszSrc), -1);
+	return bWriteToFile(sOut, T2Utf(pszSrc), -1);
 }
 
 
-static bool bWriteTextToFile(HANDLE hFile, const char *pszSrc, bool bUtf8File, int nLen = -1)
+static bool bWriteTextToFile(string &sOut, const char *pszSrc, bool bUtf8File, int nLen = -1)
 {
 	if (!bUtf8File)
-		return bWriteToFile(hFile, pszSrc, nLen);
+		return bWriteToFile(sOut, pszSrc, nLen);
 
 	if (nLen != -1) {
 		char *tmp = (char*)alloca(nLen + 1);
@@ -240,39 +241,39 @@ static bool bWriteTextToFile(HANDLE hFile, const char *pszSrc, bool bUtf8File, i
 		pszSrc = tmp;
 	}
 
-	return bWriteToFile(hFile, ptrA(mir_utf8encode(pszSrc)), -1);
+	return bWriteToFile(sOut, ptrA(mir_utf8encode(pszSrc)), -1);
 }
 
 /////////////////////////////////////////////////////////////////////
 // Member Function : bWriteNewLine
 // Type            : Global
-// Parameters      : hFile   - ?
+// Parameters      : sOut    - output buffer
 //                   nIndent - ?
-// Returns         : Returns true if all the data was written to the file
+// Returns         : Returns true if all the data was written to the buffer
 
 const char szNewLineIndent[] = "\r\n                                                                                                   ";
-bool bWriteNewLine(HANDLE hFile, uint32_t dwIndent)
+bool bWriteNewLine(string &sOut, uint32_t dwIndent)
 {
 	if (dwIndent > sizeof(szNewLineIndent) - 2)
 		dwIndent = sizeof(szNewLineIndent) - 2;
 	
-	return bWriteToFile(hFile, szNewLineIndent, dwIndent + 2);
+	return bWriteToFile(sOut, szNewLineIndent, dwIndent + 2);
 }
 
 /////////////////////////////////////////////////////////////////////
 // Member Function : bWriteHexToFile
 // Type            : Global
-// Parameters      : hFile - ?
+// Parameters      : sOut  - output buffer
 //                         - ?
 //                   nSize - ?
 
-bool bWriteHexToFile(HANDLE hFile, void * pData, int nSize)
+bool bWriteHexToFile(string &sOut, void * pData, int nSize)
 {
 	char cBuf[10];
 	uint8_t *p = (uint8_t*)pData;
 	for (int n = 0; n < nSize; n++) {
 		mir_snprintf(cBuf, "%.2X ", p[n]);
-		if (!bWriteToFile(hFile, cBuf, 3))
+		if (!bWriteToFile(sOut, cBuf, 3))
 			return false;
 	}
 	return true;
@@ -377,6 +378,8 @@ wstring GetFilePathFromUser(MCONTACT hContact)
 					else bTryRename = true;
 
 					if (bTryRename) {
+						CloseExportFile(sPrevFileName);
+
 						if (!MoveFile(sPrevFileName.c_str(), sFilePath.c_str())) {
 							// this might be because the new path isn't created 
 							// so we will try to create it 
@@ -579,31 +582,241 @@ void DisplayErrorDialog(const wchar_t *pszError, wstring &sFilePath, DBEVENTINFO
 				CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL,
 				(HANDLE)nullptr); // file handle
 
-			bWriteTextToFile(hf, sError.c_str(), false);
+			string sOut;
+			bWriteTextToFile(sOut, sError.c_str(), false);
 			if (dbei) {
-				bWriteToFile(hf, "\r\ndbei          :");
+				bWriteToFile(sOut, "\r\ndbei          :");
 
-				bWriteHexToFile(hf, dbei, sizeof(DBEVENTINFO));
+				bWriteHexToFile(sOut, dbei, sizeof(DBEVENTINFO));
 				if (dbei->pBlob) {
-					bWriteToFile(hf, "\r\ndbei.pBlob    :");
-					bWriteHexToFile(hf, dbei->pBlob, min(dbei->cbBlob, 10000));
+					bWriteToFile(sOut, "\r\ndbei.pBlob    :");
+					bWriteHexToFile(sOut, dbei->pBlob, min(dbei->cbBlob, 10000));
 				}
 				if (dbei->szModule) {
-					bWriteToFile(hf, "\r\ndbei.szModule :");
-					bWriteToFile(hf, dbei->szModule);
+					bWriteToFile(sOut, "\r\ndbei.szModule :");
+					bWriteToFile(sOut, dbei->szModule);
 				}
 			}
+
+			DWORD dwBytesWritten;
+			WriteFile(hf, sOut.data(), (DWORD)sOut.size(), &dwBytesWritten, nullptr);
 			CloseHandle(hf);
 		}
 	}
 }
 
+/////////////////////////////////////////////////////////////////////
+// Export file cache
+// Files of the recently active contacts are kept open and the formatted events
+// are collected in memory. Pending data is written out by a timer, when too much
+// of it is collected, and before the file is read, renamed or deleted.
+
+#define MAX_OPEN_FILES   16      // the least recently used file is closed above that
+#define MAX_PENDING_DATA 65536   // flush immediately when that much data is pending
+#define FLUSH_INTERVAL   2000    // ms
+#define IDLE_TIMEOUT     30000   // ms, idle files are closed after that
+
+struct CExportFile
+{
+	wstring sPath;
+	HANDLE hFile;
+	bool bJson;         // file ends with the "\n]}" tail which is rewritten at each flush
+	bool bUtf8;         // text is written in UTF8
+	bool bEmpty;        // nothing was exported yet, file header is required
+	string sBuf;        // pending output
+	uint32_t dwLastUse;
+};
+
+struct CExportPath
+{
+	wstring sPath;
+	uint16_t wDay;      // day of month when a path with time variables was resolved, otherwise 0
+};
+
+static list<CExportFile> g_arFiles; // most recently used first
+static map<MCONTACT, CExportPath> g_arPaths;
+static mir_cs csExportFiles;
+static UINT_PTR g_uFlushTimer;
+
+static bool FlushPending(CExportFile &F)
+{
+	if (F.sBuf.empty())
+		return true;
+
+	if (F.bJson)
+		F.sBuf += "\n]}";
+
+	DWORD dwBytesWritten;
+	bool bOk = WriteFile(F.hFile, F.sBuf.data(), (DWORD)F.sBuf.size(), &dwBytesWritten, nullptr) && dwBytesWritten == F.sBuf.size();
+	if (!bOk)
+		LogLastError((TranslateT("Failed to write to the file") + wstring(L"\r\n") + F.sPath).c_str());
+	else if (F.bJson)
+		SetFilePointer(F.hFile, -3, nullptr, FILE_CURRENT);
+
+	F.sBuf.clear();
+	UpdateFileViews(F.sPath.c_str());
+	return bOk;
+}
+
+static void CloseCached(list<CExportFile>::iterator it)
+{
+	FlushPending(*it);
+	CloseHandle(it->hFile);
+	g_arFiles.erase(it);
+}
+
+static CExportFile* OpenCached(const wstring &sFilePath)
+{
+	for (auto it = g_arFiles.begin(); it != g_arFiles.end(); ++it) {
+		if (it->sPath == sFilePath) {
+			g_arFiles.splice(g_arFiles.begin(), g_arFiles, it);
+			return &g_arFiles.front();
+		}
+	}
+
+	if (g_arFiles.size() >= MAX_OPEN_FILES)
+		CloseCached(--g_arFiles.end());
+
+	HANDLE hFile = openCreateFile(sFilePath);
+	if (hFile == INVALID_HANDLE_VALUE)
+		return nullptr;
+
+	CExportFile F;
+	F.sPath = sFilePath;
+	F.hFile = hFile;
+	F.bJson = g_bUseJson;
+	F.bUtf8 = g_bUseUtf8InNewFiles;
+	F.dwLastUse = GetTickCount();
+
+	LARGE_INTEGER liSize;
+	F.bEmpty = GetFileSizeEx(hFile, &liSize) && liSize.QuadPart == 0;
+	if (!F.bEmpty) {
+		DWORD dwDataRead = 0;
+		uint8_t ucByteOrder[3];
+		F.bUtf8 = ReadFile(hFile, ucByteOrder, 3, &dwDataRead, nullptr) && dwDataRead == 3 && bIsUtf8Header(ucByteOrder);
+
+		if (SetFilePointer(hFile, F.bJson ? -3 : 0, nullptr, FILE_END) == INVALID_SET_FILE_POINTER) {
+			CloseHandle(hFile);
+			return nullptr;
+		}
+	}
+
+	g_arFiles.push_front(F);
+	return &g_arFiles.front();
+}
+
+static void CALLBACK FlushTimerProc(HWND, UINT, UINT_PTR, DWORD)
+{
+	uint32_t dwNow = GetTickCount();
+
+	mir_cslock lck(csExportFiles);
+	for (auto it = g_arFiles.begin(); it != g_arFiles.end();) {
+		auto cur = it++;
+		if (!FlushPending(*cur) || dwNow - cur->dwLastUse > IDLE_TIMEOUT)
+			CloseCached(cur);
+	}
+}
+
+void InitExportFiles()
+{
+	g_uFlushTimer = SetTimer(nullptr, 0, FLUSH_INTERVAL, FlushTimerProc);
+}
+
+void UninitExportFiles()
+{
+	if (g_uFlushTimer) {
+		KillTimer(nullptr, g_uFlushTimer);
+		g_uFlushTimer = 0;
+	}
+
+	CloseExportFiles();
+}
+
+void FlushExportFile(const wstring &sFilePath)
+{
+	mir_cslock lck(csExportFiles);
+	for (auto &it : g_arFiles)
+		if (it.sPath == sFilePath) {
+			FlushPending(it);
+			break;
+		}
+}
+
+void CloseExportFile(const wstring &sFilePath)
+{
+	mir_cslock lck(csExportFiles);
+	for (auto it = g_arFiles.begin(); it != g_arFiles.end(); ++it)
+		if (it->sPath == sFilePath) {
+			CloseCached(it);
+			break;
+		}
+}
+
+void CloseExportFiles()
+{
+	mir_cslock lck(csExportFiles);
+	while (!g_arFiles.empty())
+		CloseCached(g_arFiles.begin());
+
+	g_arPaths.clear();
+}
+
+/////////////////////////////////////////////////////////////////////
+// Member Function : GetExportFilePath
+// Type            : Global
+// Parameters      : hContact - Handle to user
+// Returns         : the same as GetFilePathFromUser, but remembers the
+//                   result until the contact's settings are changed
+
+wstring GetExportFilePath(MCONTACT hContact)
+{
+	SYSTEMTIME stTime;
+	GetLocalTime(&stTime);
+	{
+		mir_cslock lck(csExportFiles);
+		auto it = g_arPaths.find(hContact);
+		if (it != g_arPaths.end() && (it->second.wDay == 0 || it->second.wDay == stTime.wDay))
+			return it->second.sPath;
+	}
+
+	wstring sFilePath = GetFilePathFromUser(hContact);
+
+	wstring sTemplate = g_sExportDir + _DBGetStringW(hContact, MODULENAME, "FileName", g_sDefaultFile.c_str());
+	bool bTimeUsed = sTemplate.find(L"%year%") != string::npos || sTemplate.find(L"%month%") != string::npos || sTemplate.find(L"%day%") != string::npos;
+
+	mir_cslock lck(csExportFiles);
+	CExportPath &P = g_arPaths[hContact];
+	P.sPath = sFilePath;
+	P.wDay = bTimeUsed ? stTime.wDay : 0;
+	return sFilePath;
+}
+
+/////////////////////////////////////////////////////////////////////
+// Member Function : nContactSettingChanged
+// Type            : Global
+// Parameters      : wparam - handle to the Contact
+//                   lparam - DBCONTACTWRITESETTING*
+// Returns         : int
+// Description     : Forgets the cached file path if the setting might affect it
+
+int nContactSettingChanged(WPARAM hContact, LPARAM lParam)
+{
+	if (hContact == 0)
+		return 0;
+
+	auto *cws = (DBCONTACTWRITESETTING *)lParam;
+	if (!strcmp(cws->szModule, MODULENAME) || !strcmp(cws->szModule, "CList") || !strcmp(cws->szModule, "Protocol") || !mir_strcmp(cws->szModule, Proto_GetBaseAccountName(hContact))) {
+		mir_cslock lck(csExportFiles);
+		g_arPaths.erase(hContact);
+	}
+	return 0;
+}
+
 /////////////////////////////////////////////////////////////////////
 // Member Function : ExportDBEventInfo
 // Type            : Global
 // Parameters      : hContact  - handle to contact
-//                   hFile     - handle to file
-//                   sFilePath - path to file
+//                   F         - export file
 //                   dbei      - Event to export
 // Returns         : false on serious error, when file should be closed to not lost/overwrite any data
 
@@ -629,7 +842,7 @@ static wchar_t* getEventString(DBEVENTINFO &dbei, char *&buf)
 	return (dbei.flags & DBEF_UTF) ? mir_utf8decodeW(in) : mir_a2u(in);
 }
 
-static bool ExportDBEventInfo(MCONTACT hContact, HANDLE hFile, const wstring &sFilePath, DBEVENTINFO &dbei, bool bAppendOnly)
+static bool ExportDBEventInfo(MCONTACT hContact, CExportFile &F, DBEVENTINFO &dbei)
 {
 	wstring sLocalUser;
 	wstring sRemoteUser;
@@ -643,13 +856,14 @@ static bool ExportDBEventInfo(MCONTACT hContact, HANDLE hFile, const wstring &sF
 	else {
 		sLocalUser = ptrW(GetMyOwnNick(hContact));
 		sRemoteUser = Clist_GetContactDisplayName(hContact);
-		nFirstColumnWidth = max(sRemoteUser.size(), clFileTo1ColWidth[sFilePath]);
+		nFirstColumnWidth = max(sRemoteUser.size(), clFileTo1ColWidth[F.sPath]);
 		nFirstColumnWidth = max(sLocalUser.size(), nFirstColumnWidth);
 		nFirstColumnWidth += 2;
 	}
 
 	wchar_t szTemp[500];
-	bool bWriteUTF8Format = false;
+	bool bWriteUTF8Format = F.bUtf8;
+	string &sOut = F.sBuf;
 
 	const char *szProto = Proto_GetBaseAccountName(hContact);
 	if (szProto == nullptr) {
@@ -657,112 +871,89 @@ static bool ExportDBEventInfo(MCONTACT hContact, HANDLE hFile, const wstring &sF
 		return false;
 	}
 
-	if (bAppendOnly) {
-		bWriteUTF8Format = g_bUseUtf8InNewFiles;
+	if (!F.bEmpty) {
+		if (F.bJson)
+			bWriteToFile(sOut, ",", 1);
+	}
+	else if (F.bJson) {
+		JSONNode pRoot, pInfo, pHist(JSON_ARRAY);
+		pInfo.set_name("info");
+		pInfo.push_back(JSONNode("user", T2Utf(sRemoteUser.c_str()).get()));
+		pInfo.push_back(JSONNode("proto", szProto));
+
+		ptrW id(Contact_GetInfo(CNF_UNIQUEID, hContact, szProto));
+		if (id != NULL)
+			pInfo.push_back(JSONNode("uin", T2Utf(id).get()));
+
+		szTemp[0] = (wchar_t)db_get_b(hContact, szProto, "Gender", 0);
+		if (szTemp[0]) {
+			szTemp[1] = 0;
+			pInfo.push_back(JSONNode("gender", T2Utf(szTemp).get()));
+		}
 
-		if (g_bUseJson) {
-			SetFilePointer(hFile, -3, nullptr, FILE_END);
-			bWriteToFile(hFile, ",", 1);
+		int age = db_get_w(hContact, szProto, "Age", 0);
+		if (age != 0)
+			pInfo.push_back(JSONNode("age", age));
+
+		for (auto &it : pSettings) {
+			wstring szValue = _DBGetStringW(hContact, szProto, it, L"");
+			if (!szValue.empty())
+				pInfo.push_back(JSONNode(it, T2Utf(szValue.c_str()).get()));
 		}
+		pRoot.push_back(pInfo);
+
+		pHist.set_name("history");
+		pRoot.push_back(pHist);
+
+		// the tail is written at each flush
+		std::string output = pRoot.write_formatted();
+		if (!bWriteTextToFile(sOut, output.c_str(), false, (int)output.size() - 3))
+			return false;
 	}
 	else {
-		DWORD dwHighSize = 0;
-		DWORD dwLowSize = GetFileSize(hFile, &dwHighSize);
-		if (dwLowSize == INVALID_FILE_SIZE || dwLowSize != 0 || dwHighSize != 0) {
-			DWORD dwDataRead = 0;
-			uint8_t ucByteOrder[3];
-			if (ReadFile(hFile, ucByteOrder, 3, &dwDataRead, nullptr))
-				bWriteUTF8Format = bIsUtf8Header(ucByteOrder);
-
-			DWORD dwPtr = SetFilePointer(hFile, g_bUseJson ? -3 : 0, nullptr, FILE_END);
-			if (dwPtr == INVALID_SET_FILE_POINTER)
+		if (bWriteUTF8Format)
+			if (!bWriteToFile(sOut, szUtf8ByteOrderHeader, sizeof(szUtf8ByteOrderHeader) - 1))
 				return false;
 
-			if (g_bUseJson)
-				bWriteToFile(hFile, ",", 1);		
-		}
-		else {
-			if (g_bUseJson) {
-				JSONNode pRoot, pInfo, pHist(JSON_ARRAY);
-				pInfo.set_name("info");
-				pInfo.push_back(JSONNode("user", T2Utf(sRemoteUser.c_str()).get()));
-				pInfo.push_back(JSONNode("proto", szProto));
-
-				ptrW id(Contact_GetInfo(CNF_UNIQUEID, hContact, szProto));
-				if (id != NULL)
-					pInfo.push_back(JSONNode("uin", T2Utf(id).get()));
-
-				szTemp[0] = (wchar_t)db_get_b(hContact, szProto, "Gender", 0);
-				if (szTemp[0]) {
-					szTemp[1] = 0;
-					pInfo.push_back(JSONNode("gender", T2Utf(szTemp).get()));
-				}
+		CMStringW output = L"------------------------------------------------\r\n";
+		output.AppendFormat(L"%s\r\n", TranslateT("      History for"));
 
-				int age = db_get_w(hContact, szProto, "Age", 0);
-				if (age != 0)
-					pInfo.push_back(JSONNode("age", age));
+		// This is written this way because I expect this will become a string the user may set 
+		// in the options dialog.
+		output.AppendFormat(L"%-10s: %s\r\n", TranslateT("User"), sRemoteUser.c_str());
+		output.AppendFormat(L"%-10s: %S\r\n", TranslateT("Account"), szProto);
 
-				for (auto &it : pSettings) {
-					wstring szValue = _DBGetStringW(hContact, szProto, it, L"");
-					if (!szValue.empty())
-						pInfo.push_back(JSONNode(it, T2Utf(szValue.c_str()).get()));
-				}
-				pRoot.push_back(pInfo);
+		ptrW id(Contact_GetInfo(CNF_UNIQUEID, hContact, szProto));
+		if (id != NULL)
+			output.AppendFormat(L"%-10s: %s\r\n", TranslateT("User ID"), id.get());
 
-				pHist.set_name("history");
-				pRoot.push_back(pHist);
+		szTemp[0] = (wchar_t)db_get_b(hContact, szProto, "Gender", 0);
+		if (szTemp[0]) {
+			szTemp[1] = 0;
+			output.AppendFormat(L"%-10s: %s\r\n", TranslateT("Gender"), szTemp);
+		}
 
-				std::string output = pRoot.write_formatted();
-				if (!bWriteTextToFile(hFile, output.c_str(), false, (int)output.size()))
-					return false;
+		int age = db_get_w(hContact, szProto, "Age", 0);
+		if (age != 0)
+			output.AppendFormat(L"%-10s: %d\r\n", TranslateT("Age"), age);
 
-				SetFilePointer(hFile, -3, nullptr, FILE_CURRENT);
+		for (auto &it : pSettings) {
+			wstring szValue = _DBGetStringW(hContact, szProto, it, L"");
+			if (!szValue.empty()) {
+				mir_snwprintf(szTemp, L"%-10s: %s\r\n", TranslateW(_A2T(it)), szValue.c_str());
+				output += szTemp;
 			}
-			else {
-				bWriteUTF8Format = g_bUseUtf8InNewFiles;
-				if (bWriteUTF8Format)
-					if (!bWriteToFile(hFile, szUtf8ByteOrderHeader, sizeof(szUtf8ByteOrderHeader) - 1))
-						return false;
-
-				CMStringW output = L"------------------------------------------------\r\n";
-				output.AppendFormat(L"%s\r\n", TranslateT("      History for"));
-
-				// This is written this way because I expect this will become a string the user may set 
-				// in the options dialog.
-				output.AppendFormat(L"%-10s: %s\r\n", TranslateT("User"), sRemoteUser.c_str());
-				output.AppendFormat(L"%-10s: %S\r\n", TranslateT("Account"), szProto);
-
-				ptrW id(Contact_GetInfo(CNF_UNIQUEID, hContact, szProto));
-				if (id != NULL)
-					output.AppendFormat(L"%-10s: %s\r\n", TranslateT("User ID"), id.get());
-
-				szTemp[0] = (wchar_t)db_get_b(hContact, szProto, "Gender", 0);
-				if (szTemp[0]) {
-					szTemp[1] = 0;
-					output.AppendFormat(L"%-10s: %s\r\n", TranslateT("Gender"), szTemp);
-				}
-
-				int age = db_get_w(hContact, szProto, "Age", 0);
-				if (age != 0)
-					output.AppendFormat(L"%-10s: %d\r\n", TranslateT("Age"), age);
-
-				for (auto &it : pSettings) {
-					wstring szValue = _DBGetStringW(hContact, szProto, it, L"");
-					if (!szValue.empty()) {
-						mir_snwprintf(szTemp, L"%-10s: %s\r\n", TranslateW(_A2T(it)), szValue.c_str());
-						output += szTemp;
-					}
-				}
+		}
 
-				output += L"------------------------------------------------\r\n";
+		output += L"------------------------------------------------\r\n";
 
-				if (!bWriteTextToFile(hFile, output, bWriteUTF8Format, output.GetLength()))
-					return false;
-			}
-		}
+		if (!bWriteTextToFile(sOut, output, bWriteUTF8Format, output.GetLength()))
+			return false;
 	}
 
-	if (g_bUseJson) {
+	F.bEmpty = false;
+
+	if (F.bJson) {
 		JSONNode pRoot;
 		pRoot.push_back(JSONNode("type", dbei.eventType));
 		if (mir_strcmp(dbei.szModule, szProto))
@@ -794,9 +985,7 @@ static bool ExportDBEventInfo(MCONTACT hContact, HANDLE hFile, const wstring &sF
 		}
 
 		std::string output = pRoot.write_formatted();
-		output += "\n]}";
-
-		if (!bWriteTextToFile(hFile, output.c_str(), false, (int)output.size()))
+		if (!bWriteTextToFile(sOut, output.c_str(), false, (int)output.size()))
 			return false;
 
 		return true;
@@ -811,7 +1000,7 @@ static bool ExportDBEventInfo(MCONTACT hContact, HANDLE hFile, const wstring &sF
 	szTemp[nIndent++] = ' ';
 
 	// Write first part of line with name and timestamp
-	if (!bWriteTextToFile(hFile, szTemp, bWriteUTF8Format, nIndent))
+	if (!bWriteTextToFile(sOut, szTemp, bWriteUTF8Format, nIndent))
 		return false;
 
 	if (dbei.pBlob != nullptr && dbei.cbBlob >= 2) {
@@ -819,7 +1008,7 @@ static bool ExportDBEventInfo(MCONTACT hContact, HANDLE hFile, const wstring &sF
 
 		switch (dbei.eventType) {
 		case EVENTTYPE_MESSAGE:
-			bWriteIndentedToFile(hFile, nIndent, ptrW(DbEvent_GetTextW(&dbei, CP_ACP)), bWriteUTF8Format);
+			bWriteIndentedToFile(sOut, nIndent, ptrW(DbEvent_GetTextW(&dbei, CP_ACP)), bWriteUTF8Format);
 			break;
 
 		case EVENTTYPE_FILE:
@@ -829,13 +1018,13 @@ static bool ExportDBEventInfo(MCONTACT hContact, HANDLE hFile, const wstring &sF
 				ptrW wszDescr(getEventString(dbei, p));
 
 				const wchar_t *pszType = LPGENW("File: ");
-				bWriteTextToFile(hFile, pszType, bWriteUTF8Format);
-				bWriteIndentedToFile(hFile, nIndent, wszFileName, bWriteUTF8Format);
+				bWriteTextToFile(sOut, pszType, bWriteUTF8Format);
+				bWriteIndentedToFile(sOut, nIndent, wszFileName, bWriteUTF8Format);
 
 				if (mir_wstrlen(wszDescr)) {
-					bWriteNewLine(hFile, nIndent);
-					bWriteTextToFile(hFile, LPGENW("Description: "), bWriteUTF8Format);
-					bWriteIndentedToFile(hFile, nIndent, wszDescr, bWriteUTF8Format);
+					bWriteNewLine(sOut, nIndent);
+					bWriteTextToFile(sOut, LPGENW("Description: "), bWriteUTF8Format);
+					bWriteIndentedToFile(sOut, nIndent, wszDescr, bWriteUTF8Format);
 				}
 			}
 			break;
@@ -852,7 +1041,7 @@ static bool ExportDBEventInfo(MCONTACT hContact, HANDLE hFile, const wstring &sF
 
 				if (dbei.cbBlob < 8 || dbei.cbBlob > 5000) {
 					int n = mir_snwprintf(szTemp, TranslateT("Invalid Database event received. Type %d, size %d"), dbei.eventType, dbei.cbBlob);
-					bWriteTextToFile(hFile, szTemp, bWriteUTF8Format, n);
+					bWriteTextToFile(sOut, szTemp, bWriteUTF8Format, n);
 					break;
 				}
 
@@ -872,18 +1061,18 @@ static bool ExportDBEventInfo(MCONTACT hContact, HANDLE hFile, const wstring &sF
 					pszTitle = LPGENW("The following user added you to their contact list:");
 				}
 
-				if (bWriteTextToFile(hFile, pszTitle, bWriteUTF8Format) &&
-					bWriteNewLine(hFile, nIndent) &&
-					bWriteTextToFile(hFile, LPGENW("UIN       :"), bWriteUTF8Format)) {
+				if (bWriteTextToFile(sOut, pszTitle, bWriteUTF8Format) &&
+					bWriteNewLine(sOut, nIndent) &&
+					bWriteTextToFile(sOut, LPGENW("UIN       :"), bWriteUTF8Format)) {
 					uint32_t uin = *((PDWORD)(dbei.pBlob));
 					int n = mir_snwprintf(szTemp, L"%d", uin);
-					if (bWriteTextToFile(hFile, szTemp, bWriteUTF8Format, n)) {
+					if (bWriteTextToFile(sOut, szTemp, bWriteUTF8Format, n)) {
 						char *pszEnd = (char *)(dbei.pBlob + sizeof(dbei));
 						for (int i = 0; i < nStringCount && pszCurBlobPos < pszEnd; i++) {
 							if (*pszCurBlobPos) {
-								if (!bWriteNewLine(hFile, nIndent) ||
-									!bWriteTextToFile(hFile, TranslateW(pszTypes[i]), bWriteUTF8Format) ||
-									!bWriteIndentedToFile(hFile, nIndent, _A2T(pszCurBlobPos), bWriteUTF8Format)) {
+								if (!bWriteNewLine(sOut, nIndent) ||
+									!bWriteTextToFile(sOut, TranslateW(pszTypes[i]), bWriteUTF8Format) ||
+									!bWriteIndentedToFile(sOut, nIndent, _A2T(pszCurBlobPos), bWriteUTF8Format)) {
 									break;
 								}
 								pszCurBlobPos += mir_strlen(pszCurBlobPos);
@@ -897,17 +1086,16 @@ static bool ExportDBEventInfo(MCONTACT hContact, HANDLE hFile, const wstring &sF
 
 		default:
 			int n = mir_snwprintf(szTemp, TranslateT("Unknown event type %d, size %d"), dbei.eventType, dbei.cbBlob);
-			bWriteTextToFile(hFile, szTemp, bWriteUTF8Format, n);
+			bWriteTextToFile(sOut, szTemp, bWriteUTF8Format, n);
 			break;
 		}
 	}
 	else {
 		int n = mir_snwprintf(szTemp, TranslateT("Unknown event type %d, size %d"), dbei.eventType, dbei.cbBlob);
-		bWriteTextToFile(hFile, szTemp, bWriteUTF8Format, n);
+		bWriteTextToFile(sOut, szTemp, bWriteUTF8Format, n);
 	}
 
-	bWriteToFile(hFile, g_bAppendNewLine ? "\r\n\r\n" : "\r\n");
-	UpdateFileViews(sFilePath.c_str());
+	bWriteToFile(sOut, g_bAppendNewLine ? "\r\n\r\n" : "\r\n");
 	return true;
 }
 
@@ -954,49 +1142,51 @@ int nExportEvent(WPARAM hContact, LPARAM hDbEvent)
 	if (!bIsExportEnabled(hContact))
 		return 0;
 	
-	// Open/create file for writing
-	wstring sFilePath = GetFilePathFromUser(hContact);
-	HANDLE hFile = openCreateFile(sFilePath);
-	if (hFile == INVALID_HANDLE_VALUE) {
-		DisplayErrorDialog(LPGENW("Failed to open or create file:\n"), sFilePath, nullptr);
-		return 0;
-	}
-
-	// Write the event
-	bExportEvent((MCONTACT)hContact, (MEVENT)hDbEvent, hFile, sFilePath, false);
-
-	// Close the file
-	CloseHandle(hFile);
-
+	bExportEvent((MCONTACT)hContact, (MEVENT)hDbEvent, GetExportFilePath(hContact));
 	return 0;
 }
 
-bool bExportEvent(MCONTACT hContact, MEVENT hDbEvent, HANDLE hFile, const wstring &sFilePath, bool bAppendOnly)
+bool bExportEvent(MCONTACT hContact, MEVENT hDbEvent, const wstring &sFilePath)
 {
-	bool result = true;
-
 	DB::EventInfo dbei;
 	dbei.cbBlob = -1;
-	if (!db_event_get(hDbEvent, &dbei)) {
-		if (db_mc_isMeta(hContact))
-			hContact = db_event_getContact(hDbEvent);
+	if (db_event_get(hDbEvent, &dbei))
+		return true;
+
+	if (db_mc_isMeta(hContact))
+		hContact = db_event_getContact(hDbEvent);
 
-		// Write the event
-		result = ExportDBEventInfo(hContact, hFile, sFilePath, dbei, bAppendOnly);
+	// Open/create file for writing
+	mir_cslockfull lck(csExportFiles);
+	CExportFile *pFile = OpenCached(sFilePath);
+	if (pFile == nullptr) {
+		lck.unlock();
+
+		wstring sError(sFilePath);
+		DisplayErrorDialog(LPGENW("Failed to open or create file:\n"), sError, nullptr);
+		return false;
 	}
 
+	// Write the event
+	bool result = ExportDBEventInfo(hContact, *pFile, dbei);
+	pFile->dwLastUse = GetTickCount();
+
+	if (pFile->sBuf.size() > MAX_PENDING_DATA)
+		if (!FlushPending(*pFile))
+			CloseCached(g_arFiles.begin());
+
 	return result;
 }
 
 /////////////////////////////////////////////////////////////////////
 // Member Function : bWriteIndentedToFile
 // Type            : Global
-// Parameters      : hFile   - ?
+// Parameters      : sOut    - output buffer
 //                   nIndent - ?
 //                   pszSrc  - 
 // Returns         : Returns true if 
 
-bool bWriteIndentedToFile(HANDLE hFile, int nIndent, const wchar_t *pszSrc, bool bUtf8File)
+bool bWriteIndentedToFile(string &sOut, int nIndent, const wchar_t *pszSrc, bool bUtf8File)
 {
 	if (pszSrc == nullptr)
 		return true;
@@ -1040,10 +1230,10 @@ bool bWriteIndentedToFile(HANDLE hFile, int nIndent, const wchar_t *pszSrc, bool
 		// nLineLen should contain the number af chars we need to write to the file 
 		if (nLineLen > 0) {
 			if (!bFirstLine)
-				if (!bWriteNewLine(hFile, nIndent))
+				if (!bWriteNewLine(sOut, nIndent))
 					bOk = false;
 
-			if (!bWriteTextToFile(hFile, pszSrc, bUtf8File, nLineLen))
+			if (!bWriteTextToFile(sOut, pszSrc, bUtf8File, nLineLen))
 				bOk = false;
 		}
 		bFirstLine = false;
@@ -1079,6 +1269,10 @@ int nContactDeleted(WPARAM hContact, LPARAM)
 	HWND hInternalWindow = WindowList_Find(hInternalWindowList, hContact);
 	if (hInternalWindow)
 		CloseWindow(hInternalWindow);
+	{
+		mir_cslock lck(csExportFiles);
+		g_arPaths.erase(hContact);
+	}
 
 	if (g_enDeleteAction == eDANothing)
 		return 0;
@@ -1090,6 +1284,8 @@ int nContactDeleted(WPARAM hContact, LPARAM)
 		if (hContact != hOtherContact && sFilePath == GetFilePathFromUser(hOtherContact))
 			return 0; // we found another contact abort mission :-)
 
+	CloseExportFile(sFilePath);
+
 	// Test to see if there is a file to delete
 	HANDLE hPrevFile = CreateFile(sFilePath.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
 	if (hPrevFile != INVALID_HANDLE_VALUE) {
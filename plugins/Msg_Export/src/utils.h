@@ -48,10 +48,17 @@ void DisplayErrorDialog(const wchar_t *pszError, wstring &sFilePath, DBEVENTINFO
 
 bool bIsExportEnabled(MCONTACT hContact);
 HANDLE openCreateFile(const wstring &sFilePath);
-bool bExportEvent(MCONTACT hContact, MEVENT hDbEvent, HANDLE hFile, const wstring &sFilePath, bool bAppendOnly);
+bool bExportEvent(MCONTACT hContact, MEVENT hDbEvent, const wstring &sFilePath);
+
+void InitExportFiles();
+void UninitExportFiles();
+void FlushExportFile(const wstring &sFilePath);
+void CloseExportFile(const wstring &sFilePath);
+void CloseExportFiles();
 
 int nExportEvent(WPARAM wparam, LPARAM lparam);
 int nContactDeleted(WPARAM wparam, LPARAM lparam);
+int nContactSettingChanged(WPARAM wparam, LPARAM lparam);
 
 wchar_t* GetMyOwnNick(MCONTACT hContact);
 
@@ -61,12 +68,13 @@ void UpdateFileToColWidth();
 
 bool bReadMirandaDirAndPath();
 wstring GetFilePathFromUser(MCONTACT hContact);
+wstring GetExportFilePath(MCONTACT hContact);
 
 void ReplaceDefines(MCONTACT hContact, wstring &sTarget);
 void ReplaceTimeVariables(wstring &sRet);
 
-bool bWriteIndentedToFile(HANDLE hFile, int nIndent, const wchar_t *pszSrc, bool bUtf8File);
-bool bWriteNewLine(HANDLE hFile, uint32_t dwIndent);
+bool bWriteIndentedToFile(string &sOut, int nIndent, const wchar_t *pszSrc, bool bUtf8File);
+bool bWriteNewLine(string &sOut, uint32_t dwIndent);
 bool bIsUtf8Header(uint8_t *pucByteOrder);
 
 #endif
@@ -9,6 +9,111 @@ sqlite3 *bayesdbg;
 #endif
 HANDLE hBayesFolder;
 
+/////////////////////////////////////////////////////////////////////////////////////////
+// token counts are kept in memory, in an open addressing hash table per type, keyed by
+// the token's md5 digest. changes are written back to sqlite in batches by a pool task
+
+#define TOKEN_EMPTY   0
+#define TOKEN_CLEAN   1
+#define TOKEN_CHANGED 2
+#define TOKEN_NEW     3
+
+struct BayesToken
+{
+	uint8_t digest[16];
+	int num;
+	int state;
+};
+
+struct BayesTable
+{
+	BayesToken *pData = nullptr;
+	uint32_t nSize = 0, nCount = 0;
+	int nRows = 0, nMsgs = 0;
+	bool bMsgsChanged = false;
+
+	~BayesTable()
+	{
+		mir_free(pData);
+	}
+
+	// md5 digests are uniformly distributed, so any part of them is a good hash
+	__forceinline uint32_t slot(const uint8_t *digest) const
+	{
+		uint32_t h;
+		memcpy(&h, digest, sizeof(h));
+		return h & (nSize - 1);
+	}
+
+	BayesToken* find(const uint8_t *digest) const
+	{
+		if (nSize == 0)
+			return nullptr;
+
+		for (uint32_t i = slot(digest);; i = (i + 1) & (nSize - 1)) {
+			BayesToken &p = pData[i];
+			if (p.state == TOKEN_EMPTY)
+				return nullptr;
+			if (!memcmp(p.digest, digest, 16))
+				return &p;
+		}
+	}
+
+	BayesToken* insert(const uint8_t *digest)
+	{
+		if ((nCount + 1) * 4 > nSize * 3)
+			grow();
+
+		uint32_t i = slot(digest);
+		while (pData[i].state != TOKEN_EMPTY) {
+			if (!memcmp(pData[i].digest, digest, 16))
+				return &pData[i];
+			i = (i + 1) & (nSize - 1);
+		}
+
+		BayesToken &p = pData[i];
+		memcpy(p.digest, digest, 16);
+		p.num = 0;
+		p.state = TOKEN_NEW;
+		nCount++;
+		nRows++;
+		return &p;
+	}
+
+	void grow()
+	{
+		BayesToken *pOld = pData;
+		uint32_t nOldSize = nSize;
+
+		nSize = (nSize == 0) ? 1024 : nSize * 2;
+		pData = (BayesToken*)mir_calloc(nSize * sizeof(BayesToken));
+		for (uint32_t i = 0; i < nOldSize; i++) {
+			if (pOld[i].state == TOKEN_EMPTY)
+				continue;
+
+			uint32_t j = slot(pOld[i].digest);
+			while (pData[j].state != TOKEN_EMPTY)
+				j = (j + 1) & (nSize - 1);
+			pData[j] = pOld[i];
+		}
+		mir_free(pOld);
+	}
+
+	void clear()
+	{
+		mir_free(pData);
+		pData = nullptr;
+		nSize = nCount = 0;
+		nRows = nMsgs = 0;
+		bMsgsChanged = false;
+	}
+};
+
+static BayesTable g_tables[2]; // HAM & SPAM
+static mir_cs csTables;        // protects g_tables
+static mir_cs csBayesDb;       // serializes access to bayesdb, taken before csTables
+static bool bFlushQueued;
+
 int CheckBayes()
 {
 	char bayesdb_fullpath[MAX_PATH];
@@ -36,8 +141,40 @@ int CheckBayes()
 	return 0;
 }
 
+static void LoadBayesTable(int type)
+{
+	BayesTable &T = g_tables[type];
+	T.clear();
+
+	sqlite3_stmt *stmt;
+	sqlite3_prepare_v2(bayesdb, type == SPAM ? "SELECT token, num FROM spam" : "SELECT token, num FROM ham", -1, &stmt, nullptr);
+	while (sqlite3_step(stmt) == SQLITE_ROW) {
+		if (sqlite3_column_bytes(stmt, 0) != 16)
+			continue;
+
+		// the first row of a token wins, like it used to be in SELECT num ... WHERE token=?
+		BayesToken *p = T.insert((const uint8_t*)sqlite3_column_blob(stmt, 0));
+		if (p->state == TOKEN_NEW) {
+			p->num = sqlite3_column_int(stmt, 1);
+			p->state = TOKEN_CLEAN;
+		}
+		else T.nRows++;
+	}
+	sqlite3_finalize(stmt);
+
+	sqlite3_prepare_v2(bayesdb, "SELECT value FROM stats WHERE key=?", -1, &stmt, nullptr);
+	sqlite3_bind_text(stmt, 1, type == SPAM ? "spam_msgcount" : "ham_msgcount", type == SPAM ? 13 : 12, nullptr);
+	if (sqlite3_step(stmt) == SQLITE_ROW)
+		T.nMsgs = sqlite3_column_int(stmt, 0);
+	sqlite3_finalize(stmt);
+}
+
 int OpenBayes()
 {
+	mir_cslock lckDb(csBayesDb);
+	if (bayesdb != nullptr)
+		return 0;
+
 	char bayesdb_fullpath[MAX_PATH];
 	char *bayesdb_fullpath_utf8;
 	char *errmsg, *tmp;
@@ -72,6 +209,11 @@ int OpenBayes()
 				sqlite3_exec(bayesdb, "INSERT INTO stats VALUES ('spam_msgcount', 0)", nullptr, nullptr, nullptr);
 				sqlite3_exec(bayesdb, "INSERT INTO stats VALUES ('ham_msgcount', 0)", nullptr, nullptr, nullptr);
 			}
+		sqlite3_finalize(stmt);
+
+		mir_cslock lck(csTables);
+		LoadBayesTable(HAM);
+		LoadBayesTable(SPAM);
 	} else {
 		MessageBoxA(nullptr, bayesdb_fullpath_utf8, "Can't open database", MB_OK);
 	}
@@ -104,35 +246,14 @@ char *tokenhash(const char *token, uint8_t *digest)
 
 int get_token_count(int type)
 {
-	char q[200];
-	int count = 0;
-	sqlite3_stmt *stmt;
-
-	if (bayesdb == nullptr)
-		return 0;
-	mir_snprintf(q, "SELECT COUNT(1) FROM %s", type == SPAM ? "spam" : "ham");
-	sqlite3_prepare_v2(bayesdb, q, -1, &stmt, nullptr);
-	if (sqlite3_step(stmt) == SQLITE_ROW) {
-		count = sqlite3_column_int(stmt, 0);
-	}
-	sqlite3_finalize(stmt);
-	return count;
+	mir_cslock lck(csTables);
+	return g_tables[type].nRows;
 }
 
 int get_msg_count(int type)
 {
-	int count = 0;
-	sqlite3_stmt *stmt;
-
-	if (bayesdb == nullptr)
-		return 0;
-	sqlite3_prepare_v2(bayesdb, "SELECT value FROM stats WHERE key=?", -1, &stmt, nullptr);
-	sqlite3_bind_text(stmt, 1, type == SPAM ? "spam_msgcount" : "ham_msgcount", type == SPAM ? 13 : 12, nullptr);
-	if (sqlite3_step(stmt) == SQLITE_ROW) {
-		count = sqlite3_column_int(stmt, 0);
-	}
-	sqlite3_finalize(stmt);
-	return count;
+	mir_cslock lck(csTables);
+	return g_tables[type].nMsgs;
 }
 
 BOOL is_token_valid(char *token)
@@ -156,25 +277,11 @@ BOOL is_token_valid(char *token)
 	return TRUE;
 }
 
-int get_token_score(int type, char *token)
+// must be called inside csTables
+static int get_token_score(int type, const uint8_t *digest)
 {
-	char sql[200];
-	int score = 0;
-	uint8_t digest[16];
-	sqlite3_stmt *stmt;
-
-	if (bayesdb == nullptr)
-		return 0;
-	mir_snprintf(sql, "SELECT num FROM %s WHERE token=?", type == SPAM ? "spam" : "ham");
-	tokenhash(token, digest);
-	sqlite3_prepare_v2(bayesdb, sql, -1, &stmt, nullptr);
-	sqlite3_bind_blob(stmt, 1, digest, 16, nullptr);
-	
-	if (sqlite3_step(stmt) == SQLITE_ROW) {
-		score = sqlite3_column_int(stmt, 0);
-	}
-	sqlite3_finalize(stmt);
-	return score;
+	BayesToken *p = g_tables[type].find(digest);
+	return (p == nullptr) ? 0 : p->num;
 }
 
 double get_msg_score(wchar_t *msg)
@@ -183,13 +290,16 @@ double get_msg_score(wchar_t *msg)
 	double spam_prob, ham_prob, tmp1 = 1, tmp2 = 1;
 	double *scores = nullptr;
 	int spam_msgcount, ham_msgcount, n = 0, i;
+	uint8_t digest[16];
 
 	if (bayesdb == nullptr)
 		return 0;
 
 	message = mir_u2a(msg);
-	spam_msgcount = get_msg_count(SPAM);
-	ham_msgcount = get_msg_count(HAM);
+
+	mir_cslock lck(csTables);
+	spam_msgcount = g_tables[SPAM].nMsgs;
+	ham_msgcount = g_tables[HAM].nMsgs;
 	token = strtok(message, DELIMS);
 	while (token)
 	{
@@ -198,8 +308,9 @@ double get_msg_score(wchar_t *msg)
 			continue;
 		}
 		scores = (double*)realloc(scores, sizeof(double)*(n + 1));
-		spam_prob = spam_msgcount == 0 ? 0 : (double)get_token_score(SPAM, token) / (double)spam_msgcount;
-		ham_prob = ham_msgcount == 0 ? 0 : (double)get_token_score(HAM, token) / (double)ham_msgcount;
+		tokenhash(token, digest);
+		spam_prob = spam_msgcount == 0 ? 0 : (double)get_token_score(SPAM, digest) / (double)spam_msgcount;
+		ham_prob = ham_msgcount == 0 ? 0 : (double)get_token_score(HAM, digest) / (double)ham_msgcount;
 		if (ham_prob == 0 && spam_prob == 0) {
 			spam_prob = 0.4; ham_prob = 0.6;
 		}
@@ -234,6 +345,7 @@ void queue_message(MCONTACT hContact, uint32_t msgtime, wchar_t *message)
 	if (bayesdb == nullptr)
 		OpenBayes();
 
+	mir_cslock lck(csBayesDb);
 	sqlite3_prepare_v2(bayesdb, "INSERT INTO queue VALUES(?,?,?)", -1, &stmt, nullptr);
 	sqlite3_bind_int(stmt, 1, (uint32_t)hContact);
 	sqlite3_bind_int(stmt, 2, msgtime);
@@ -244,113 +356,199 @@ void queue_message(MCONTACT hContact, uint32_t msgtime, wchar_t *message)
 	sqlite3_finalize(stmt);
 }
 
-void bayes_approve_contact(MCONTACT hContact)
+// reads the queued messages matching a query and removes them from the queue
+static void fetch_queue(const char *szSelect, const char *szDelete, int arg1, int arg2, LIST<char> &arMessages)
 {
-	const char *message;
-	wchar_t *messageW;
-	int d = 0;
 	sqlite3_stmt *stmt;
 
-	if (bayesdb == nullptr)
-		return;
-
-	sqlite3_prepare_v2(bayesdb, "SELECT message FROM queue WHERE contact=?", -1, &stmt, nullptr);
-	sqlite3_bind_int(stmt, 1, (uint32_t)hContact);
+	mir_cslock lck(csBayesDb);
+	sqlite3_prepare_v2(bayesdb, szSelect, -1, &stmt, nullptr);
+	sqlite3_bind_int(stmt, 1, arg1);
+	if (arg2 != -1)
+		sqlite3_bind_int(stmt, 2, arg2);
 	while (sqlite3_step(stmt) == SQLITE_ROW)
-	{
-		d = 1;
-		message = (char*)sqlite3_column_text(stmt, 0);
-		messageW = mir_a2u(message);
-		learn_ham(messageW);
-		mir_free(messageW);
-	}
+		arMessages.insert(mir_strdup((char*)sqlite3_column_text(stmt, 0)));
 	sqlite3_finalize(stmt);
-	if (d) {
-		sqlite3_prepare_v2(bayesdb, "DELETE FROM queue WHERE contact=?", -1, &stmt, nullptr);
-		sqlite3_bind_int(stmt, 1, (uint32_t)hContact);
+
+	if (arMessages.getCount()) {
+		sqlite3_prepare_v2(bayesdb, szDelete, -1, &stmt, nullptr);
+		sqlite3_bind_int(stmt, 1, arg1);
+		if (arg2 != -1)
+			sqlite3_bind_int(stmt, 2, arg2);
 		sqlite3_step(stmt);
 		sqlite3_finalize(stmt);
 	}
-	
+}
+
+void bayes_approve_contact(MCONTACT hContact)
+{
+	if (bayesdb == nullptr)
+		return;
+
+	LIST<char> arMessages(10);
+	fetch_queue("SELECT message FROM queue WHERE contact=?", "DELETE FROM queue WHERE contact=?", (uint32_t)hContact, -1, arMessages);
+	learn_batch(HAM, arMessages);
+
+	for (auto &it : arMessages)
+		mir_free(it);
 }
 
 void dequeue_messages()
 {
-	time_t t = time(0);
-	sqlite3_stmt *stmt;
-	const char *message;
-	wchar_t *messageW;
-	int d = 0;
+	if (bayesdb == nullptr)
+		return;
+
+	int iWait = g_plugin.getDword("BayesWaitApprove", defaultBayesWaitApprove) * 86400;
+	LIST<char> arMessages(10);
+	fetch_queue("SELECT message FROM queue WHERE msgtime + ? < ?", "DELETE FROM queue WHERE msgtime + ? < ?", iWait, (uint32_t)time(0), arMessages);
+	learn_batch(SPAM, arMessages);
+
+	for (auto &it : arMessages)
+		mir_free(it);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////
+// writes changed token counts to sqlite in one transaction
 
+void bayes_flush()
+{
+	mir_cslock lckDb(csBayesDb);
 	if (bayesdb == nullptr)
 		return;
 
-	sqlite3_prepare_v2(bayesdb, "SELECT message FROM queue WHERE msgtime + ? < ?", -1, &stmt, nullptr);
-	sqlite3_bind_int(stmt, 1, g_plugin.getDword("BayesWaitApprove", defaultBayesWaitApprove)*86400);
-	sqlite3_bind_int(stmt, 2, (uint32_t)t);
-	while (sqlite3_step(stmt) == SQLITE_ROW) {
-		d = 1;
-		message = (char*)sqlite3_column_text(stmt, 0);
-		messageW = mir_a2u(message);
-		learn_spam(messageW);
-		mir_free(messageW);
+	struct Change { uint8_t digest[16]; int num; bool bNew; };
+
+	for (int type = HAM; type <= SPAM; type++) {
+		Change *pChanges = nullptr;
+		int nChanges = 0, nMsgs = -1;
+		{
+			mir_cslock lck(csTables);
+			bFlushQueued = false;
+
+			BayesTable &T = g_tables[type];
+			for (uint32_t i = 0; i < T.nSize; i++) {
+				BayesToken &p = T.pData[i];
+				if (p.state != TOKEN_CHANGED && p.state != TOKEN_NEW)
+					continue;
+
+				if (pChanges == nullptr)
+					pChanges = (Change*)mir_alloc(sizeof(Change) * T.nCount);
+
+				Change &c = pChanges[nChanges++];
+				memcpy(c.digest, p.digest, 16);
+				c.num = p.num;
+				c.bNew = p.state == TOKEN_NEW;
+				p.state = TOKEN_CLEAN;
+			}
+
+			if (T.bMsgsChanged) {
+				nMsgs = T.nMsgs;
+				T.bMsgsChanged = false;
+			}
+		}
+
+		if (nChanges == 0 && nMsgs == -1)
+			continue;
+
+		sqlite3_stmt *stmtUpdate, *stmtInsert;
+		sqlite3_exec(bayesdb, "BEGIN", nullptr, nullptr, nullptr);
+		sqlite3_prepare_v2(bayesdb, type == SPAM ? "UPDATE spam SET num=? WHERE token=?" : "UPDATE ham SET num=? WHERE token=?", -1, &stmtUpdate, nullptr);
+		sqlite3_prepare_v2(bayesdb, type == SPAM ? "INSERT INTO spam VALUES(?, ?)" : "INSERT INTO ham VALUES(?, ?)", -1, &stmtInsert, nullptr);
+		for (int i = 0; i < nChanges; i++) {
+			Change &c = pChanges[i];
+			if (c.bNew) {
+				sqlite3_bind_blob(stmtInsert, 1, c.digest, 16, SQLITE_STATIC);
+				sqlite3_bind_int(stmtInsert, 2, c.num);
+				sqlite3_step(stmtInsert);
+				sqlite3_reset(stmtInsert);
+			}
+			else {
+				sqlite3_bind_int(stmtUpdate, 1, c.num);
+				sqlite3_bind_blob(stmtUpdate, 2, c.digest, 16, SQLITE_STATIC);
+				sqlite3_step(stmtUpdate);
+				sqlite3_reset(stmtUpdate);
+			}
+		}
+		sqlite3_finalize(stmtUpdate);
+		sqlite3_finalize(stmtInsert);
+
+		if (nMsgs != -1) {
+			sqlite3_stmt *stmt;
+			sqlite3_prepare_v2(bayesdb, "UPDATE stats SET value=? WHERE key=?", -1, &stmt, nullptr);
+			sqlite3_bind_int(stmt, 1, nMsgs);
+			sqlite3_bind_text(stmt, 2, type == SPAM ? "spam_msgcount" : "ham_msgcount", type == SPAM ? 13 : 12, nullptr);
+			sqlite3_step(stmt);
+			sqlite3_finalize(stmt);
+		}
+		sqlite3_exec(bayesdb, "COMMIT", nullptr, nullptr, nullptr);
+		mir_free(pChanges);
 	}
-	sqlite3_finalize(stmt);
-	if (d) {
-		sqlite3_prepare_v2(bayesdb, "DELETE FROM queue WHERE msgtime + ? < ?", -1, &stmt, nullptr);
-		sqlite3_bind_int(stmt, 1, g_plugin.getDword("BayesWaitApprove", defaultBayesWaitApprove)*86400);
-		sqlite3_bind_int(stmt, 2, (uint32_t)t);
-		sqlite3_step(stmt);
-		sqlite3_finalize(stmt);
+}
+
+static void __cdecl FlushTask(void *)
+{
+	bayes_flush();
+}
+
+void CloseBayes()
+{
+	Task_CancelOwner(&g_plugin, INFINITE);
+	bayes_flush();
+
+	mir_cslock lckDb(csBayesDb);
+	if (bayesdb) {
+		sqlite3_close(bayesdb);
+		bayesdb = nullptr;
+	}
+#ifdef _DEBUG
+	if (bayesdbg) {
+		sqlite3_close(bayesdbg);
+		bayesdbg = nullptr;
 	}
+#endif
+
+	mir_cslock lck(csTables);
+	g_tables[HAM].clear();
+	g_tables[SPAM].clear();
 }
 
 /* Learn one message as either SPAM or HAM as specified in type parameter */
-void learn(int type, wchar_t *msg)
+static void learn_tokens(int type, char *message)
 {
-	char *tok, *message;
 	uint8_t digest[16];
-	char sql_select[200], sql_update[200], sql_insert[200], sql_counter[200];
-	sqlite3_stmt *stmt;
+	BayesTable &T = g_tables[type];
+
+	for (char *tok = strtok(message, DELIMS); tok; tok = strtok(nullptr, DELIMS)) {
+		if (!is_token_valid(tok))
+			continue;
+
+		tokenhash(tok, digest);
+		BayesToken *p = T.insert(digest);
+		p->num++;
+		if (p->state == TOKEN_CLEAN)
+			p->state = TOKEN_CHANGED;
+	}
+
+	T.nMsgs++;
+	T.bMsgsChanged = true;
+}
+
 #ifdef _DEBUG
+static void learn_debug(int type, char *message)
+{
+	char sql_select[200], sql_update[200], sql_insert[200];
 	sqlite3_stmt *stmtdbg;
-#endif
 
-	if (g_plugin.getByte("BayesEnabled", defaultBayesEnabled) == 0) 
-		return;
-	if (bayesdb == nullptr)
-		OpenBayes();
-
-	message = mir_u2a(msg);
-	tok = strtok(message, DELIMS);
-	mir_snprintf(sql_counter, "UPDATE stats SET value=value+1 WHERE key='%s'", type == SPAM ? "spam_msgcount" : "ham_msgcount");
 	mir_snprintf(sql_select, "SELECT 1 FROM %s WHERE token=?", type == SPAM ? "spam" : "ham");
 	mir_snprintf(sql_update, "UPDATE %s SET num=num+1 WHERE token=?", type ? "spam" : "ham");
 	mir_snprintf(sql_insert, "INSERT INTO %s VALUES(?, 1)", type ? "spam" : "ham");
-#ifdef _DEBUG
+
+	mir_cslock lck(csBayesDb);
 	sqlite3_exec(bayesdbg, "BEGIN", nullptr, nullptr, nullptr);
-#endif
-	sqlite3_exec(bayesdb, "BEGIN", nullptr, nullptr, nullptr);
-	while (tok) {
-		if (!is_token_valid(tok)) {
-			tok = strtok(nullptr, DELIMS);
+	for (char *tok = strtok(message, DELIMS); tok; tok = strtok(nullptr, DELIMS)) {
+		if (!is_token_valid(tok))
 			continue;
-		}
-		tokenhash(tok, digest);
-		sqlite3_prepare_v2(bayesdb, sql_select, -1, &stmt, nullptr);
-		sqlite3_bind_blob(stmt, 1, digest, 16, SQLITE_STATIC);
-		if (SQLITE_ROW == sqlite3_step(stmt)) {
-			sqlite3_finalize(stmt);
-			sqlite3_prepare_v2(bayesdb, sql_update, -1, &stmt, nullptr);
-		} else {
-			sqlite3_finalize(stmt);
-			sqlite3_prepare_v2(bayesdb, sql_insert, -1, &stmt, nullptr);
-		}
-		sqlite3_bind_blob(stmt, 1, digest, 16, SQLITE_STATIC);
-		sqlite3_step(stmt);
-		sqlite3_finalize(stmt);
 
-#ifdef _DEBUG
 		sqlite3_prepare_v2(bayesdbg, sql_select, -1, &stmtdbg, nullptr);
 		sqlite3_bind_text(stmtdbg, 1, tok, (int)mir_strlen(tok), nullptr);
 		if (SQLITE_ROW == sqlite3_step(stmtdbg)) {
@@ -363,16 +561,57 @@ void learn(int type, wchar_t *msg)
 		sqlite3_bind_text(stmtdbg, 1, tok, (int)mir_strlen(tok), SQLITE_STATIC);
 		sqlite3_step(stmtdbg);
 		sqlite3_finalize(stmtdbg);
+	}
+	sqlite3_exec(bayesdbg, "COMMIT", nullptr, nullptr, nullptr);
+}
 #endif
 
-		tok = strtok(nullptr, DELIMS);
+static void schedule_flush()
+{
+	{
+		mir_cslock lck(csTables);
+		if (bFlushQueued)
+			return;
+		bFlushQueued = true;
 	}
-	sqlite3_exec(bayesdb, sql_counter, nullptr, nullptr, nullptr);
-	sqlite3_exec(bayesdb, "COMMIT", nullptr, nullptr, nullptr);
+
+	if (!mir_forktask(FlushTask, nullptr, &g_plugin, TASK_PRIORITY_LOW))
+		bayes_flush();
+}
+
+/* Learn several ANSI messages at once, the changes are written to sqlite later */
+void learn_batch(int type, const LIST<char> &arMessages)
+{
+	if (g_plugin.getByte("BayesEnabled", defaultBayesEnabled) == 0)
+		return;
+	if (bayesdb == nullptr)
+		OpenBayes();
+	if (arMessages.getCount() == 0)
+		return;
+
+	for (auto &it : arMessages) {
+		char *message = mir_strdup(it);
 #ifdef _DEBUG
-	sqlite3_exec(bayesdbg, "COMMIT", nullptr, nullptr, nullptr);
+		char *messagedbg = mir_strdup(it);
+		learn_debug(type, messagedbg);
+		mir_free(messagedbg);
 #endif
-	mir_free(message);
+		{
+			mir_cslock lck(csTables);
+			learn_tokens(type, message);
+		}
+		mir_free(message);
+	}
+
+	schedule_flush();
+}
+
+void learn(int type, wchar_t *msg)
+{
+	LIST<char> arMessages(1);
+	arMessages.insert(mir_u2a(msg));
+	learn_batch(type, arMessages);
+	mir_free(arMessages[0]);
 }
 
 void learn_ham(wchar_t *msg)
@@ -515,6 +515,7 @@ int CMPlugin::Load()
 
 int CMPlugin::Unload()
 {
+	CloseBayes();
 	RemoveNotOnListSettings();
 	return 0;
 }
@@ -126,7 +126,10 @@ extern sqlite3 *bayesdb;
 
 int OpenBayes();
 int CheckBayes();
+void CloseBayes();
+void bayes_flush();
 void learn(int type, wchar_t *msg);
+void learn_batch(int type, const LIST<char> &arMessages);
 void learn_ham(wchar_t *msg);
 void learn_spam(wchar_t *msg);
 int get_token_count(int type);
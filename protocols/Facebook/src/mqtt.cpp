@@ -157,33 +157,28 @@ bool FacebookProto::MqttParse(const MqttMessage &payload)
 bool FacebookProto::MqttRead(MqttMessage &payload)
 {
 	uint8_t b;
-	int res = Netlib_Recv(m_mqttConn, (char *)&b, sizeof(b), MSG_NODUMP);
-	if (res != 1)
+	if (Netlib_StreamRead(m_mqttReader, &b, sizeof(b)) != 1)
 		return false;
 
 	payload.m_leadingByte = b;
 
-	uint32_t m = 1, remainingBytes = 0;
-	do {
-		if ((res = Netlib_Recv(m_mqttConn, (char *)&b, sizeof(b), MSG_NODUMP)) != 1)
-			return false;
+	// MQTT allows four bytes of length at most
+	uint32_t remainingBytes;
+	int cbLength = Netlib_StreamReadVarInt(m_mqttReader, &remainingBytes);
+	if (cbLength <= 0)
+		return false;
 
-		remainingBytes += (b & 0x7F) * m;
-		m *= 128;
-	} while ((b & 0x80) != 0);
+	if (cbLength > 4 || remainingBytes > FB_MQTT_MAX_LENGTH) {
+		debugLogA("Invalid message length, dropping connection");
+		return false;
+	}
 
 	debugLogA("Received message of type=%d, flags=%x, body length=%d", payload.getType(), payload.getFlags(), remainingBytes);
 
 	if (remainingBytes != 0) {
-		while (remainingBytes > 0) {
-			uint8_t buf[1024];
-			int size = min(remainingBytes, sizeof(buf));
-			if ((res = Netlib_Recv(m_mqttConn, (char *)buf, size)) <= 0)
-				return false;
-
-			payload.writeBuf(buf, res);
-			remainingBytes -= res;
-		}
+		void *pBody = payload.writeSpace(remainingBytes);
+		if (pBody == nullptr || Netlib_StreamRead(m_mqttReader, pBody, remainingBytes) <= 0)
+			return false;
 	}
 
 	return true;
@@ -22,6 +22,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #define FACEBOOK_ORCA_AGENT FB_API_MQTT_AGENT
 
+#define FB_MQTT_MAX_LENGTH (16 * 1024 * 1024) // sane limit of a message body, MQTT itself allows 256M
+
 #define FB_THRIFT_TYPE_STOP   0
 #define FB_THRIFT_TYPE_VOID   1
 #define FB_THRIFT_TYPE_BOOL   2
@@ -71,6 +73,7 @@ public:
 
 	void writeBool(bool value);
 	void writeBuf(const void *pData, size_t cbLen);
+	void* writeSpace(size_t cbLen); // returns cbLen bytes added to the end, to be filled
 	void writeInt16(uint16_t value);
 	void writeInt32(int32_t value);
 	void writeInt64(int64_t value);
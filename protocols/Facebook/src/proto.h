@@ -445,6 +445,7 @@ class FacebookProto : public PROTO<FacebookProto>
 	void OnPublishUtn(FbThriftReader &rdr);
 
 	HNETLIBCONN m_mqttConn;
+	HANDLE      m_mqttReader; // buffered reader over m_mqttConn
 	__int64     m_iMqttId;
 	int16_t     m_mid;        // MQTT message id
 
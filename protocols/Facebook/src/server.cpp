@@ -409,22 +409,27 @@ LBL_Begin:
 		return;
 	}
 
+	m_mqttReader = Netlib_CreateStreamReader(m_mqttConn);
+
 	// send initial packet
 	MqttLogin();
 
 	while (!Miranda_IsTerminated()) {
-		NETLIBSELECT nls = {};
-		nls.hReadConns[0] = m_mqttConn;
-		nls.dwTimeout = 1000;
-		int ret = Netlib_Select(&nls);
-		if (ret == SOCKET_ERROR) {
-			debugLogA("Netlib_Recv() failed, error=%d", WSAGetLastError());
-			break;
-		}
+		// buffered data isn't visible to select, process it first
+		if (Netlib_StreamPending(m_mqttReader) <= 0) {
+			NETLIBSELECT nls = {};
+			nls.hReadConns[0] = m_mqttConn;
+			nls.dwTimeout = 1000;
+			int ret = Netlib_Select(&nls);
+			if (ret == SOCKET_ERROR) {
+				debugLogA("Netlib_Recv() failed, error=%d", WSAGetLastError());
+				break;
+			}
 
-		// no data, continue waiting
-		if (ret == 0)
-			continue;
+			// no data, continue waiting
+			if (ret == 0)
+				continue;
+		}
 
 		MqttMessage msg;
 		if (!MqttRead(msg)) {
@@ -440,6 +445,9 @@ LBL_Begin:
 
 	debugLogA("exiting ServerThread");
 
+	Netlib_CloseHandle(m_mqttReader);
+	m_mqttReader = nullptr;
+
 	Netlib_CloseHandle(m_mqttConn);
 	m_mqttConn = nullptr;
 
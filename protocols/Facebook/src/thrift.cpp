@@ -78,6 +78,11 @@ void FbThrift::writeBuf(const void *pData, size_t cbLen)
 	m_buf.append(pData, cbLen);
 }
 
+void* FbThrift::writeSpace(size_t cbLen)
+{
+	return m_buf.appendSpace(cbLen);
+}
+
 void FbThrift::writeField(int iType)
 {
 	uint8_t type = encodeType(iType) + 0x10;
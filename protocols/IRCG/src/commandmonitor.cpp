@@ -276,17 +276,15 @@ bool CIrcProto::OnIrc_WELCOME(const CIrcMessage *pmsg)
 
 	if (pmsg->m_bIncoming && pmsg->parameters.getCount() > 1) {
 		static wchar_t host[1024];
-		int i = 0;
-		CMStringW word = GetWord(pmsg->parameters[1], i);
-		while (!word.IsEmpty()) {
+		CIrcWords words(pmsg->parameters[1]);
+		for (int i = 0; i < words.getCount(); i++) {
+			CMStringW word = words[i];
 			if (wcschr(word, '!') && wcschr(word, '@')) {
 				mir_wstrncpy(host, word, _countof(host));
 				wchar_t* p1 = wcschr(host, '@');
 				if (p1)
 					ForkThread(&CIrcProto::ResolveIPThread, new IPRESOLVE(_T2A(p1 + 1), IP_AUTO));
 			}
-
-			word = GetWord(pmsg->parameters[1], ++i);
 		}
 	}
 
@@ -1219,26 +1217,30 @@ bool CIrcProto::OnIrc_NAMES(const CIrcMessage *pmsg)
 	return true;
 }
 
+// maps a nick prefix to its status text, cached for all prefixes in advance
+
+static const wchar_t* sttPrefixStatus(const CMStringW &wszPrefixes, const OBJLIST<CMStringW> &arStatuses, wchar_t cPrefix, const wchar_t *pwszNormal)
+{
+	const wchar_t *p = (cPrefix) ? wcschr(wszPrefixes, cPrefix) : nullptr;
+	return (p) ? arStatuses[int(p - wszPrefixes.c_str())].c_str() : pwszNormal;
+}
+
 bool CIrcProto::OnIrc_ENDNAMES(const CIrcMessage *pmsg)
 {
 	if (pmsg->m_bIncoming && pmsg->parameters.getCount() > 1) {
-		CMStringW name = L"a";
-		int i = 0;
+		// the list is split in place, it's cleared below anyway
+		CIrcWords names(sNamesList.GetBuffer(), true);
 		BOOL bFlag = false;
 
 		// Is the user on the names list?
-		while (!name.IsEmpty()) {
-			name = GetWord(sNamesList, i);
-			i++;
-			if (!name.IsEmpty()) {
-				int index = 0;
-				while (wcschr(sUserModePrefixes, name[index]))
-					index++;
-
-				if (!mir_wstrcmpi(name.Mid(index), m_info.sNick)) {
-					bFlag = true;
-					break;
-				}
+		for (int i = 0; i < names.getCount(); i++) {
+			const wchar_t *name = names.ptr(i);
+			while (*name && wcschr(sUserModePrefixes, *name))
+				name++;
+
+			if (!mir_wstrcmpi(name, m_info.sNick)) {
+				bFlag = true;
+				break;
 			}
 		}
 
@@ -1262,29 +1264,27 @@ bool CIrcProto::OnIrc_ENDNAMES(const CIrcMessage *pmsg)
 				Chat_AddGroup(si, TranslateT("Voice"));
 				Chat_AddGroup(si, TranslateT("Normal"));
 				{
-					int k = 0;
-					CMStringW sTemp = GetWord(sNamesList, k);
 					const wchar_t *pwszNormal = TranslateT("Normal");
 
-					// Fill the nicklist
-					while (!sTemp.IsEmpty()) {
-						CMStringW sStat;
-						CMStringW sTemp2 = sTemp;
-						sStat = PrefixToStatus(sTemp[0]);
+					OBJLIST<CMStringW> arStatuses(5);
+					for (int i = 0; i < sUserModePrefixes.GetLength(); i++)
+						arStatuses.insert(new CMStringW(PrefixToStatus(sUserModePrefixes[i])));
+
+					// Fill the nicklist: all users but us are added at once
+					int nUsers = 0;
+					GCEVENT *pUsers = (GCEVENT*)mir_calloc(sizeof(GCEVENT) * names.getCount());
+
+					for (int k = 0; k < names.getCount(); k++) {
+						const wchar_t *pwszPrefixes = names.ptr(k), *pwszNick = pwszPrefixes;
+						const wchar_t *pwszStatus = sttPrefixStatus(sUserModePrefixes, arStatuses, *pwszNick, pwszNormal);
 
 						// fix for networks like freshirc where they allow more than one prefix
-						while (PrefixToStatus(sTemp[0]) != pwszNormal)
-							sTemp.Delete(0, 1);
-
-						GCEVENT gce = { m_szModuleName, 0, GC_EVENT_JOIN };
-						gce.pszID.w = sChanName;
-						gce.pszUID.w = sTemp;
-						gce.pszNick.w = sTemp;
-						gce.pszStatus.w = sStat;
-						gce.bIsMe = (!mir_wstrcmpi(gce.pszNick.w, m_info.sNick)) ? TRUE : FALSE;
-						if (gce.bIsMe) {
+						while (mir_wstrcmp(sttPrefixStatus(sUserModePrefixes, arStatuses, *pwszNick, pwszNormal), pwszNormal))
+							pwszNick++;
+
+						if (!mir_wstrcmpi(pwszNick, m_info.sNick)) {
 							char BitNr = -1;
-							switch (sTemp2[0]) {
+							switch (pwszPrefixes[0]) {
 							case '+':   BitNr = 0;   break;
 							case '%':   BitNr = 1;   break;
 							case '@':   BitNr = 2;   break;
@@ -1295,25 +1295,44 @@ bool CIrcProto::OnIrc_ENDNAMES(const CIrcMessage *pmsg)
 								btOwnMode = (1 << BitNr);
 							else
 								btOwnMode = 0;
-						}
-						gce.time = gce.bIsMe ? time(0) : 0;
-						Chat_Event(&gce);
-						
-						DoEvent(GC_EVENT_SETCONTACTSTATUS, sChanName, sTemp, nullptr, nullptr, nullptr, ID_STATUS_ONLINE, FALSE, FALSE);
-						
-						// fix for networks like freshirc where they allow more than one prefix
-						if (PrefixToStatus(sTemp2[0]) != pwszNormal) {
-							sTemp2.Delete(0, 1);
-							sStat = PrefixToStatus(sTemp2[0]);
-							while (sStat != pwszNormal) {
-								DoEvent(GC_EVENT_ADDSTATUS, sChanName, sTemp, L"system", sStat, nullptr, NULL, false, false, 0);
-								sTemp2.Delete(0, 1);
-								sStat = PrefixToStatus(sTemp2[0]);
-							}
+
+							// our own join is written to the log, so it goes separately
+							GCEVENT gce = { m_szModuleName, 0, GC_EVENT_JOIN };
+							gce.pszID.w = sChanName;
+							gce.pszUID.w = pwszNick;
+							gce.pszNick.w = pwszNick;
+							gce.pszStatus.w = pwszStatus;
+							gce.bIsMe = TRUE;
+							gce.time = time(0);
+							Chat_Event(&gce);
+
+							DoEvent(GC_EVENT_SETCONTACTSTATUS, sChanName, pwszNick, nullptr, nullptr, nullptr, ID_STATUS_ONLINE, FALSE, FALSE);
+							continue;
 						}
 
-						k++;
-						sTemp = GetWord(sNamesList, k);
+						GCEVENT &gce = pUsers[nUsers++];
+						gce.pszUID.w = pwszNick;
+						gce.pszNick.w = pwszNick;
+						gce.pszStatus.w = pwszStatus;
+						gce.dwItemData = ID_STATUS_ONLINE;
+					}
+
+					if (nUsers)
+						Chat_AddUsers(m_szModuleName, sChanName, pUsers, nUsers);
+					mir_free(pUsers);
+
+					// fix for networks like freshirc where they allow more than one prefix
+					for (int k = 0; k < names.getCount(); k++) {
+						const wchar_t *pwszPrefixes = names.ptr(k);
+						if (!mir_wstrcmp(sttPrefixStatus(sUserModePrefixes, arStatuses, *pwszPrefixes, pwszNormal), pwszNormal))
+							continue;
+
+						const wchar_t *pwszNick = pwszPrefixes;
+						while (mir_wstrcmp(sttPrefixStatus(sUserModePrefixes, arStatuses, *pwszNick, pwszNormal), pwszNormal))
+							pwszNick++;
+
+						for (const wchar_t *p = pwszPrefixes + 1; p < pwszNick; p++)
+							DoEvent(GC_EVENT_ADDSTATUS, sChanName, pwszNick, L"system", sttPrefixStatus(sUserModePrefixes, arStatuses, *p, pwszNormal), nullptr, NULL, false, false, 0);
 					}
 				}
 
@@ -357,6 +357,9 @@ void CIrcProto::DoReceive()
 		}
 	}
 
+	// every line is converted into the same buffer, to avoid an allocation per line
+	CMStringW wszLine;
+
 	while (con) {
 		int nLinesProcessed = 0;
 
@@ -378,6 +381,7 @@ void CIrcProto::DoReceive()
 				break; // uncomplete message. stop parsing.
 
 			++nLinesProcessed;
+			int cbLine = int(pEnd - pStart);
 
 			// replace end-of-line with NULLs and skip
 			while (*pEnd == '\r' || *pEnd == '\n')
@@ -385,13 +389,15 @@ void CIrcProto::DoReceive()
 
 			// process single message by monitor objects
 			if (*pStart) {
-				ptrW ptszMsg;
+				int iCodepage = codepage;
 				if (codepage != CP_UTF8 && m_utfAutodetect && Utf8CheckString(pStart))
-					ptszMsg = mir_utf8decodeW(pStart);
-				else
-					ptszMsg = mir_a2u_cp(pStart, codepage);
+					iCodepage = CP_UTF8;
+
+				wchar_t *pwszLine = wszLine.GetBuffer(cbLine + 1);
+				int cchLine = MultiByteToWideChar(iCodepage, 0, pStart, cbLine, pwszLine, cbLine + 1);
+				wszLine.ReleaseBuffer(cchLine);
 
-				CIrcMessage msg(this, ptszMsg, codepage, true);
+				CIrcMessage msg(this, wszLine, codepage, true);
 				Notify(&msg);
 			}
 
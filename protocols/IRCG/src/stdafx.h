@@ -216,6 +216,31 @@ wchar_t*       __stdcall DoColorCodes(const wchar_t* text, bool bStrip, bool bRe
 
 CMStringA      __stdcall GetWord(const char* text, int index);
 
+// splits a text into words in one pass, the words point into the original text
+class CIrcWords : public MNonCopyable
+{
+	struct Span
+	{
+		const wchar_t *p;
+		int len;
+	};
+
+	Span *m_words = nullptr;
+	const wchar_t *m_pEnd = nullptr;
+	int m_count = 0, m_limit = 0;
+
+public:
+	CIrcWords(const wchar_t *text, bool bTerminate = false);
+	~CIrcWords();
+
+	__forceinline int getCount() const { return m_count; }
+	__forceinline const wchar_t* ptr(int i) const { return m_words[i].p; }
+	__forceinline int length(int i) const { return m_words[i].len; }
+
+	CMStringW operator[](int i) const;
+	const wchar_t* address(int i) const;
+};
+
 #pragma comment(lib,"comctl32.lib")
 
 #endif
@@ -108,6 +108,60 @@ const wchar_t* __stdcall GetWordAddress(const wchar_t* text, int index)
 	return temp;
 }
 
+/////////////////////////////////////////////////////////////////////////////////////////
+// unlike GetWord() the text is scanned only once. if bTerminate is set, the text must be
+// writable: it's cut after each word, so that every word becomes a C string, and address()
+// cannot be used anymore
+
+CIrcWords::CIrcWords(const wchar_t *text, bool bTerminate)
+{
+	if (text == nullptr)
+		return;
+
+	wchar_t *p = (wchar_t*)text;
+	while (true) {
+		while (*p == ' ')
+			p++;
+		if (*p == 0)
+			break;
+
+		wchar_t *pStart = p;
+		while (*p && *p != ' ')
+			p++;
+
+		if (m_count == m_limit) {
+			m_limit = (m_limit == 0) ? 16 : m_limit * 2;
+			m_words = (Span*)mir_realloc(m_words, sizeof(Span) * m_limit);
+		}
+		m_words[m_count].p = pStart;
+		m_words[m_count].len = int(p - pStart);
+		m_count++;
+
+		if (bTerminate && *p)
+			*p++ = 0;
+	}
+	m_pEnd = p;
+}
+
+CIrcWords::~CIrcWords()
+{
+	mir_free(m_words);
+}
+
+CMStringW CIrcWords::operator[](int i) const
+{
+	if (i < 0 || i >= m_count)
+		return CMStringW();
+
+	return CMStringW(m_words[i].p, m_words[i].len);
+}
+
+// same as GetWordAddress(): the rest of the text starting from the word
+const wchar_t* CIrcWords::address(int i) const
+{
+	return (i < m_count) ? m_words[i].p : m_pEnd;
+}
+
 void __stdcall RemoveLinebreaks(CMStringW &Message)
 {
 	while (Message.Find(L"\r\n\r\n", 0) != -1)
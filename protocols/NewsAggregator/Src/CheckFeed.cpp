@@ -112,10 +112,149 @@ LPCTSTR CheckFeed(wchar_t *tszURL, CFeedEditor *pEditDlg)
 	return nullptr;
 }
 
+/////////////////////////////////////////////////////////////////////////////////////////
+// fingerprints of the messages already added to a feed's history, so that an item can be
+// checked without reading the history. they're kept in the feed's settings (a blob can't
+// exceed 64K, hence the limit) and rebuilt from the history if missing
+
+#define MAX_SEEN_ITEMS 8000
+
+class CSeenItems
+{
+	MCONTACT m_hContact;
+	bool m_bChanged = false;
+
+	uint64_t *m_pList = nullptr; // ring buffer in order of addition, m_first is the oldest one
+	int m_first = 0, m_count = 0;
+
+	uint64_t *m_pTable = nullptr; // open addressing, zero marks an empty slot
+	int m_tableSize = 0;
+
+	static uint64_t Fingerprint(const char *pszText)
+	{
+		uint8_t digest[16];
+		mir_md5_hash((const uint8_t *)pszText, mir_strlen(pszText), digest);
+
+		uint64_t res;
+		memcpy(&res, digest, sizeof(res));
+		return (res) ? res : 1;
+	}
+
+	int Lookup(uint64_t id) const
+	{
+		int i = int(id & (m_tableSize - 1));
+		while (m_pTable[i] != 0 && m_pTable[i] != id)
+			i = (i + 1) & (m_tableSize - 1);
+		return i;
+	}
+
+	bool Contains(uint64_t id) const
+	{
+		return m_pTable[Lookup(id)] == id;
+	}
+
+	// the items following the removed one in its cluster are shifted back, so that lookups
+	// don't stop at the hole
+	void Remove(uint64_t id)
+	{
+		int mask = m_tableSize - 1, i = Lookup(id);
+		if (m_pTable[i] != id)
+			return;
+
+		for (int j = (i + 1) & mask; m_pTable[j] != 0; j = (j + 1) & mask) {
+			int home = int(m_pTable[j] & mask);
+			if (((j - home) & mask) >= ((j - i) & mask)) {
+				m_pTable[i] = m_pTable[j];
+				i = j;
+			}
+		}
+		m_pTable[i] = 0;
+	}
+
+	// the oldest fingerprint leaves when the limit is reached
+	void Add(uint64_t id)
+	{
+		if (m_count == MAX_SEEN_ITEMS) {
+			Remove(m_pList[m_first]);
+			m_pList[m_first] = id;
+			m_first = (m_first + 1) % MAX_SEEN_ITEMS;
+		}
+		else m_pList[(m_first + m_count++) % MAX_SEEN_ITEMS] = id;
+
+		m_pTable[Lookup(id)] = id;
+	}
+
+public:
+	CSeenItems(MCONTACT hContact) :
+		m_hContact(hContact)
+	{
+		// the table is never more than a half full
+		for (m_tableSize = 1024; m_tableSize < MAX_SEEN_ITEMS * 2; m_tableSize *= 2);
+		m_pTable = (uint64_t *)mir_calloc(sizeof(uint64_t) * m_tableSize);
+		m_pList = (uint64_t *)mir_alloc(sizeof(uint64_t) * MAX_SEEN_ITEMS);
+
+		DBVARIANT dbv;
+		if (!db_get(hContact, MODULENAME, "SeenItems", &dbv)) {
+			if (dbv.type == DBVT_BLOB) {
+				auto *p = (const uint64_t *)dbv.pbVal;
+				for (int i = min(int(dbv.cpbVal / sizeof(uint64_t)), MAX_SEEN_ITEMS); i > 0; i--, p++)
+					if (*p && !Contains(*p))
+						Add(*p);
+			}
+			db_free(&dbv);
+			return;
+		}
+
+		// nothing stored yet, read the history once, from the newest messages till the limit
+		DB::ECPTR pCursor(DB::EventsRev(hContact));
+		while (m_count < MAX_SEEN_ITEMS) {
+			MEVENT hDbEvent = pCursor.FetchNext();
+			if (hDbEvent == 0)
+				break;
+
+			DB::EventInfo dbei;
+			dbei.cbBlob = -1;
+			if (db_event_get(hDbEvent, &dbei))
+				continue;
+
+			uint64_t id = Fingerprint((char *)dbei.pBlob);
+			if (!Contains(id))
+				Add(id);
+		}
+
+		// the list keeps the oldest fingerprint first
+		std::reverse(m_pList, m_pList + m_count);
+		m_bChanged = true;
+	}
+
+	~CSeenItems()
+	{
+		if (m_bChanged) {
+			std::rotate(m_pList, m_pList + m_first, m_pList + m_count);
+			db_set_blob(m_hContact, MODULENAME, "SeenItems", m_pList, unsigned(sizeof(uint64_t) * m_count));
+		}
+
+		mir_free(m_pList);
+		mir_free(m_pTable);
+	}
+
+	// returns true if the message was seen before, remembers it otherwise
+	bool Check(const char *pszMessage)
+	{
+		uint64_t id = Fingerprint(pszMessage);
+		if (Contains(id))
+			return true;
+
+		Add(id);
+		m_bChanged = true;
+		return false;
+	}
+};
+
 /////////////////////////////////////////////////////////////////////////////////////////
 // loads a feed completely, with messages
 
-static void XmlToMsg(MCONTACT hContact, CMStringW &title, CMStringW &link, CMStringW &descr, CMStringW &author, CMStringW &comments, CMStringW &guid, CMStringW &category, time_t stamp)
+static void XmlToMsg(MCONTACT hContact, CSeenItems &seen, CMStringW &title, CMStringW &link, CMStringW &descr, CMStringW &author, CMStringW &comments, CMStringW &guid, CMStringW &category, time_t stamp)
 {
 	CMStringW message = g_plugin.getWStringA(hContact, "MsgFormat");
 	if (!message)
@@ -156,37 +295,11 @@ static void XmlToMsg(MCONTACT hContact, CMStringW &title, CMStringW &link, CMStr
 	else
 		message.Replace(L"#<category>#", category);
 
-	DBEVENTINFO olddbei = {};
-	bool  MesExist = false;
-	T2Utf pszTemp(message);
-	uint32_t cbMemoLen = 10000, cbOrigLen = (uint32_t)mir_strlen(pszTemp);
-	uint8_t *pbBuffer = (uint8_t*)mir_alloc(cbMemoLen);
-
-	DB::ECPTR pCursor(DB::EventsRev(hContact));
-	while (MEVENT hDbEvent = pCursor.FetchNext()) {
-		olddbei.cbBlob = db_event_getBlobSize(hDbEvent);
-		if (olddbei.cbBlob > cbMemoLen)
-			pbBuffer = (uint8_t*)mir_realloc(pbBuffer, (size_t)(cbMemoLen = olddbei.cbBlob));
-		olddbei.pBlob = pbBuffer;
-		db_event_get(hDbEvent, &olddbei);
-
-		// there's no need to look for the elder events
-		if (stamp > 0 && olddbei.timestamp < (uint32_t)stamp)
-			break;
-
-		if ((uint32_t)mir_strlen((char*)olddbei.pBlob) == cbOrigLen && !mir_strcmp((char*)olddbei.pBlob, pszTemp)) {
-			MesExist = true;
-			break;
-		}
-	}
-	mir_free(pbBuffer);
-
-	if (!MesExist) {
+	T2Utf pszMessage(message);
+	if (!seen.Check(pszMessage)) {
 		if (stamp == 0)
 			stamp = time(0);
 
-		T2Utf pszMessage(message);
-
 		PROTORECVEVENT recv = { 0 };
 		recv.timestamp = (uint32_t)stamp;
 		recv.szMessage = pszMessage;
@@ -207,12 +320,34 @@ void CheckCurrentFeed(MCONTACT hContact)
 	Netlib_LogfW(hNetlibUser, L"Started checking feed %s.", szURL);
 
 	char *szData = nullptr;
-	GetNewsData(szURL, &szData, hContact, nullptr);
+	int iResult = GetNewsData(szURL, &szData, hContact, nullptr, true);
 	mir_free(szURL);
 
+	if (iResult == 304) {
+		g_plugin.setDword(hContact, "LastCheck", (uint32_t)time(0));
+		return;
+	}
+
 	if (szData == nullptr)
 		return;
 
+	// the same body as the last time: there's nothing new to parse
+	uint8_t digest[16];
+	mir_md5_hash((uint8_t *)szData, mir_strlen(szData), digest);
+
+	DBVARIANT dbv;
+	if (!db_get(hContact, MODULENAME, "BodyHash", &dbv)) {
+		bool bSame = (dbv.type == DBVT_BLOB && dbv.cpbVal == sizeof(digest) && !memcmp(dbv.pbVal, digest, sizeof(digest)));
+		db_free(&dbv);
+		if (bSame) {
+			Netlib_LogfW(hNetlibUser, L"Feed %d is not changed.", hContact);
+			mir_free(szData);
+			g_plugin.setDword(hContact, "LastCheck", (uint32_t)time(0));
+			return;
+		}
+	}
+	db_set_blob(hContact, MODULENAME, "BodyHash", digest, sizeof(digest));
+
 	TiXmlDocument doc;
 	int ret = doc.Parse(szData);
 	mir_free(szData);
@@ -222,6 +357,7 @@ void CheckCurrentFeed(MCONTACT hContact)
 	CMStringA codepage = DetectEncoding(doc);
 
 	CMStringW szValue;
+	CSeenItems seen(hContact);
 	
 	for (auto *it : TiXmlEnum(&doc)) {
 		auto *szNodeName = it->Name();
@@ -324,7 +460,7 @@ void CheckCurrentFeed(MCONTACT hContact)
 							ClearText(category, value);
 					}
 
-					XmlToMsg(hContact, title, link, descr, author, comments, guid, category, stamp);
+					XmlToMsg(hContact, seen, title, link, descr, author, comments, guid, category, stamp);
 				}
 			}
 		}
@@ -426,7 +562,7 @@ void CheckCurrentFeed(MCONTACT hContact)
 						}
 					}
 
-					XmlToMsg(hContact, title, link, descr, author, comments, guid, category, stamp);
+					XmlToMsg(hContact, seen, title, link, descr, author, comments, guid, category, stamp);
 				}
 			}
 		}
@@ -778,6 +778,11 @@ bool CFeedEditor::OnApply()
 	g_plugin.setWString(hContact, "URL", strfeedurl);
 	g_plugin.setDword(hContact, "UpdateTime", m_checktime.GetInt());
 	g_plugin.setWString(hContact, "MsgFormat", strtagedit);
+
+	// the address or the format might have changed, the feed must be loaded completely
+	g_plugin.delSetting(hContact, "ETag");
+	g_plugin.delSetting(hContact, "LastModified");
+	g_plugin.delSetting(hContact, "BodyHash");
 	g_plugin.setWord(hContact, "Status", Proto_GetStatus(MODULENAME));
 	if (m_useauth.IsChecked()) {
 		g_plugin.setByte(hContact, "UseAuth", 1);
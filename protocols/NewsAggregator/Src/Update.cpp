@@ -24,6 +24,9 @@ bool ThreadRunning;
 UPDATELIST *UpdateListHead = nullptr;
 UPDATELIST *UpdateListTail = nullptr;
 
+// contacts being queued or checked, a feed must not be checked by two workers at once
+static LIST<void> arUpdating(10, HandleKeySortT);
+
 // main auto-update timer
 void CALLBACK timerProc(HWND, UINT, UINT_PTR, DWORD)
 {
@@ -60,12 +63,18 @@ void CALLBACK timerProc2(HWND, UINT, UINT_PTR, DWORD)
 
 void UpdateListAdd(MCONTACT hContact)
 {
+	WaitForSingleObject(hUpdateMutex, INFINITE);
+
+	if (arUpdating.find((void*)hContact)) {
+		ReleaseMutex(hUpdateMutex);
+		return;
+	}
+	arUpdating.insert((void*)hContact);
+
 	UPDATELIST *newItem = (UPDATELIST*)mir_alloc(sizeof(UPDATELIST));
 	newItem->hContact = hContact;
 	newItem->next = nullptr;
 
-	WaitForSingleObject(hUpdateMutex, INFINITE);
-
 	if (UpdateListTail == nullptr)
 		UpdateListHead = newItem;
 	else UpdateListTail->next = newItem;
@@ -95,6 +104,13 @@ MCONTACT UpdateGetFirst()
 	return hContact;
 }
 
+static void UpdateListDone(MCONTACT hContact)
+{
+	WaitForSingleObject(hUpdateMutex, INFINITE);
+	arUpdating.remove((void*)hContact);
+	ReleaseMutex(hUpdateMutex);
+}
+
 void DestroyUpdateList(void)
 {
 	WaitForSingleObject(hUpdateMutex, INFINITE);
@@ -102,6 +118,7 @@ void DestroyUpdateList(void)
 	// free the list one by one
 	UPDATELIST *temp = UpdateListHead;
 	while (temp != nullptr) {
+		arUpdating.remove((void*)temp->hContact);
 		UpdateListHead = temp->next;
 		mir_free(temp);
 		temp = UpdateListHead;
@@ -112,6 +129,31 @@ void DestroyUpdateList(void)
 	ReleaseMutex(hUpdateMutex);
 }
 
+// feeds are fetched by several workers at once, so that a slow server doesn't hold the rest
+#define MAX_UPDATE_WORKERS 4
+
+static unsigned __stdcall UpdateWorkerProc(void *AvatarCheck)
+{
+	CoInitializeEx(nullptr, COINIT_APARTMENTTHREADED);
+
+	// update news by getting the first station from the queue until the queue is empty
+	while (!Miranda_IsTerminated()) {
+		MCONTACT hContact = UpdateGetFirst();
+		if (hContact == 0)
+			break;
+
+		if (AvatarCheck != nullptr)
+			CheckCurrentFeedAvatar(hContact);
+		else
+			CheckCurrentFeed(hContact);
+
+		UpdateListDone(hContact);
+	}
+
+	CoUninitialize();
+	return 0;
+}
+
 void UpdateThreadProc(void *AvatarCheck)
 {
 	WaitForSingleObject(hUpdateMutex, INFINITE);
@@ -122,18 +164,19 @@ void UpdateThreadProc(void *AvatarCheck)
 	ThreadRunning = TRUE;	// prevent 2 instance of this thread running
 	ReleaseMutex(hUpdateMutex);
 
-	CoInitializeEx(nullptr, COINIT_APARTMENTTHREADED);
-
-	// update news by getting the first station from the queue until the queue is empty
-	while (UpdateListHead != nullptr && !Miranda_IsTerminated()) {
-		if (AvatarCheck != nullptr)
-			CheckCurrentFeedAvatar(UpdateGetFirst());
-		else
-			CheckCurrentFeed(UpdateGetFirst());
+	// handles of mir_forkthreadex belong to us, unlike those of mir_forkthread
+	HANDLE hWorkers[MAX_UPDATE_WORKERS];
+	int nWorkers = 0;
+	for (int i = 0; i < MAX_UPDATE_WORKERS; i++)
+		if (HANDLE hThread = mir_forkthreadex(UpdateWorkerProc, AvatarCheck))
+			hWorkers[nWorkers++] = hThread;
+
+	if (nWorkers) {
+		WaitForMultipleObjects(nWorkers, hWorkers, TRUE, INFINITE);
+		for (int i = 0; i < nWorkers; i++)
+			CloseHandle(hWorkers[i]);
 	}
 
 	// exit the update thread
 	ThreadRunning = FALSE;
-
-	CoUninitialize();
 }
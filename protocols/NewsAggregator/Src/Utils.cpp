@@ -44,7 +44,10 @@ void NetlibUnInit()
 	hNetlibUser = nullptr;
 }
 
-void GetNewsData(wchar_t *tszUrl, char **szData, MCONTACT hContact, CFeedEditor *pEditDlg)
+// returns the HTTP result code, or 0 if there was no reply. if bRevalidate is set, the feed's
+// ETag and Last-Modified values are sent back, so an unchanged feed is answered with 304
+
+int GetNewsData(wchar_t *tszUrl, char **szData, MCONTACT hContact, CFeedEditor *pEditDlg, bool bRevalidate)
 {
 	Netlib_LogfW(hNetlibUser, L"Getting feed data %s.", tszUrl);
 	NETLIBHTTPREQUEST nlhr = { 0 };
@@ -60,7 +63,7 @@ void GetNewsData(wchar_t *tszUrl, char **szData, MCONTACT hContact, CFeedEditor
 	nlhr.nlc = hNetlibHttp;
 
 	// change the header so the plugin is pretended to be IE 6 + WinXP
-	NETLIBHTTPHEADER headers[5];
+	NETLIBHTTPHEADER headers[7];
 	nlhr.headersCount = 4;
 	nlhr.headers = headers;
 	nlhr.headers[0].szName = "User-Agent";
@@ -80,9 +83,25 @@ void GetNewsData(wchar_t *tszUrl, char **szData, MCONTACT hContact, CFeedEditor
 		nlhr.headers[4].szValue = auth;
 	}
 
+	ptrA szETag, szModified;
+	if (bRevalidate && hContact) {
+		szETag = g_plugin.getStringA(hContact, "ETag");
+		if (szETag) {
+			nlhr.headers[nlhr.headersCount].szName = "If-None-Match";
+			nlhr.headers[nlhr.headersCount++].szValue = szETag;
+		}
+		szModified = g_plugin.getStringA(hContact, "LastModified");
+		if (szModified) {
+			nlhr.headers[nlhr.headersCount].szName = "If-Modified-Since";
+			nlhr.headers[nlhr.headersCount++].szValue = szModified;
+		}
+	}
+
 	// download the page
+	int iResult = 0;
 	NLHR_PTR nlhrReply(Netlib_HttpTransaction(hNetlibUser, &nlhr));
 	if (nlhrReply) {
+		iResult = nlhrReply->resultCode;
 		// if the recieved code is 200 OK
 		if (nlhrReply->resultCode == 200 && nlhrReply->dataLength > 0) {
 			Netlib_LogfW(hNetlibUser, L"Code 200: Succeeded getting feed data %s.", tszUrl);
@@ -90,18 +109,34 @@ void GetNewsData(wchar_t *tszUrl, char **szData, MCONTACT hContact, CFeedEditor
 			*szData = (char *)mir_alloc((size_t)nlhrReply->dataLength + 2);
 			memcpy(*szData, nlhrReply->pData, (size_t)nlhrReply->dataLength);
 			(*szData)[nlhrReply->dataLength] = 0;
+
+			// remember the validators for the next check
+			if (hContact) {
+				if (auto *pszETag = nlhrReply->GetHeader("ETag"))
+					g_plugin.setString(hContact, "ETag", pszETag);
+				else
+					g_plugin.delSetting(hContact, "ETag");
+
+				if (auto *pszModified = nlhrReply->GetHeader("Last-Modified"))
+					g_plugin.setString(hContact, "LastModified", pszModified);
+				else
+					g_plugin.delSetting(hContact, "LastModified");
+			}
 		}
+		else if (nlhrReply->resultCode == 304)
+			Netlib_LogfW(hNetlibUser, L"Code 304: feed %s is not modified.", tszUrl);
 		else if (nlhrReply->resultCode == 401) {
 			Netlib_LogfW(hNetlibUser, L"Code 401: feed %s needs auth data.", tszUrl);
 
 			if (CAuthRequest(pEditDlg, hContact).DoModal())
-				GetNewsData(tszUrl, szData, hContact, pEditDlg);
+				iResult = GetNewsData(tszUrl, szData, hContact, pEditDlg, bRevalidate);
 		}
 		else Netlib_LogfW(hNetlibUser, L"Code %d: Failed getting feed data %s.", nlhrReply->resultCode, tszUrl);
 	}
 	else Netlib_LogfW(hNetlibUser, L"Failed getting feed data %s, no response.", tszUrl);
 
 	mir_free(szUrl);
+	return iResult;
 }
 
 time_t DateToUnixTime(const char *stamp, bool FeedType)
@@ -29,6 +29,8 @@ Boston, MA 02111-1307, USA.
 #include <sys/stat.h>
 #include <mshtml.h>
 
+#include <algorithm>
+
 // Miranda header files
 #include <newpluginapi.h>
 #include <m_clist.h>
@@ -123,7 +125,7 @@ void     CALLBACK timerProc(HWND hwnd, UINT uMsg, UINT_PTR idEvent, DWORD dwTime
 void     CALLBACK timerProc2(HWND hwnd, UINT uMsg, UINT_PTR idEvent, DWORD dwTime);
 
 bool     IsMyContact(MCONTACT hContact);
-void     GetNewsData(wchar_t *szUrl, char **szData, MCONTACT hContact, CFeedEditor *pEditDlg);
+int      GetNewsData(wchar_t *szUrl, char **szData, MCONTACT hContact, CFeedEditor *pEditDlg, bool bRevalidate = false);
 time_t   DateToUnixTime(const char *stamp, bool FeedType);
 void     CheckCurrentFeed(MCONTACT hContact);
 void     CheckCurrentFeedAvatar(MCONTACT hContact);
@@ -51,6 +51,9 @@ struct CToxProto;
 #define TOX_ERROR -1
 
 #define TOX_DEFAULT_INTERVAL 50
+#define TOX_TRANSFER_INTERVAL 1
+#define TOX_TRANSFER_IDLE 1000
+#define TOX_STOP_TIMEOUT 5000
 #define TOX_CHECKING_INTERVAL 1000
 
 #define TOX_MAX_CONNECT_RETRIES 10
@@ -71,14 +71,64 @@ void CToxProto::OnToxCheck(void *arg, uint8_t)
 		proto->CheckConnection();
 }
 
-void CToxProto::OnToxPoll(void *arg, uint8_t)
+void CToxProto::StartPolling()
 {
-	CToxProto *proto = (CToxProto*)arg;
-	if (proto->m_tox)
-		tox_iterate(proto->m_tox, arg);
+	m_bStopPolling = false;
+	ResetEvent(m_hPollingEvent);
+	m_hPollingThread = ForkThreadEx(&CToxProto::PollingThread, nullptr, nullptr);
+}
+
+void CToxProto::StopPolling()
+{
+	if (m_hPollingThread == nullptr)
+		return;
+
+	m_bStopPolling = true;
+	SetEvent(m_hPollingEvent);
+
+	// tox callbacks might wait for the main thread, so keep its messages flowing
+	uint32_t dwStart = GetTickCount();
+	for (;;) {
+		uint32_t dwElapsed = GetTickCount() - dwStart;
+		if (dwElapsed >= TOX_STOP_TIMEOUT) {
+			debugLogA(__FUNCTION__": polling thread is stuck, killing it");
+			TerminateThread(m_hPollingThread, 0);
+			break;
+		}
+
+		uint32_t res = MsgWaitForMultipleObjects(1, &m_hPollingThread, FALSE, TOX_STOP_TIMEOUT - dwElapsed, QS_ALLINPUT);
+		if (res != WAIT_OBJECT_0 + 1)
+			break;
+
+		MSG msg;
+		while (PeekMessage(&msg, nullptr, 0, 0, PM_REMOVE)) {
+			TranslateMessage(&msg);
+			DispatchMessage(&msg);
+		}
+	}
+	CloseHandle(m_hPollingThread);
+	m_hPollingThread = nullptr;
+}
+
+void CToxProto::PollingThread(void*)
+{
+	debugLogA(__FUNCTION__": entering");
+
+	while (!m_bStopPolling) {
+		tox_iterate(m_tox, this);
+
+		// tox knows when it has to be called again, but file chunks are
+		// requested and sent during iterations only, so don't sleep while
+		// data is flowing
+		uint32_t interval = tox_iteration_interval(m_tox);
+		if (interval > TOX_DEFAULT_INTERVAL)
+			interval = TOX_DEFAULT_INTERVAL;
+		if (transfers.HasActive() && interval > TOX_TRANSFER_INTERVAL)
+			interval = TOX_TRANSFER_INTERVAL;
+
+		if (interval)
+			WaitForSingleObject(m_hPollingEvent, interval);
+	}
 
-	/*uint32_t interval = tox_iteration_interval(proto->m_tox);
-	interval = interval
-		? interval
-		: TOX_DEFAULT_INTERVAL;*/
+	debugLogA(__FUNCTION__": leaving");
 }
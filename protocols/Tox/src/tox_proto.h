@@ -70,9 +70,12 @@ private:
 
 	int m_retriesCount;
 	HANDLE m_hTimerQueue;
-	HANDLE m_hPollingTimer;
 	HANDLE m_hCheckingTimer;
 
+	bool m_bStopPolling;
+	HANDLE m_hPollingThread;
+	HANDLE m_hPollingEvent;
+
 	static HANDLE hProfileFolderPath;
 
 	// tox profile
@@ -112,7 +115,10 @@ private:
 	void CheckConnection();
 
 	static void __stdcall OnToxCheck(void*, uint8_t);
-	static void __stdcall OnToxPoll(void*, uint8_t);
+
+	void __cdecl PollingThread(void*);
+	void StartPolling();
+	void StopPolling();
 
 	// accounts
 	int __cdecl OnAccountRenamed(WPARAM, LPARAM);
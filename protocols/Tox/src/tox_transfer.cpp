@@ -84,6 +84,7 @@ HANDLE CToxProto::OnFileAllow(Tox *tox, MCONTACT hContact, HANDLE hTransfer, con
 	if (!ProtoBroadcastAck(hContact, ACKTYPE_FILE, ACKRESULT_FILERESUME, (HANDLE)transfer, (LPARAM)&transfer->pfts))
 		OnFileResume(tox, hTransfer, FILERESUME_OVERWRITE, fullPath);
 
+	SetEvent(m_hPollingEvent);
 	return hTransfer;
 }
 
@@ -120,6 +121,7 @@ int CToxProto::OnFileResume(Tox *tox, HANDLE hTransfer, int action, const wchar_
 		ProtoBroadcastAck(transfer->pfts.hContact, ACKTYPE_FILE, ACKRESULT_FAILED, (HANDLE)transfer);
 		transfers.Remove(transfer);
 	}
+	else transfer->dwLastChunk = GetTickCount();
 
 	return 0;
 }
@@ -143,6 +145,8 @@ void CToxProto::OnDataReceiving(Tox *tox, uint32_t friendNumber, uint32_t fileNu
 		return;
 	}
 
+	transfer->dwLastChunk = GetTickCount();
+
 	MCONTACT hContact = proto->GetContact(tox, friendNumber);
 	if (hContact == NULL) {
 		proto->debugLogA(__FUNCTION__": cannot find contact %s (%d)", (const char*)pubKey, friendNumber);
@@ -223,6 +227,8 @@ void CToxProto::OnFileRequest(Tox *tox, uint32_t friendNumber, uint32_t fileNumb
 			proto->ProtoBroadcastAck(transfer->pfts.hContact, ACKTYPE_FILE, ACKRESULT_FAILED, (HANDLE)transfer);
 			proto->transfers.Remove(transfer);
 		}
+		// the first chunks are expected at once
+		else transfer->dwLastChunk = GetTickCount();
 		break;
 
 	case TOX_FILE_CONTROL_CANCEL:
@@ -277,6 +283,8 @@ HANDLE CToxProto::OnSendFile(Tox *tox, MCONTACT hContact, const wchar_t*, wchar_
 	transfer->hFile = hFile;
 	transfers.Add(transfer);
 
+	// wake the polling thread, so that the offer goes out at once
+	SetEvent(m_hPollingEvent);
 	return (HANDLE)transfer;
 }
 
@@ -304,6 +312,8 @@ void CToxProto::OnFileSendData(Tox *tox, uint32_t friendNumber, uint32_t fileNum
 		return;
 	}
 
+	transfer->dwLastChunk = GetTickCount();
+
 	uint64_t sentBytes = _ftelli64(transfer->hFile);
 	if (sentBytes != position && !_fseeki64(transfer->hFile, position, SEEK_SET)) {
 		proto->debugLogA(__FUNCTION__": failed seek into file (%d)", fileNumber);
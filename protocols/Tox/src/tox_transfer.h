@@ -8,12 +8,14 @@ struct FileTransferParam
 	uint32_t friendNumber;
 	uint32_t fileNumber;
 	uint64_t transferNumber;
+	uint32_t dwLastChunk; // tick of the last chunk sent or received
 
 	TOX_FILE_KIND transferType;
 
 	FileTransferParam(uint32_t friendNumber, uint32_t fileNumber, const wchar_t *fileName, uint64_t fileSize)
 	{
 		hFile = nullptr;
+		dwLastChunk = 0;
 		this->friendNumber = friendNumber;
 		this->fileNumber = fileNumber;
 		transferNumber = (((int64_t)friendNumber) << 32) | ((int64_t)fileNumber);
@@ -95,6 +97,16 @@ public:
 		return transfers.size();
 	}
 
+	// pending offers and stalled transfers don't count
+	bool HasActive() const
+	{
+		uint32_t dwNow = GetTickCount();
+		for (auto &it : transfers)
+			if (dwNow - it.second->dwLastChunk < TOX_TRANSFER_IDLE)
+				return true;
+		return false;
+	}
+
 	void Add(FileTransferParam *transfer)
 	{
 		if (transfers.find(transfer->transferNumber) == transfers.end())
@@ -156,14 +156,8 @@ MCONTACT CVkProto::FindUser(LONG dwUserid, bool bCreate)
 	if (!dwUserid)
 		return 0;
 
-	for (auto &hContact : AccContacts()) {
-		LONG dbUserid = getDword(hContact, "ID", VK_INVALID_USER);
-		if (dbUserid == VK_INVALID_USER)
-			continue;
-
-		if (dbUserid == dwUserid)
-			return hContact;
-	}
+	if (MCONTACT hContact = Contact_FindByUniqueIdInt(m_szModuleName, dwUserid))
+		return hContact;
 
 	if (!bCreate)
 		return 0;
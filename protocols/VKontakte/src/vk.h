@@ -90,6 +90,7 @@ along with this program. If not, see <http://www.gnu.org/licenses/>.
 
 #define VK_API_VER "5.131"
 #define VER_API CHAR_PARAM("v", VK_API_VER)
+#define VK_MAX_BATCH 25 // API calls per execute request
 
 #define VK_FEED_USER 2147483647L
 #define VK_INVALID_USER 0L
@@ -377,6 +377,8 @@ private:
 	void InitQueue();
 	void UninitQueue();
 	bool ExecuteRequest(AsyncHttpRequest*);
+	bool ExecuteBatch(LIST<AsyncHttpRequest>&);
+	void OnReceiveBatch(NETLIBHTTPREQUEST*, AsyncHttpRequest*);
 	void __cdecl WorkerThread(void*);
 	AsyncHttpRequest* Push(MHttpRequest *pReq, int iTimeout = 10000);
 	bool RunCaptchaForm(LPCSTR szUrl, CMStringA&);
@@ -106,6 +106,158 @@ bool CVkProto::ExecuteRequest(AsyncHttpRequest *pReq)
 	return true;
 }
 
+/////////////////////////////////////////////////////////////////////////////////////////
+// plain API methods that can be packed into a single execute request.
+// stored procedures (execute.*) cannot be called from VKScript, and methods which may
+// require a captcha or return extended error info are always sent alone
+
+static const char *szBatchMethods[] = {
+	"account.setOnline",
+	"groups.getById",
+	"messages.markAsRead",
+	"messages.setActivity",
+	"notifications.markAsViewed",
+	"stats.trackVisitor",
+	"status.get",
+	"users.get"
+};
+
+static const char* GetBatchMethod(const AsyncHttpRequest *pReq)
+{
+	if (!pReq->m_bApiReq || !pReq->bIsMainConn || pReq->m_bNoBatch)
+		return nullptr;
+
+	int idx = pReq->m_szUrl.Find("/method/");
+	if (idx == -1)
+		return nullptr;
+
+	CMStringA szMethod(pReq->m_szUrl.Mid(idx + 8));
+	if (szMethod.Right(5) != ".json")
+		return nullptr;
+
+	szMethod.Truncate(szMethod.GetLength() - 5);
+	for (auto &it : szBatchMethods)
+		if (szMethod == it)
+			return it;
+
+	return nullptr;
+}
+
+bool CVkProto::ExecuteBatch(LIST<AsyncHttpRequest> &arBatch)
+{
+	debugLogA("CVkProto::ExecuteBatch %d requests", arBatch.getCount());
+
+	CMStringA szCode("return [");
+	for (auto &it : arBatch) {
+		// parameters are passed as a json object, without the ones common for the execute call
+		JSONNode jnParams;
+		int iStart = 0;
+		for (CMStringA szPair = it->m_szParam.Tokenize("&", iStart); iStart != -1; szPair = it->m_szParam.Tokenize("&", iStart)) {
+			int iEq = szPair.Find('=');
+			if (iEq == -1)
+				continue;
+
+			CMStringA szName(szPair.Left(iEq)), szValue(szPair.Mid(iEq + 1));
+			if (szName == "access_token" || szName == "v" || szName == "lang")
+				continue;
+
+			mir_urlDecode(szValue.GetBuffer());
+			szValue.ReleaseBuffer();
+			jnParams << CHAR_PARAM(szName, szValue);
+		}
+
+		if (it != arBatch[0])
+			szCode.AppendChar(',');
+		szCode.AppendFormat("API.%s(%s)", GetBatchMethod(it), jnParams.write().c_str());
+	}
+	szCode += "];";
+
+	AsyncHttpRequest *pReq = new AsyncHttpRequest(this, REQUEST_POST, "/method/execute.json", true, &CVkProto::OnReceiveBatch, AsyncHttpRequest::rpHigh);
+	pReq << CHAR_PARAM("code", szCode) << VER_API;
+	if (!IsEmpty(m_vkOptions.pwszVKLang))
+		pReq << WCHAR_PARAM("lang", m_vkOptions.pwszVKLang);
+	pReq->timeout = 10000;
+	pReq->pUserInfo = &arBatch;
+
+	if (!ExecuteRequest(pReq)) {
+		for (auto &it : arBatch)
+			delete it;
+		arBatch.destroy();
+		return false;
+	}
+
+	// everything that wasn't dispatched from the batch reply is resent one by one
+	if (arBatch.getCount()) {
+		debugLogA("CVkProto::ExecuteBatch requeueing %d requests", arBatch.getCount());
+		{
+			mir_cslock lck(m_csRequestsQueue);
+			for (auto &it : arBatch) {
+				it->m_bNoBatch = true;
+				m_arRequestsQueue.insert(it);
+			}
+		}
+		SetEvent(m_evRequestsQueue);
+	}
+
+	arBatch.destroy();
+	return true;
+}
+
+void CVkProto::OnReceiveBatch(NETLIBHTTPREQUEST *reply, AsyncHttpRequest *pReq)
+{
+	debugLogA("CVkProto::OnReceiveBatch %d", reply->resultCode);
+	if (reply->resultCode != 200 || !reply->pData)
+		return;
+
+	JSONNode jnRoot = JSONNode::parse(reply->pData);
+	if (!CheckJsonResult(pReq, jnRoot))
+		return;
+
+	const JSONNode &jnResponse = jnRoot["response"];
+	if (!jnResponse || jnResponse.type() != JSON_ARRAY)
+		return;
+
+	// failed calls return false, their errors are listed in execute_errors in the same order
+	const JSONNode &jnErrors = jnRoot["execute_errors"];
+	auto itError = jnErrors.begin();
+
+	auto &arBatch = *(LIST<AsyncHttpRequest> *)pReq->pUserInfo;
+	int i = 0;
+	for (auto &it : jnResponse) {
+		if (i >= arBatch.getCount())
+			break;
+
+		AsyncHttpRequest *pSub = arBatch[i];
+		CMStringA szReply;
+		if (it.type() == JSON_BOOL && !it.as_bool()) {
+			if (itError != jnErrors.end()) {
+				szReply.Format("{\"error\":%s}", (*itError).write().c_str());
+				++itError;
+			}
+			else szReply.Format("{\"error\":{\"error_code\":%d}}", VKERR_UNKNOWN);
+		}
+		else szReply.Format("{\"response\":%s}", it.write().c_str());
+
+		NETLIBHTTPREQUEST nlhr = {};
+		nlhr.resultCode = 200;
+		nlhr.pData = szReply.GetBuffer();
+		nlhr.dataLength = szReply.GetLength();
+
+		pSub->bNeedsRestart = false;
+		pSub->m_iErrorCode = 0;
+		if (pSub->m_pFunc != nullptr)
+			(this->*(pSub->m_pFunc))(&nlhr, pSub);
+
+		// a request that wants to be restarted stays in the list and is resent alone
+		if (pSub->bNeedsRestart)
+			i++;
+		else {
+			arBatch.remove(i);
+			delete pSub;
+		}
+	}
+}
+
 /////////////////////////////////////////////////////////////////////////////////////////
 
 AsyncHttpRequest* CVkProto::Push(MHttpRequest *p, int iTimeout)
@@ -191,6 +343,7 @@ void CVkProto::WorkerThread(void*)
 			break;
 
 		AsyncHttpRequest *pReq;
+		LIST<AsyncHttpRequest> arBatch(VK_MAX_BATCH);
 		ULONG uTime[3] = { 0, 0, 0 };
 		long lWaitingTime = 0;
 
@@ -203,6 +356,21 @@ void CVkProto::WorkerThread(void*)
 				pReq = m_arRequestsQueue[0];
 				m_arRequestsQueue.remove(0);
 
+				// collect other pending calls which can go in the same execute request
+				if (GetBatchMethod(pReq)) {
+					for (int i = 0; i < m_arRequestsQueue.getCount() && arBatch.getCount() < VK_MAX_BATCH - 1;) {
+						AsyncHttpRequest *p = m_arRequestsQueue[i];
+						if (GetBatchMethod(p)) {
+							arBatch.insert(p);
+							m_arRequestsQueue.remove(i);
+						}
+						else i++;
+					}
+
+					if (arBatch.getCount())
+						arBatch.insert(pReq, 0);
+				}
+
 				ULONG utime = GetTickCount();
 				lWaitingTime = (utime - uTime[0]) > 1500 ? 0 : 1500 - (utime - uTime[0]);
 
@@ -226,7 +394,11 @@ void CVkProto::WorkerThread(void*)
 				// see https://vk.com/dev/api_requests
 			}
 
-			if (!ExecuteRequest(pReq))
+			if (arBatch.getCount()) {
+				if (!ExecuteBatch(arBatch))
+					return;
+			}
+			else if (!ExecuteRequest(pReq))
 				return;
 		}
 	}
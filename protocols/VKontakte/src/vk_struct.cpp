@@ -30,6 +30,7 @@ AsyncHttpRequest::AsyncHttpRequest()
 	m_iErrorCode = 0;
 	bNeedsRestart = false;
 	bIsMainConn = false;
+	m_bNoBatch = false;
 	m_pFunc = nullptr;
 	m_reqNum = ::InterlockedIncrement(&m_reqCount);
 	m_priority = rpLow;
@@ -39,6 +40,7 @@ AsyncHttpRequest::AsyncHttpRequest(CVkProto *ppro, int iRequestType, LPCSTR _url
 {
 	m_bApiReq = true;
 	bIsMainConn = false;
+	m_bNoBatch = false;
 	AddHeader("Connection", "keep-alive");
 
 	if (*_url == '/') {	// relative url leads to a site
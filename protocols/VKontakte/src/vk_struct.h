@@ -33,7 +33,7 @@ struct AsyncHttpRequest : public MTHttpRequest<CVkProto>
 	static ULONG m_reqCount;
 	ULONG m_reqNum;
 	bool m_bApiReq;
-	bool bNeedsRestart, bIsMainConn;
+	bool bNeedsRestart, bIsMainConn, m_bNoBatch;
 };
 
 struct CVkFileUploadParam : public MZeroedObject {
@@ -219,6 +219,93 @@ INT_PTR SaveMailDataSvc(WPARAM, LPARAM lParam)
 	return (INT_PTR)0;
 }
 
+//Index of a mail queue by message IDs, so that synchronizing two queues is not quadratic
+//Open addressing keeps messages with equal IDs in the same probe chain in queue order,
+//so Take() returns them in the same order as the linear search did
+struct CMailIdIndex
+{
+	struct Slot
+	{
+		HYAMNMAIL Mail;
+		unsigned int Hash;
+		bool Taken;
+	};
+
+	Slot *Slots;
+	unsigned int Mask;
+
+	HYAMNMAIL *Matched;						//taken messages in the order they were matched
+	int MatchedCount;
+
+	CMailIdIndex(HYAMNMAIL Queue)
+	{
+		int Count=0;
+		for (HYAMNMAIL Parser=Queue;Parser != nullptr;Parser=Parser->Next)
+			if (IsIndexed(Parser))
+				Count++;
+
+		unsigned int Size=16;
+		while(Size<2*(unsigned int)Count)
+			Size<<=1;
+		Mask=Size-1;
+		Slots=(Slot *)mir_calloc(Size*sizeof(Slot));
+
+		Matched=(HYAMNMAIL *)mir_alloc((Count+1)*sizeof(HYAMNMAIL));
+		MatchedCount=0;
+
+		for (HYAMNMAIL Parser=Queue;Parser != nullptr;Parser=Parser->Next)
+		{
+			if (!IsIndexed(Parser))
+				continue;
+
+			unsigned int Hash=mir_hashstr(Parser->ID);
+			unsigned int i;
+			for (i=Hash&Mask;Slots[i].Mail != nullptr;i=(i+1)&Mask);
+			Slots[i].Mail=Parser;
+			Slots[i].Hash=Hash;
+		}
+	}
+
+	~CMailIdIndex()
+	{
+		mir_free(Matched);
+		mir_free(Slots);
+	}
+
+	static bool IsIndexed(HYAMNMAIL Mail)
+	{
+		return !(Mail->Flags & YAMN_MSG_DELETED) && Mail->ID != nullptr;	//deleted messages and messages without ID are never matched
+	}
+
+	//returns the first not yet taken message with this ID and marks it as taken
+	HYAMNMAIL Take(const char *ID)
+	{
+		if (ID==nullptr)
+			return nullptr;
+
+		unsigned int Hash=mir_hashstr(ID);
+		for (unsigned int i=Hash&Mask;Slots[i].Mail != nullptr;i=(i+1)&Mask)
+			if (!Slots[i].Taken && Slots[i].Hash==Hash && 0==mir_strcmp(Slots[i].Mail->ID,ID))
+			{
+				Slots[i].Taken=true;
+				Matched[MatchedCount++]=Slots[i].Mail;
+				return Slots[i].Mail;
+			}
+		return nullptr;
+	}
+
+	bool IsTaken(HYAMNMAIL Mail) const
+	{
+		if (!IsIndexed(Mail))
+			return false;
+
+		for (unsigned int i=mir_hashstr(Mail->ID)&Mask;Slots[i].Mail != nullptr;i=(i+1)&Mask)
+			if (Slots[i].Mail==Mail)
+				return Slots[i].Taken;
+		return false;
+	}
+};
+
 void WINAPI SynchroMessagesFcn(CAccount *Account,HYAMNMAIL *OldQueue,HYAMNMAIL *RemovedOld,HYAMNMAIL *NewQueue,HYAMNMAIL *RemovedNew)
 //deletes messages from new queue, if they are old
 //it also deletes messages from old queue, if they are not in mailbox anymore
@@ -226,12 +313,14 @@ void WINAPI SynchroMessagesFcn(CAccount *Account,HYAMNMAIL *OldQueue,HYAMNMAIL *
 //"YAMN_MSG_DELETED" messages in new queue remain in new queue (are never removed, although they can be in old queue)
 {
 	HYAMNMAIL Finder,FinderPrev;
-	HYAMNMAIL Parser,ParserPrev;
+	HYAMNMAIL Parser;
 	HYAMNMAIL RemovedOldParser =nullptr;
 	HYAMNMAIL RemovedNewParser =nullptr;
 	if (RemovedOld != nullptr) *RemovedOld=nullptr;
 	if (RemovedNew != nullptr) *RemovedNew=nullptr;
 
+	CMailIdIndex NewIndex(*NewQueue);
+
 	for (FinderPrev=nullptr,Finder=*OldQueue;Finder != nullptr;)
 	{
 		if (Finder->Flags & YAMN_MSG_DELETED)			//if old queue contains deleted mail
@@ -240,36 +329,9 @@ void WINAPI SynchroMessagesFcn(CAccount *Account,HYAMNMAIL *OldQueue,HYAMNMAIL *
 			Finder=Finder->Next;						//get next message in old queue for testing
 			continue;
 		}
-		for (ParserPrev=nullptr,Parser=*NewQueue;Parser != nullptr;ParserPrev=Parser,Parser=Parser->Next)
-		{
-			if (Parser->Flags & YAMN_MSG_DELETED)
-				continue;
-
-			if (Parser->ID==nullptr)						//simply ignore the message, that has not filled its ID
-				continue;
-
-			if (0==mir_strcmp(Parser->ID,Finder->ID))		//search for equal message in new queue
-				break;
-		}
-		if (Parser != nullptr)								//found equal message in new queue
+		if ((Parser=NewIndex.Take(Finder->ID)) != nullptr)	//found equal message in new queue
 		{
-			if (Parser==*NewQueue)
-				*NewQueue=(*NewQueue)->Next;
-			else
-				ParserPrev->Next=Parser->Next;
 			Finder->Number=Parser->Number;				//rewrite the number of current message in old queue
-
-			if (RemovedNew==nullptr)						//delete from new queue
-				DeleteAccountMailSvc((WPARAM)Account->Plugin,(LPARAM)Parser);
-			else										//or move to RemovedNew
-			{
-				if (RemovedNewParser==nullptr)				//if it is first mail removed from NewQueue
-					*RemovedNew=Parser;					//set RemovedNew queue to point to first message in removed queue
-				else
-					RemovedNewParser->Next=Parser;		//else don't forget to show to next message in RemovedNew queue
-				RemovedNewParser=Parser;				//follow RemovedNew queue
-				RemovedNewParser->Next=nullptr;
-			}
 			FinderPrev=Finder;
 			Finder=Finder->Next;						//get next message in old queue for testing
 		}
@@ -309,6 +371,28 @@ void WINAPI SynchroMessagesFcn(CAccount *Account,HYAMNMAIL *OldQueue,HYAMNMAIL *
 			}
 		}
 	}
+
+	for (HYAMNMAIL *Link=NewQueue;*Link != nullptr;)	//unlink found messages from new queue
+		if (NewIndex.IsTaken(*Link))
+			*Link=(*Link)->Next;
+		else
+			Link=&(*Link)->Next;
+
+	for (int i=0;i<NewIndex.MatchedCount;i++)
+	{
+		Parser=NewIndex.Matched[i];
+		if (RemovedNew==nullptr)						//delete from new queue
+			DeleteAccountMailSvc((WPARAM)Account->Plugin,(LPARAM)Parser);
+		else											//or move to RemovedNew
+		{
+			if (RemovedNewParser==nullptr)				//if it is first mail removed from NewQueue
+				*RemovedNew=Parser;						//set RemovedNew queue to point to first message in removed queue
+			else
+				RemovedNewParser->Next=Parser;			//else don't forget to show to next message in RemovedNew queue
+			RemovedNewParser=Parser;					//follow RemovedNew queue
+			RemovedNewParser->Next=nullptr;
+		}
+	}
 }
 
 void WINAPI DeleteMessagesToEndFcn(CAccount *Account,HYAMNMAIL From)
@@ -41,6 +41,11 @@ char *CPop3Client::Connect(const char* servername,const int port,BOOL UseSSL, BO
 	SSL = UseSSL;
 	NetClient = new CNLClient;
 
+	free(ReadAhead); // nothing can be left from the previous session
+	ReadAhead = nullptr;
+	ReadAheadLen = 0;
+	Pipelining = FALSE;
+
 #ifdef DEBUG_DECODE
 	DebugLog(DecodeFile, "Connect:servername: %s port:%d\n", servername, port);
 #endif
@@ -58,14 +63,14 @@ char *CPop3Client::Connect(const char* servername,const int port,BOOL UseSSL, BO
 		}
 	}
 
-	char *temp = RecvRest(NetClient->Recv(), POP3_SEARCHACK);
+	char *temp = RecvRest(POP3_SEARCHACK);
 	extern BOOL SSLLoaded;
 	if (!NoTLS & !(SSL)) {
 		if (NetClient->Stopped)			//check if we can work with this POP3 client session
 			throw POP3Error = (uint32_t)EPOP3_STOPPED;
 		NetClient->Send("STLS\r\n");
 		free(temp);
-		temp = RecvRest(NetClient->Recv(), POP3_SEARCHACK);
+		temp = RecvRest(POP3_SEARCHACK);
 		if (AckFlag == POP3_FOK) { // Ok, we are going to tls
 			try {
 				NetClient->SSLify();
@@ -76,111 +81,129 @@ char *CPop3Client::Connect(const char* servername,const int port,BOOL UseSSL, BO
 			}
 		}
 	}
+
+	// ask for capabilities after STLS, they can differ on the secured connection
+	unsigned char GreetingAck = AckFlag;
+	try {
+		free(Capa());
+	}
+	catch (...) {
+		free(temp);
+		throw;
+	}
+	AckFlag = GreetingAck;
 	return temp;
 }
 
-//Receives data to the end of packet
-// prev- previous data read (appends to this string next received data)
+//Receives one whole response of the server
 // mode- mode of packet. 
 //       Packet can end with ack state (+OK or -ERR): set mode to POP3_SEARCHACK
 //       If packet ends with '.' (end of string), set mode to POP3_SEARCHDOT
-// size- received data are stored to memory, but if length of data is more than allocated memory, function allocates
-//       new memory. New allocated memory has allocated size more bytes
-//       This value can be selectable: if you think it is better to reallocate by 1kB size, select size to 1024,
-//       default is 128. You do not need to use this parameter
+// size- size of one network read. When the buffer of the response is full, it is doubled, so long responses
+//       (UIDL, LIST, RETR) are received in linear time. You do not need to use this parameter
+//The response is scanned line by line as it comes, each received byte is checked only once.
+//Data received behind the end of the response belong to the next pipelined response and they are kept for the next call.
+//Returns zero terminated response, its length is stored to NetClient->Rcv
 
-char* CPop3Client::RecvRest(char* prev,int mode,int size)
+char* CPop3Client::RecvRest(int mode,int size)
 {
-	int SizeRead=0;
-	int SizeLeft=size-NetClient->Rcv;
-	int RcvAll=NetClient->Rcv;
-	char *LastString,*PrevString=prev;
+	char *Buffer=ReadAhead,*NewBuffer;
+	int Len=ReadAheadLen;
+	int Alloc=Len+size+1;
+	int LineStart=0,End=0;
+	BOOL StatusLine=TRUE;
+
+	ReadAhead=nullptr;
+	ReadAheadLen=0;
+	if (nullptr==(NewBuffer=(char *)realloc(Buffer,Alloc)))
+	{
+		free(Buffer);
+		throw POP3Error=(uint32_t)EPOP3_RESTALLOC;
+	}
+	Buffer=NewBuffer;
 
 	AckFlag=0;
 
-	while(((mode==POP3_SEARCHDOT) && !SearchFromEnd(PrevString+RcvAll-1,RcvAll-3,POP3_SEARCHDOT) && !SearchFromStart(PrevString,2,POP3_SEARCHERR)) ||		//we are looking for dot or -err phrase
-		((mode==POP3_SEARCHACK) && (!SearchFromStart(PrevString,RcvAll-3,mode) || !((RcvAll>3) && SearchFromEnd(PrevString+RcvAll-1,1,POP3_SEARCHNL)))))			//we are looking for +ok or -err phrase ended with newline
-	{		//if not found
+	for (int Scanned=0;;)
+	{
+		char *EndOfLine;
+		while(0==End && nullptr != (EndOfLine=(char *)memchr(Buffer+Scanned,'\n',Len-Scanned)))	//check every complete line only once
+		{
+			char *Line=Buffer+LineStart;
+			int NextLine=int(EndOfLine-Buffer)+1;
+
+			if (mode==POP3_SEARCHACK)								//we are looking for +ok or -err phrase ended with newline
+			{
+				if (ACKLINE(Line))
+				{
+					AckFlag=OKLINE(Line) ? POP3_FOK : POP3_FERR;
+					End=NextLine;
+				}
+			}
+			else if (StatusLine)									//-err ends the response, +ok is followed by data
+			{
+				StatusLine=FALSE;
+				if (ERRLINE(Line))
+				{
+					AckFlag=POP3_FERR;
+					End=NextLine;
+				}
+				else if (OKLINE(Line))
+					AckFlag=POP3_FOK;
+			}
+			else if (Line[0]=='.' && ((Line+1==EndOfLine) || (Line[1]=='\r' && Line+2==EndOfLine)))	//we are looking for dot line
+				End=NextLine;
+
+			Scanned=LineStart=NextLine;
+		}
+		if (End)
+			break;
+		Scanned=Len;
+
 		if (NetClient->Stopped)			//check if we can work with this POP3 client session
 		{
-			if (PrevString != nullptr)
-				free(PrevString);
+			free(Buffer);
 			throw POP3Error=(uint32_t)EPOP3_STOPPED;
 		}
-		if (SizeLeft==0)						//if block is full
+		if (Alloc-Len-1<size)			//if buffer is full, double it
 		{
-			SizeRead+=size;
-			SizeLeft=size;
-			LastString=NetClient->Recv(nullptr,SizeLeft);
-			PrevString=(char *)realloc(PrevString,sizeof(char)*(SizeRead+size));
-			if (PrevString==nullptr)
+			Alloc*=2;
+			if (nullptr==(NewBuffer=(char *)realloc(Buffer,Alloc)))
+			{
+				free(Buffer);
 				throw POP3Error=(uint32_t)EPOP3_RESTALLOC;
-			memcpy(PrevString+SizeRead,LastString,size);
-			free(LastString);
+			}
+			Buffer=NewBuffer;
 		}
-		else
-			NetClient->Recv(PrevString+RcvAll,SizeLeft);			//to Rcv stores received bytes
-		SizeLeft=SizeLeft-NetClient->Rcv;
-		RcvAll+=NetClient->Rcv;
-	}
-	NetClient->Rcv=RcvAll;			//at the end, store the number of all bytes, no the number of last received bytes
-	return PrevString;
-}
 
-// CPop3Client::SearchFromEnd
-// returns 1 if substring DOTLINE or ENDLINE found from end in bs bytes
-// if you need to add condition for mode, insert it into switch statement
-BOOL CPop3Client::SearchFromEnd(char *end,int bs,int mode)
-{
-	while (bs >= 0) {
-		switch (mode) {
-		case POP3_SEARCHDOT:
-			if (DOTLINE(end))
-				return 1;
-			break;
-
-		case POP3_SEARCHNL:
-			if (ENDLINE(end))
-				return 1;
-			break;
+		char *Block;
+		try
+		{
+			Block=NetClient->Recv(nullptr,size);	//Recv frees its buffer when it fails, so it cannot read directly to our buffer
+		}
+		catch (...)
+		{
+			free(Buffer);
+			throw;
 		}
-		end--;
-		bs--;
+		memcpy(Buffer+Len,Block,NetClient->Rcv);
+		free(Block);
+		Len+=NetClient->Rcv;
 	}
-	return 0;
-}
 
-//Finds for a occurence of some pattern in string
-// returns 1 if substring OKLINE, ERRLINE or any of them found from start in bs bytes
-//call only this function to retrieve ack status (+OK or -ERR), because it sets flag AckFlag
-//if you need to add condition for mode, insert it into switch statement
-BOOL CPop3Client::SearchFromStart(char *start,int bs,int mode)
-{
-	while (bs >= 0) {
-		switch (mode) {
-		case POP3_SEARCHOK:
-			if (OKLINE(start)) {
-				AckFlag = POP3_FOK;
-				return 1;
-			}
-			break;
-		case POP3_SEARCHERR:
-			if (ERRLINE(start)) {
-				AckFlag = POP3_FERR;
-				return 1;
-			}
-			break;
-		case POP3_SEARCHACK:
-			if (ACKLINE(start)) {
-				OKLINE(start) ? AckFlag = POP3_FOK : AckFlag = POP3_FERR;
-				return 1;
-			}
-			break;
+	if (End<Len)						//keep the start of the next response
+	{
+		if (nullptr==(ReadAhead=(char *)malloc(Len-End)))
+		{
+			free(Buffer);
+			throw POP3Error=(uint32_t)EPOP3_RESTALLOC;
 		}
-		start++;
-		bs--;
+		memcpy(ReadAhead,Buffer+End,Len-End);
+		ReadAheadLen=Len-End;
 	}
-	return 0;
+	Buffer[End]=0;
+	NetClient->Rcv=End;			//at the end, store the length of the response, no the number of last received bytes
+	return Buffer;
 }
 
 //Performs "USER" pop query and returns server response
@@ -195,7 +218,7 @@ char* CPop3Client::User(char* name)
 
 	mir_snprintf(query, "USER %s\r\n", name);
 	NetClient->Send(query);
-	Result = RecvRest(NetClient->Recv(), POP3_SEARCHACK);
+	Result = RecvRest(POP3_SEARCHACK);
 	if (AckFlag == POP3_FERR)
 		throw POP3Error = (uint32_t)EPOP3_BADUSER;
 	POP3Error = 0;
@@ -213,7 +236,7 @@ char* CPop3Client::Pass(char* pw)
 	mir_snprintf(query, "PASS %s\r\n", pw);
 	NetClient->Send(query);
 	
-	char *Result = RecvRest(NetClient->Recv(), POP3_SEARCHACK);
+	char *Result = RecvRest(POP3_SEARCHACK);
 	if (AckFlag == POP3_FERR)
 		throw POP3Error = (uint32_t)EPOP3_BADPASS;
 	return Result;
@@ -242,7 +265,7 @@ char* CPop3Client::APOP(char* name, char* pw, char* timestamp)
 	mir_snprintf(query, "APOP %s %s\r\n", name, bin2hex(digest, sizeof(digest), hexdigest));
 
 	NetClient->Send(query);
-	Result = RecvRest(NetClient->Recv(), POP3_SEARCHACK);
+	Result = RecvRest(POP3_SEARCHACK);
 	if (AckFlag == POP3_FERR)
 		throw POP3Error = (uint32_t)EPOP3_BADUSER;
 	return Result;
@@ -255,7 +278,7 @@ char* CPop3Client::Quit()
 	char query[]="QUIT\r\n";
 
 	NetClient->Send(query);
-	return RecvRest(NetClient->Recv(),POP3_SEARCHACK);
+	return RecvRest(POP3_SEARCHACK);
 }
 
 //Performs "STAT" pop query and returns server response
@@ -267,7 +290,7 @@ char* CPop3Client::Stat()
 
 	char query[] = "STAT\r\n";
 	NetClient->Send(query);
-	return RecvRest(NetClient->Recv(), POP3_SEARCHACK);
+	return RecvRest(POP3_SEARCHACK);
 }
 
 //Performs "LIST" pop query and returns server response
@@ -280,12 +303,11 @@ char* CPop3Client::List()
 	char query[] = "LIST\r\n";
 
 	NetClient->Send(query);
-	return RecvRest(NetClient->Recv(), POP3_SEARCHDOT);
+	return RecvRest(POP3_SEARCHDOT);
 }
 
-//Performs "TOP" pop query and returns server response
-//sets AckFlag
-char* CPop3Client::Top(int nr, int lines)
+//Sends "TOP" pop query, the response is read by RecvRest(POP3_SEARCHDOT)
+void CPop3Client::SendTop(int nr, int lines)
 {
 	if (NetClient->Stopped) // check if we can work with this POP3 client session
 		throw POP3Error=(uint32_t)EPOP3_STOPPED;
@@ -294,7 +316,14 @@ char* CPop3Client::Top(int nr, int lines)
 
 	mir_snprintf(query, "TOP %d %d\r\n", nr, lines);
 	NetClient->Send(query);
-	return RecvRest(NetClient->Recv(),POP3_SEARCHDOT);
+}
+
+//Performs "TOP" pop query and returns server response
+//sets AckFlag
+char* CPop3Client::Top(int nr, int lines)
+{
+	SendTop(nr, lines);
+	return RecvRest(POP3_SEARCHDOT);
 }
 
 //Performs "UIDL" pop query and returns server response
@@ -308,38 +337,69 @@ char* CPop3Client::Uidl(int nr)
 	if (nr) {
 		mir_snprintf(query, "UIDL %d\r\n", nr);
 		NetClient->Send(query);
-		return RecvRest(NetClient->Recv(), POP3_SEARCHACK);
+		return RecvRest(POP3_SEARCHACK);
 	}
 	mir_snprintf(query, "UIDL\r\n");
 	NetClient->Send(query);
-	return RecvRest(NetClient->Recv(), POP3_SEARCHDOT);
+	return RecvRest(POP3_SEARCHDOT);
+}
+
+//Sends "DELE" pop query, the response is read by RecvRest(POP3_SEARCHACK)
+void CPop3Client::SendDele(int nr)
+{
+	if (NetClient->Stopped) // check if we can work with this POP3 client session
+		throw POP3Error = (uint32_t)EPOP3_STOPPED;
+
+	char query[128];
+
+	mir_snprintf(query, "DELE %d\r\n", nr);
+	NetClient->Send(query);
 }
 
 //Performs "DELE" pop query and returns server response
 //sets AckFlag
 char* CPop3Client::Dele(int nr)
+{
+	SendDele(nr);
+	return RecvRest(POP3_SEARCHACK);
+}
+
+//Sends "RETR" pop query, the response is read by RecvRest(POP3_SEARCHDOT)
+void CPop3Client::SendRetr(int nr)
 {
 	if (NetClient->Stopped) // check if we can work with this POP3 client session
 		throw POP3Error = (uint32_t)EPOP3_STOPPED;
 
 	char query[128];
-
-	mir_snprintf(query, "DELE %d\r\n", nr);
+	mir_snprintf(query, "RETR %d\r\n", nr);
 	NetClient->Send(query);
-	return RecvRest(NetClient->Recv(), POP3_SEARCHACK);
 }
 
 //Performs "RETR" pop query and returns server response
 //sets AckFlag
 char* CPop3Client::Retr(int nr)
+{
+	SendRetr(nr);
+	return RecvRest(POP3_SEARCHDOT);
+}
+
+//Performs "CAPA" pop query (RFC 2449) and returns server response
+//sets AckFlag and Pipelining
+char* CPop3Client::Capa()
 {
 	if (NetClient->Stopped) // check if we can work with this POP3 client session
 		throw POP3Error = (uint32_t)EPOP3_STOPPED;
 
-	char query[128];
-	mir_snprintf(query, "RETR %d\r\n", nr);
+	char query[] = "CAPA\r\n";
 	NetClient->Send(query);
 
-	RecvRest(NetClient->Recv(), POP3_SEARCHACK);
-	return NetClient->Recv();
+	char *Result = RecvRest(POP3_SEARCHDOT);
+	Pipelining = FALSE;
+	if (AckFlag == POP3_FOK) // old servers answer -ERR, they cannot pipeline
+		for (char *Line = strchr(Result, '\n'); Line != nullptr; Line = strchr(Line, '\n')) {
+			Line++;
+			if (!_strnicmp(Line, "PIPELINING", 10) && (ENDLINE(Line + 10) || Line[10] == ' ' || Line[10] == '\0'))
+				Pipelining = TRUE;
+		}
+	return Result;
 }
@@ -9,21 +9,20 @@
 
 #define	POP3_SEARCHDOT	1
 #define	POP3_SEARCHACK	2
-#define	POP3_SEARCHOK	3
-#define	POP3_SEARCHERR	4
-#define	POP3_SEARCHNL	5
 
 #define POP3_FOK	1
 #define POP3_FERR	2
 
+#define POP3_PIPELINEDEPTH	32	//max number of queries sent before reading their responses, if server supports PIPELINING
+
 class CPop3Client
 {
 public:
-	CPop3Client(): NetClient(nullptr), Stopped(FALSE) {}
-	~CPop3Client() { delete NetClient; }
+	CPop3Client(): NetClient(nullptr), Stopped(FALSE), Pipelining(FALSE), ReadAhead(nullptr), ReadAheadLen(0) {}
+	~CPop3Client() { free(ReadAhead); delete NetClient; }
 
 	char* Connect(const char* servername,const int port=110,BOOL UseSSL=FALSE, BOOL NoTLS=FALSE);
-	char* RecvRest(char* prev,int mode,int size=65536);
+	char* RecvRest(int mode,int size=65536);
 	char* User(char* name);
 	char* Pass(char* pw);
 	char* APOP(char* name, char* pw, char* timestamp);
@@ -34,16 +33,23 @@ public:
 	char* Uidl(int nr=0);
 	char* Dele(int nr);
 	char* Retr(int nr);
+	char* Capa();
+
+	//pipelined queries: responses are read later by RecvRest in the same order as queries were sent
+	void SendTop(int nr, int lines=0);
+	void SendDele(int nr);
+	void SendRetr(int nr);
 
 	unsigned char AckFlag;
 	BOOL SSL;
 	BOOL Stopped;
+	BOOL Pipelining;				//server supports PIPELINING (RFC 2449)
 
 	uint32_t POP3Error;
 	class CNetClient *NetClient;	//here the network layout is defined (TCP or SSL+TCP etc.)
 private:
-	BOOL SearchFromEnd(char *end,int bs,int mode);
-	BOOL SearchFromStart(char *end,int bs,int mode);
+	char *ReadAhead;				//data received behind the end of the last response (start of the next pipelined response)
+	int ReadAheadLen;
 };
 
 enum
@@ -779,10 +779,16 @@ DWORD WINAPI SynchroPOP3(struct CheckParam * WhichTemp)
 		{
 			wchar_t accstatus[512];
 
+			BOOL autoretr = (ActualAccount->Flags & YAMN_ACC_BODY) != 0;
+			HYAMNMAIL SendPtr = NewMails;
+			int InFlight = 0, Depth = MyClient->Pipelining ? POP3_PIPELINEDEPTH : 1;
+
 			for (i = 0, MsgQueuePtr = NewMails; MsgQueuePtr != nullptr; i++)
 			{
-				BOOL autoretr = (ActualAccount->Flags & YAMN_ACC_BODY) != 0;
-				DataRX = MyClient->Top(MsgQueuePtr->Number, autoretr ? 100 : 0);
+				for (; SendPtr != nullptr && InFlight < Depth; SendPtr = SendPtr->Next, InFlight++)	//send next queries while we wait for responses
+					MyClient->SendTop(SendPtr->Number, autoretr ? 100 : 0);
+				DataRX = MyClient->RecvRest(POP3_SEARCHDOT);
+				InFlight--;
 				mir_snwprintf(accstatus, TranslateT("Reading new mail messages (%d%% done)"), 100 * i / msgs);
 				SetAccountStatus(ActualAccount, accstatus);
 
@@ -1198,12 +1204,20 @@ void __cdecl DeleteMailsPOP3(void *param)
 			try
 			{
 				HYAMNMAIL Temp;
+				HYAMNMAIL SendPtr = DeleteMails;
+				int InFlight = 0, Depth = MyClient->Pipelining ? POP3_PIPELINEDEPTH : 1;
 
 				for (i = 0, MsgQueuePtr = DeleteMails; MsgQueuePtr != nullptr; i++)
 				{
 					if (!(MsgQueuePtr->Flags & YAMN_MSG_VIRTUAL))	//of course we can only delete real mails, not virtual
 					{
-						DataRX = MyClient->Dele(MsgQueuePtr->Number);
+						for (; SendPtr != nullptr && InFlight < Depth; SendPtr = SendPtr->Next)	//send next queries while we wait for responses
+							if (!(SendPtr->Flags & YAMN_MSG_VIRTUAL)) {
+								MyClient->SendDele(SendPtr->Number);
+								InFlight++;
+							}
+						DataRX = MyClient->RecvRest(POP3_SEARCHACK);
+						InFlight--;
 						Temp = MsgQueuePtr->Next;
 						if (POP3_FOK == MyClient->AckFlag)			//if server answers that mail was deleted
 						{
@@ -97,7 +97,7 @@ struct IcolibItem : public MZeroedObject
 	HICON           temp_icon;
 	BOOL            temp_reset;
 
-	__inline ~IcolibItem() { clear(); }
+	~IcolibItem();
 	__inline wchar_t* getDescr() const { return TranslateW_LP(description, pPlugin); }
 
 	void clear();
@@ -111,7 +111,7 @@ void SafeDestroyIcon(HICON &icon);
 
 IconSourceItem* GetIconSourceItem(const wchar_t* file, int indx, int cxIcon, int cyIcon);
 
-IcolibItem* IcoLib_FindHIcon(HICON hIcon, bool &big);
+IcolibItem* IcoLib_FindHIcon(HICON hIcon, IconSourceItem* &pSource);
 IcolibItem* IcoLib_FindIcon(const char* pszIconName);
 
 int SkinOptionsInit(WPARAM, LPARAM);
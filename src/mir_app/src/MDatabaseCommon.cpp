@@ -29,11 +29,82 @@ static int stringCompare2(const char *p1, const char *p2)
 	return mir_strcmp(p1, p2);
 }
 
+/////////////////////////////////////////////////////////////////////////////////////////
+// a chain of Bloom filters for server ids: when the last one gets full, a new one twice
+// larger is added, so the false positive rate stays low without rescanning the database
+
+#define EVENTID_BITS_PER_ITEM 10     // ~1% of false positives with 7 hashes
+#define EVENTID_HASHES        7
+#define EVENTID_MIN_CAPACITY  65536
+
+struct CEventIdSlice : public MZeroedObject
+{
+	CEventIdSlice(uint32_t _capacity) :
+		nCapacity(_capacity),
+		nBits(_capacity * EVENTID_BITS_PER_ITEM)
+	{
+		pBits = (uint8_t *)mir_calloc(nBits / 8 + 1);
+	}
+
+	~CEventIdSlice()
+	{
+		mir_free(pBits);
+	}
+
+	uint32_t nCapacity, nItems, nBits;
+	uint8_t *pBits;
+
+	void add(uint32_t h1, uint32_t h2)
+	{
+		for (int i = 0; i < EVENTID_HASHES; i++, h1 += h2) {
+			uint32_t bit = h1 % nBits;
+			pBits[bit / 8] |= 1 << (bit % 8);
+		}
+		nItems++;
+	}
+
+	bool check(uint32_t h1, uint32_t h2) const
+	{
+		for (int i = 0; i < EVENTID_HASHES; i++, h1 += h2) {
+			uint32_t bit = h1 % nBits;
+			if (!(pBits[bit / 8] & (1 << (bit % 8))))
+				return false;
+		}
+		return true;
+	}
+};
+
+struct CEventIdFilter
+{
+	CEventIdFilter() :
+		arSlices(4)
+	{}
+
+	mir_cs csLock;
+	OBJLIST<CEventIdSlice> arSlices;
+};
+
+// 64-bit FNV-1a, its halves are used for double hashing
+static void sttHashEventId(const char *szId, uint32_t &h1, uint32_t &h2)
+{
+	uint64_t hash = 14695981039346656037ULL;
+	for (const uint8_t *p = (const uint8_t *)szId; *p; p++) {
+		hash ^= *p;
+		hash *= 1099511628211ULL;
+	}
+
+	h1 = uint32_t(hash);
+	h2 = uint32_t(hash >> 32) | 1;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////
+
 MDatabaseCommon::MDatabaseCommon() :
 	m_lResidentSettings(50, stringCompare2)
 {
 	m_codePage = Langpack_GetDefaultCodePage();
 	m_cache = new MDatabaseCache(this);
+	m_pEventIdFilter = new CEventIdFilter();
 }
 
 MDatabaseCommon::~MDatabaseCommon()
@@ -43,6 +114,7 @@ MDatabaseCommon::~MDatabaseCommon()
 
 	UnlockName();
 	delete (MDatabaseCache*)m_cache;
+	delete m_pEventIdFilter;
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////
@@ -117,6 +189,63 @@ void MDatabaseCommon::UnlockName()
 	}
 }
 
+/////////////////////////////////////////////////////////////////////////////////////////
+// Server ids filter
+
+void MDatabaseCommon::EventIdFilterInit(uint32_t nExpected)
+{
+	mir_cslock lck(m_pEventIdFilter->csLock);
+
+	auto &arSlices = m_pEventIdFilter->arSlices;
+	arSlices.destroy();
+	arSlices.insert(new CEventIdSlice(max(nExpected * 2, EVENTID_MIN_CAPACITY)));
+}
+
+void MDatabaseCommon::EventIdFilterAdd(const char *szId)
+{
+	if (szId == nullptr)
+		return;
+
+	uint32_t h1, h2;
+	sttHashEventId(szId, h1, h2);
+
+	mir_cslock lck(m_pEventIdFilter->csLock);
+
+	// the filter wasn't initialized by a driver, nothing to do
+	auto &arSlices = m_pEventIdFilter->arSlices;
+	if (arSlices.getCount() == 0)
+		return;
+
+	CEventIdSlice *pSlice = &arSlices[arSlices.getCount() - 1];
+	if (pSlice->nItems >= pSlice->nCapacity) {
+		pSlice = new CEventIdSlice(pSlice->nCapacity * 2);
+		arSlices.insert(pSlice, arSlices.getCount());
+	}
+	pSlice->add(h1, h2);
+}
+
+bool MDatabaseCommon::EventIdFilterCheck(const char *szId)
+{
+	if (szId == nullptr)
+		return false;
+
+	uint32_t h1, h2;
+	sttHashEventId(szId, h1, h2);
+
+	mir_cslock lck(m_pEventIdFilter->csLock);
+
+	// without filter any id might exist
+	auto &arSlices = m_pEventIdFilter->arSlices;
+	if (arSlices.getCount() == 0)
+		return true;
+
+	for (auto &it : arSlices)
+		if (it->check(h1, h2))
+			return true;
+
+	return false;
+}
+
 /////////////////////////////////////////////////////////////////////////////////////////
 // Modules
 
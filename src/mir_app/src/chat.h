@@ -59,6 +59,7 @@ wchar_t*      GetChatLogsFilename(SESSION_INFO *si, time_t tTime);
 char*         Log_CreateRtfHeader();
 char*         Log_CreateRTF(LOGSTREAMDATA *streamData);
 char*         Log_SetStyle(int style);
+void          Log_ResetRtfCache(void);
 
 // chat_manager.cpp
 MODULEINFO*   MM_AddModule(const char *pszModule);
@@ -85,8 +86,9 @@ uint16_t          TM_StringToWord(STATUSINFO *pStatusList, const wchar_t *pszSta
 
 BOOL          UM_RemoveAll(SESSION_INFO *si);
 BOOL          UM_SetStatusEx(SESSION_INFO *si, const wchar_t* pszText, int flags);
-void          UM_SortKeys(SESSION_INFO *si);
-void          UM_SortUser(SESSION_INFO *si);
+void          UM_AddUsers(SESSION_INFO *si, const GCEVENT *pUsers, int nCount, LIST<USERINFO> &arAdded);
+void          UM_Link(SESSION_INFO *si, USERINFO *ui);
+void          UM_Unlink(SESSION_INFO *si, USERINFO *ui);
 
 // clist.c
 MCONTACT      AddRoom(const char *pszModule, const wchar_t *pszRoom, const wchar_t *pszDisplayName, int iType);
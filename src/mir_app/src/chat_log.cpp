@@ -30,6 +30,15 @@ char *pLogIconBmpBits[14];
 #define RTFCACHELINESIZE 128
 static char	CHAT_rtfFontsGlobal[OPTIONS_FONTCOUNT][RTFCACHELINESIZE];
 
+// events' RTF fragments are cached in LOGINFO and rebuilt only when fonts, icons, options,
+// a room name or a language are changed, i.e. when this generation number is increased
+static int g_iRtfGeneration = 1;
+
+void Log_ResetRtfCache(void)
+{
+	g_iRtfGeneration++;
+}
+
 static int EventToIndex(LOGINFO *lin)
 {
 	switch (lin->iType) {
@@ -273,6 +282,66 @@ wchar_t* MakeTimeStamp(wchar_t *pszStamp, time_t time)
 	return szTime;
 }
 
+// builds the cacheable parts of an event: everything before the timestamp and everything after it
+
+static void Log_CreateFragment(LOGSTREAMDATA *streamData, LOGINFO *lin, int iGen)
+{
+	CMStringA buf;
+
+	// set font and color
+	buf.AppendFormat("%s ", Log_SetStyle(0));
+
+	// Insert icon
+	if ((lin->iType & g_Settings->dwIconFlags) || lin->bIsHighlighted && (g_Settings->dwIconFlags & GC_EVENT_HIGHLIGHT)) {
+		int iIndex = (lin->bIsHighlighted && (g_Settings->dwIconFlags & GC_EVENT_HIGHLIGHT)) ? ICON_HIGHLIGHT : EventToIcon(lin);
+		buf.Append("\\f0\\fs14");
+		buf.Append(pLogIconBmpBits[iIndex]);
+	}
+
+	if (g_Settings->bTimeStampEventColour) {
+		LOGFONT &lf = g_chatApi.aFonts[0].lf;
+
+		// colored timestamps
+		if (lin->ptszNick && lin->iType == GC_EVENT_MESSAGE) {
+			int iii = lin->bIsHighlighted ? 16 : (lin->bIsMe ? 2 : 1);
+			buf.AppendFormat("\\f0\\cf%u\\ul0\\highlight0\\b%d\\i%d\\fs%u", iii + 1, lf.lfWeight >= FW_BOLD ? 1 : 0, lf.lfItalic, 2 * abs(lf.lfHeight) * 74 / g_chatApi.logPixelSY);
+		}
+		else {
+			int iii = lin->bIsHighlighted ? 16 : EventToIndex(lin);
+			buf.AppendFormat("\\f0\\cf%u\\ul0\\highlight0\\b%d\\i%d\\fs%u", iii + 1, lf.lfWeight >= FW_BOLD ? 1 : 0, lf.lfItalic, 2 * abs(lf.lfHeight) * 74 / g_chatApi.logPixelSY);
+		}
+	}
+	else buf.AppendFormat("%s ", Log_SetStyle(0));
+
+	if (g_Settings->dwIconFlags)
+		buf.Append("\\tab ");
+
+	// timestamp goes here, it isn't cached because it depends on the previous event
+	int cbHead = buf.GetLength();
+	if (g_Settings->bShowTime)
+		buf.Append("\\tab ");
+
+	// Insert the nick
+	if (lin->ptszNick && lin->iType == GC_EVENT_MESSAGE) {
+		buf.AppendFormat("%s ", Log_SetStyle(lin->bIsMe ? 2 : 1));
+
+		CMStringW tmp((lin->bIsMe) ? g_Settings->pszOutgoingNick : g_Settings->pszIncomingNick);
+		tmp.Replace(L"%n", lin->ptszNick);
+		Log_AppendRTF(streamData, TRUE, buf, tmp);
+		buf.AppendChar(' ');
+	}
+
+	// Insert the message
+	buf.AppendFormat("%s ", Log_SetStyle(lin->bIsHighlighted ? 16 : EventToIndex(lin)));
+	streamData->lin = lin;
+	AddEventToBuffer(buf, streamData);
+
+	mir_free(lin->pszRtf);
+	lin->cbRtfHead = cbHead;
+	lin->iRtfGen = iGen;
+	lin->pszRtf = buf.Detach();
+}
+
 char* Log_CreateRTF(LOGSTREAMDATA *streamData)
 {
 	SESSION_INFO *si = streamData->si;
@@ -286,6 +355,13 @@ char* Log_CreateRTF(LOGSTREAMDATA *streamData)
 	if (header)
 		buf.Append(header);
 
+	// fragments built without formatting differ from the normal ones
+	int iGen = g_iRtfGeneration * 2 + (streamData->bStripFormat ? 1 : 0);
+
+	// the previous timestamp is formatted only when si->LastTime changes
+	wchar_t szOldTimeStamp[100];
+	time_t tOldTimeStamp = 0;
+
 	// ### RTF BODY (one iteration per event that should be streamed in)
 	for (LOGINFO *lin = streamData->lin; lin; lin = lin->prev) {
 		// filter
@@ -293,63 +369,39 @@ char* Log_CreateRTF(LOGSTREAMDATA *streamData)
 			if (si->pDlg->m_bFilterEnabled && (si->pDlg->m_iLogFilterFlags & lin->iType) == 0)
 				continue;
 
-		// create new line, and set font and color
+		// create new line
 		if (lin->next != nullptr)
 			buf.Append("\\par ");
-		buf.AppendFormat("%s ", Log_SetStyle(0));
-
-		// Insert icon
-		if ((lin->iType & g_Settings->dwIconFlags) || lin->bIsHighlighted && (g_Settings->dwIconFlags & GC_EVENT_HIGHLIGHT)) {
-			int iIndex = (lin->bIsHighlighted && (g_Settings->dwIconFlags & GC_EVENT_HIGHLIGHT)) ? ICON_HIGHLIGHT : EventToIcon(lin);
-			buf.Append("\\f0\\fs14");
-			buf.Append(pLogIconBmpBits[iIndex]);
-		}
 
-		if (g_Settings->bTimeStampEventColour) {
-			LOGFONT &lf = g_chatApi.aFonts[0].lf;
+		if (lin->pszRtf == nullptr || lin->iRtfGen != iGen)
+			Log_CreateFragment(streamData, lin, iGen);
+		else
+			streamData->lin = lin;
 
-			// colored timestamps
-			if (lin->ptszNick && lin->iType == GC_EVENT_MESSAGE) {
-				int iii = lin->bIsHighlighted ? 16 : (lin->bIsMe ? 2 : 1);
-				buf.AppendFormat("\\f0\\cf%u\\ul0\\highlight0\\b%d\\i%d\\fs%u", iii + 1, lf.lfWeight >= FW_BOLD ? 1 : 0, lf.lfItalic, 2 * abs(lf.lfHeight) * 74 / g_chatApi.logPixelSY);
-			}
-			else {
-				int iii = lin->bIsHighlighted ? 16 : EventToIndex(lin);
-				buf.AppendFormat("\\f0\\cf%u\\ul0\\highlight0\\b%d\\i%d\\fs%u", iii + 1, lf.lfWeight >= FW_BOLD ? 1 : 0, lf.lfItalic, 2 * abs(lf.lfHeight) * 74 / g_chatApi.logPixelSY);
-			}
-		}
-		else buf.AppendFormat("%s ", Log_SetStyle(0));
-
-		if (g_Settings->dwIconFlags)
-			buf.Append("\\tab ");
+		buf.Append(lin->pszRtf, lin->cbRtfHead);
 
 		//insert timestamp
 		if (g_Settings->bShowTime) {
-			wchar_t szTimeStamp[100], szOldTimeStamp[100];
-
+			wchar_t szTimeStamp[100];
 			wcsncpy_s(szTimeStamp, MakeTimeStamp(g_Settings->pszTimeStamp, lin->time), _TRUNCATE);
-			wcsncpy_s(szOldTimeStamp, MakeTimeStamp(g_Settings->pszTimeStamp, si->LastTime), _TRUNCATE);
-			if (!g_Settings->bShowTimeIfChanged || si->LastTime == 0 || mir_wstrcmp(szTimeStamp, szOldTimeStamp)) {
-				si->LastTime = lin->time;
-				Log_AppendRTF(streamData, true, buf, szTimeStamp);
-			}
-			buf.Append("\\tab ");
-		}
 
-		// Insert the nick
-		if (lin->ptszNick && lin->iType == GC_EVENT_MESSAGE) {
-			buf.AppendFormat("%s ", Log_SetStyle(lin->bIsMe ? 2 : 1));
+			bool bShow = !g_Settings->bShowTimeIfChanged || si->LastTime == 0;
+			if (!bShow) {
+				if (tOldTimeStamp != si->LastTime) {
+					wcsncpy_s(szOldTimeStamp, MakeTimeStamp(g_Settings->pszTimeStamp, si->LastTime), _TRUNCATE);
+					tOldTimeStamp = si->LastTime;
+				}
+				bShow = mir_wstrcmp(szTimeStamp, szOldTimeStamp) != 0;
+			}
 
-			CMStringW tmp((lin->bIsMe) ? g_Settings->pszOutgoingNick : g_Settings->pszIncomingNick);
-			tmp.Replace(L"%n", lin->ptszNick);
-			Log_AppendRTF(streamData, TRUE, buf, tmp);
-			buf.AppendChar(' ');
+			if (bShow) {
+				si->LastTime = tOldTimeStamp = lin->time;
+				wcsncpy_s(szOldTimeStamp, szTimeStamp, _TRUNCATE);
+				Log_AppendRTF(streamData, true, buf, szTimeStamp);
+			}
 		}
 
-		// Insert the message
-		buf.AppendFormat("%s ", Log_SetStyle(lin->bIsHighlighted ? 16 : EventToIndex(lin)));
-		streamData->lin = lin;
-		AddEventToBuffer(buf, streamData);
+		buf.Append(lin->pszRtf + lin->cbRtfHead);
 	}
 
 	// ### RTF END
@@ -411,6 +463,8 @@ char* Log_CreateRtfHeader()
 
 void LoadMsgLogBitmaps(void)
 {
+	Log_ResetRtfCache();
+
 	HBRUSH hBkgBrush = CreateSolidBrush(g_Settings->crLogBackground);
 
 	BITMAPINFOHEADER bih = { 0 };
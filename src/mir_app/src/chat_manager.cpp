@@ -33,9 +33,12 @@ static int CompareKeys(const USERINFO *u1, const USERINFO *u2)
 	return mir_wstrcmp(u1->pszUID, u2->pszUID);
 }
 
+// the nick list must have a strict order, so that a user can be found in it by a binary search
+
 static int CompareUser(const USERINFO *u1, const USERINFO *u2)
 {
-	return g_chatApi.UM_CompareItem(u1, u2);
+	int res = g_chatApi.UM_CompareItem(u1, u2);
+	return (res != 0) ? res : mir_wstrcmp(u1->pszUID, u2->pszUID);
 }
 
 static int compareSessions(const SESSION_INFO *p1, const SESSION_INFO *p2)
@@ -77,13 +80,105 @@ static SESSION_INFO* GetActiveSession(void)
 /////////////////////////////////////////////////////////////////////////////////////////
 // Log manager functions
 //	Necessary to keep track of events in a window log
+//
+// events are allocated one after another in big chunks together with their strings.
+// a chunk is freed when all its events are trimmed, and as the log is always trimmed
+// from the oldest end, a log never takes more than its events + one chunk
+
+#define LOG_CHUNK_SIZE 65536
+
+struct LogChunk
+{
+	size_t cbSize, cbUsed;
+	int    iLive;            // number of events alive in this chunk
+	bool   bSealed;          // nothing will be allocated here anymore
+};
+
+struct LogNode
+{
+	LogChunk *pChunk;
+	LOGINFO lin;
+};
+
+static LogNode* LM_Alloc(SESSION_INFO *si, size_t cbNeed)
+{
+	cbNeed = (cbNeed + 7) & ~7;
+
+	LogChunk *pChunk = (LogChunk *)si->pLogChunk;
+	if (pChunk && pChunk->iLive == 0)
+		pChunk->cbUsed = 0;
+
+	if (pChunk == nullptr || pChunk->cbUsed + cbNeed > pChunk->cbSize) {
+		if (pChunk) {
+			pChunk->bSealed = true;
+			if (pChunk->iLive == 0)
+				mir_free(pChunk);
+		}
+
+		size_t cbSize = max(cbNeed, (size_t)LOG_CHUNK_SIZE);
+		pChunk = (LogChunk *)mir_alloc(sizeof(LogChunk) + cbSize);
+		pChunk->cbSize = cbSize;
+		pChunk->cbUsed = 0;
+		pChunk->iLive = 0;
+		pChunk->bSealed = false;
+		si->pLogChunk = pChunk;
+	}
+
+	LogNode *pNode = (LogNode *)((char *)(pChunk + 1) + pChunk->cbUsed);
+	pChunk->cbUsed += cbNeed;
+	pChunk->iLive++;
+
+	memset(pNode, 0, sizeof(LogNode));
+	pNode->pChunk = pChunk;
+	return pNode;
+}
+
+static void LM_Free(LOGINFO *lin)
+{
+	mir_free(lin->pszRtf);
+
+	LogChunk *pChunk = CONTAINING_RECORD(lin, LogNode, lin)->pChunk;
+	if (--pChunk->iLive == 0 && pChunk->bSealed)
+		mir_free(pChunk);
+}
+
+static void LM_FreeArena(SESSION_INFO *si)
+{
+	// all events are already removed, so the current chunk is empty
+	mir_free(si->pLogChunk);
+	si->pLogChunk = nullptr;
+}
 
-static LOGINFO* LM_AddEvent(LOGINFO **ppLogListStart, LOGINFO **ppLogListEnd)
+static wchar_t* LM_CopyStr(wchar_t *&pDest, const wchar_t *pwszSrc)
 {
-	if (!ppLogListStart || !ppLogListEnd)
+	if (pwszSrc == nullptr)
 		return nullptr;
 
-	LOGINFO *node = (LOGINFO *)mir_calloc(sizeof(LOGINFO));
+	wchar_t *res = pDest;
+	size_t cbLen = mir_wstrlen(pwszSrc) + 1;
+	memcpy(pDest, pwszSrc, cbLen * sizeof(wchar_t));
+	pDest += cbLen;
+	return res;
+}
+
+static size_t LM_StrSize(const wchar_t *pwszSrc)
+{
+	return (pwszSrc == nullptr) ? 0 : (mir_wstrlen(pwszSrc) + 1) * sizeof(wchar_t);
+}
+
+static LOGINFO* LM_AddEvent(SESSION_INFO *si, GCEVENT *gce)
+{
+	size_t cbStrings = LM_StrSize(gce->pszNick.w) + LM_StrSize(gce->pszText.w) + LM_StrSize(gce->pszStatus.w) + LM_StrSize(gce->pszUserInfo.w);
+	LogNode *pNode = LM_Alloc(si, sizeof(LogNode) + cbStrings);
+
+	LOGINFO *node = &pNode->lin;
+	wchar_t *pStrings = (wchar_t *)(pNode + 1);
+	node->ptszNick = LM_CopyStr(pStrings, gce->pszNick.w);
+	node->ptszText = LM_CopyStr(pStrings, gce->pszText.w);
+	node->ptszStatus = LM_CopyStr(pStrings, gce->pszStatus.w);
+	node->ptszUserInfo = LM_CopyStr(pStrings, gce->pszUserInfo.w);
+
+	LOGINFO **ppLogListStart = &si->pLog, **ppLogListEnd = &si->pLogEnd;
 	if (*ppLogListStart == nullptr) { // list is empty
 		*ppLogListStart = node;
 		*ppLogListEnd = node;
@@ -108,11 +203,7 @@ static BOOL LM_TrimLog(LOGINFO **ppLogListStart, LOGINFO **ppLogListEnd, int iCo
 		if (*ppLogListEnd == nullptr)
 			*ppLogListStart = nullptr;
 
-		mir_free(pTemp->ptszNick);
-		mir_free(pTemp->ptszUserInfo);
-		mir_free(pTemp->ptszText);
-		mir_free(pTemp->ptszStatus);
-		mir_free(pTemp);
+		LM_Free(pTemp);
 		pTemp = *ppLogListEnd;
 		iCount--;
 	}
@@ -125,11 +216,7 @@ static BOOL LM_RemoveAll(LOGINFO **ppLogListStart, LOGINFO **ppLogListEnd)
 {
 	while (*ppLogListStart != nullptr) {
 		LOGINFO *pLast = ppLogListStart[0]->next;
-		mir_free(ppLogListStart[0]->ptszText);
-		mir_free(ppLogListStart[0]->ptszNick);
-		mir_free(ppLogListStart[0]->ptszStatus);
-		mir_free(ppLogListStart[0]->ptszUserInfo);
-		mir_free(*ppLogListStart);
+		LM_Free(*ppLogListStart);
 		*ppLogListStart = pLast;
 	}
 	*ppLogListStart = nullptr;
@@ -209,6 +296,7 @@ static void SM_FreeSession(SESSION_INFO *si, bool bRemoveContact = false)
 	UM_RemoveAll(si);
 	g_chatApi.TM_RemoveAll(&si->pStatuses);
 	g_chatApi.LM_RemoveAll(&si->pLog, &si->pLogEnd);
+	LM_FreeArena(si);
 
 	si->iStatusCount = 0;
 
@@ -299,15 +387,10 @@ BOOL SM_AddEvent(const wchar_t *pszID, const char *pszModule, GCEVENT *gce, bool
 	if (si == nullptr)
 		return TRUE;
 
-	LOGINFO *li = LM_AddEvent(&si->pLog, &si->pLogEnd);
+	LOGINFO *li = LM_AddEvent(si, gce);
 	si->iEventCount++;
 
 	li->iType = gce->iType;
-	li->ptszNick = mir_wstrdup(gce->pszNick.w);
-	li->ptszText = mir_wstrdup(gce->pszText.w);
-	li->ptszStatus = mir_wstrdup(gce->pszStatus.w);
-	li->ptszUserInfo = mir_wstrdup(gce->pszUserInfo.w);
-
 	li->bIsMe = gce->bIsMe;
 	li->time = gce->time;
 	li->bIsHighlighted = bIsHighlighted;
@@ -362,9 +445,11 @@ BOOL SM_GiveStatus(const wchar_t *pszID, const char *pszModule, const wchar_t *p
 	if (si == nullptr)
 		return FALSE;
 	
-	USERINFO *ui = g_chatApi.UM_GiveStatus(si, pszUID, TM_StringToWord(si->pStatuses, pszStatus));
+	USERINFO *ui = UM_FindUser(si, pszUID);
 	if (ui) {
-		UM_SortUser(si);
+		UM_Unlink(si, ui);
+		g_chatApi.UM_GiveStatus(si, pszUID, TM_StringToWord(si->pStatuses, pszStatus));
+		UM_Link(si, ui);
 		if (si->pDlg)
 			si->pDlg->UpdateNickList();
 	}
@@ -377,9 +462,11 @@ BOOL SM_SetContactStatus(const wchar_t *pszID, const char *pszModule, const wcha
 	if (si == nullptr)
 		return FALSE;
 
-	USERINFO *ui = g_chatApi.UM_SetContactStatus(si, pszUID, wStatus);
+	USERINFO *ui = UM_FindUser(si, pszUID);
 	if (ui) {
-		UM_SortUser(si);
+		UM_Unlink(si, ui);
+		g_chatApi.UM_SetContactStatus(si, pszUID, wStatus);
+		UM_Link(si, ui);
 		if (si->pDlg)
 			si->pDlg->UpdateNickList();
 	}
@@ -392,9 +479,11 @@ BOOL SM_TakeStatus(const wchar_t *pszID, const char *pszModule, const wchar_t *p
 	if (si == nullptr)
 		return FALSE;
 
-	USERINFO *ui = g_chatApi.UM_TakeStatus(si, pszUID, TM_StringToWord(si->pStatuses, pszStatus));
+	USERINFO *ui = UM_FindUser(si, pszUID);
 	if (ui) {
-		UM_SortUser(si);
+		UM_Unlink(si, ui);
+		g_chatApi.UM_TakeStatus(si, pszUID, TM_StringToWord(si->pStatuses, pszStatus));
+		UM_Link(si, ui);
 		if (si->pDlg)
 			si->pDlg->UpdateNickList();
 	}
@@ -447,8 +536,9 @@ BOOL SM_ChangeNick(const wchar_t *pszID, const char *pszModule, GCEVENT *gce)
 		if ((!pszID || !mir_wstrcmpi(si->ptszID, pszID)) && !mir_strcmpi(si->pszModule, pszModule)) {
 			USERINFO *ui = UM_FindUser(si, gce->pszUID.w);
 			if (ui) {
+				UM_Unlink(si, ui);
 				replaceStrW(ui->pszNick, gce->pszText.w);
-				UM_SortUser(si);
+				UM_Link(si, ui);
 				if (si->pDlg)
 					si->pDlg->UpdateNickList();
 				if (g_chatApi.OnChangeNick)
@@ -692,27 +782,25 @@ static USERINFO* UM_FindUser(SESSION_INFO *si, const wchar_t *pszUID)
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////
+// the nick list is sorted wholesale only by UM_AddUsers(): otherwise a user is taken out
+// of it before its nick or status is changed and put back afterwards, both by a binary search
 
-static int compareKeysStub(const void *p1, const void *p2)
-{
-	return CompareKeys(*(USERINFO**)p1, *(USERINFO**)p2);
-}
-
-void UM_SortKeys(SESSION_INFO *si)
+void UM_Unlink(SESSION_INFO *si, USERINFO *ui)
 {
-	qsort(si->arKeys.getArray(), si->arKeys.getCount(), sizeof(void*), compareKeysStub);
-}
-
-/////////////////////////////////////////////////////////////////////////////////////////
-
-static int compareStub(const void *p1, const void *p2)
-{
-	return CompareUser(*(USERINFO**)p1, *(USERINFO**)p2);
+	auto &arUsers = si->getUserList();
+	int idx = arUsers.getIndex(ui);
+
+	// the user's key might have been changed behind our back, then the binary search misses it
+	// or finds its namesake. leaving it in place would make the next UM_Link add it twice
+	if (idx == -1 || arUsers[idx] != ui)
+		idx = arUsers.indexOf(ui);
+	if (idx != -1)
+		arUsers.removeItem(arUsers.getArray() + idx);
 }
 
-void UM_SortUser(SESSION_INFO *si)
+void UM_Link(SESSION_INFO *si, USERINFO *ui)
 {
-	qsort(si->arUsers.getArray(), si->arUsers.getCount(), sizeof(void*), compareStub);
+	si->getUserList().insert(ui);
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////
@@ -727,30 +815,102 @@ USERINFO* UM_AddUser(SESSION_INFO *si, const wchar_t *pszUID, const wchar_t *psz
 		pUser = new USERINFO();
 		replaceStrW(pUser->pszUID, pszUID);
 		si->getKeyList().insert(pUser);
-		si->getUserList().insert(pUser);
 	}
+	else UM_Unlink(si, pUser);
 	
 	replaceStrW(pUser->pszNick, pszNick);
 	pUser->Status = wStatus;
+	UM_Link(si, pUser);
 	return pUser;
 }
 
-static int UM_CompareItem(const USERINFO *u1, const USERINFO *u2)
+// bulk variant of UM_AddUser for the initial nick list: existing users are updated in place,
+// new ones are appended to the end of both lists, which are then sorted once
+
+static int __cdecl sttCompareKeys(const void *p1, const void *p2)
 {
-	uint16_t dw1 = u1->Status;
-	uint16_t dw2 = u2->Status;
+	return CompareKeys(*(USERINFO**)p1, *(USERINFO**)p2);
+}
 
-	for (int i = 0; i < 8; i++) {
-		if ((dw1 & 1) && !(dw2 & 1))
-			return -1;
-		if ((dw2 & 1) && !(dw1 & 1))
-			return 1;
-		if ((dw1 & 1) && (dw2 & 1))
-			break;
+static int __cdecl sttCompareUsers(const void *p1, const void *p2)
+{
+	return CompareUser(*(USERINFO**)p1, *(USERINFO**)p2);
+}
+
+void UM_AddUsers(SESSION_INFO *si, const GCEVENT *pUsers, int nCount, LIST<USERINFO> &arAdded)
+{
+	auto &arKeys = si->getKeyList();
+	auto &arUsers = si->getUserList();
 
-		dw1 = dw1 >> 1;
-		dw2 = dw2 >> 1;
+	// look up existing users before anything is appended, while the key list is still sorted
+	USERINFO **pExisting = (USERINFO**)mir_calloc(sizeof(USERINFO*) * nCount);
+	for (int i = 0; i < nCount; i++)
+		pExisting[i] = UM_FindUser(si, pUsers[i].pszUID.w);
+
+	// only an existing user might be reported twice, new ones are deduplicated below
+	LIST<USERINFO> arSeen(10, PtrKeySortT);
+
+	for (int i = 0; i < nCount; i++) {
+		auto &gce = pUsers[i];
+		if (gce.pszNick.w == nullptr)
+			continue;
+
+		USERINFO *pUser = pExisting[i];
+		if (pUser == nullptr) {
+			pUser = new USERINFO();
+			replaceStrW(pUser->pszUID, gce.pszUID.w);
+			arKeys.insert(pUser, arKeys.getCount());
+			arUsers.insert(pUser, arUsers.getCount());
+		}
+
+		replaceStrW(pUser->pszNick, gce.pszNick.w);
+		pUser->Status = TM_StringToWord(si->pStatuses, gce.pszStatus.w) | si->pStatuses->iStatus;
+		if (gce.dwItemData)
+			pUser->ContactStatus = (uint16_t)gce.dwItemData;
+		if (gce.bIsMe)
+			si->pMe = pUser;
+
+		if (pExisting[i] != nullptr) {
+			if (arSeen.find(pUser))
+				continue;
+			arSeen.insert(pUser);
+		}
+		arAdded.insert(pUser);
+	}
+	mir_free(pExisting);
+
+	qsort(arKeys.getArray(), arKeys.getCount(), sizeof(void*), sttCompareKeys);
+
+	// the same new user listed twice leaves a duplicate key, drop it
+	for (int i = arKeys.getCount() - 1; i > 0; i--) {
+		USERINFO *pUser = arKeys[i];
+		if (CompareKeys(arKeys[i - 1], pUser))
+			continue;
+
+		arKeys.remove(i);
+		for (int j = arAdded.getCount() - 1; j >= 0; j--)
+			if (arAdded[j] == pUser)
+				arAdded.remove(j);
+		if (si->pMe == pUser)
+			si->pMe = arKeys[i - 1];
+
+		mir_free(pUser->pszNick);
+		mir_free(pUser->pszUID);
+		arUsers.remove(arUsers.indexOf(pUser));
 	}
+
+	qsort(arUsers.getArray(), arUsers.getCount(), sizeof(void*), sttCompareUsers);
+}
+
+static int UM_CompareItem(const USERINFO *u1, const USERINFO *u2)
+{
+	// the lowest of eight status bits is the most important one
+	int dw1 = u1->Status & 0xFF, dw2 = u2->Status & 0xFF;
+	dw1 &= -dw1;
+	dw2 &= -dw2;
+	if (dw1 != dw2)
+		return (dw1 != 0 && (dw2 == 0 || dw1 < dw2)) ? -1 : 1;
+
 	return mir_wstrcmpi(u1->pszNick, u2->pszNick);
 }
 
@@ -854,15 +1014,9 @@ static BOOL UM_RemoveUser(SESSION_INFO *si, const wchar_t *pszUID)
 	if (arKeys.remove(pUser) == -1)
 		DebugBreak();
 
-	auto &arUsers = si->getUserList();
-	for (auto &ui : arUsers) {
-		if (!mir_wstrcmpi(ui->pszUID, pszUID)) {
-			mir_free(ui->pszNick);
-			mir_free(ui->pszUID);
-			arUsers.removeItem(&ui);
-			break;
-		}
-	}
+	UM_Unlink(si, pUser);
+	mir_free(pUser->pszNick);
+	mir_free(pUser->pszUID);
 	return TRUE;
 }
 
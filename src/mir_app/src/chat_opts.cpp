@@ -204,6 +204,8 @@ static void InitSetting(wchar_t** ppPointer, char* pszSetting, wchar_t* pszDefau
 
 void LoadGlobalSettings(void)
 {
+	Log_ResetRtfCache();
+
 	g_Settings->LogIconSize = 10;
 	g_Settings->bLogLimitNames = db_get_b(0, CHAT_MODULE, "LogLimitNames", 1) != 0;
 	g_Settings->bShowTime = db_get_b(0, CHAT_MODULE, "ShowTimeStamp", 1) != 0;
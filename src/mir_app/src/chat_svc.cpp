@@ -115,6 +115,17 @@ static int PreShutdown(WPARAM, LPARAM)
 	return 0;
 }
 
+static int LangpackChanged(WPARAM, LPARAM)
+{
+	Log_ResetRtfCache();
+
+	for (auto &si : g_arSessions)
+		if (si->pDlg)
+			si->pDlg->RedrawLog();
+
+	return 0;
+}
+
 static int SmileyOptionsChanged(WPARAM, LPARAM)
 {
 	for (auto &si : g_arSessions)
@@ -368,7 +379,8 @@ static void AddUser(GCEVENT *gce)
 	if (si == nullptr)
 		return;
 
-	uint16_t status = TM_StringToWord(si->pStatuses, gce->pszStatus.w);
+	// the final status is passed at once, otherwise the user would be placed wrong in the nick list
+	uint16_t status = TM_StringToWord(si->pStatuses, gce->pszStatus.w) | si->pStatuses->iStatus;
 
 	USERINFO *ui = g_chatApi.UM_AddUser(si, gce->pszUID.w, gce->pszNick.w, status);
 	if (ui == nullptr)
@@ -379,8 +391,6 @@ static void AddUser(GCEVENT *gce)
 
 	if (gce->bIsMe)
 		si->pMe = ui;
-	ui->Status = status;
-	ui->Status |= si->pStatuses->iStatus;
 
 	if (si->pDlg)
 		si->pDlg->UpdateNickList();
@@ -588,6 +598,65 @@ EXTERN_C MIR_APP_DLL(int) Chat_Event(GCEVENT *gce)
 	return CallFunctionSync(sttEventStub, gce);
 }
 
+/////////////////////////////////////////////////////////////////////////////////////////
+// adds many users at once, the nick list is sorted only once
+
+struct ChatAddUsersParam
+{
+	const char *szModule;
+	const wchar_t *wszId;
+	const GCEVENT *pUsers;
+	int nCount;
+};
+
+static INT_PTR CALLBACK sttAddUsersStub(void *_param)
+{
+	auto *p = (ChatAddUsersParam *)_param;
+
+	SESSION_INFO *si = SM_FindSession(p->wszId, p->szModule);
+	if (si == nullptr)
+		return GC_EVENT_ERROR;
+
+	// every user still passes through the event hook as a separate silent join
+	GCEVENT *pUsers = (GCEVENT *)mir_alloc(sizeof(GCEVENT) * p->nCount);
+	int nUsers = 0;
+	for (int i = 0; i < p->nCount; i++) {
+		GCEVENT &gce = pUsers[nUsers] = p->pUsers[i];
+		gce.pszModule = p->szModule;
+		gce.pszID.w = p->wszId;
+		gce.iType = GC_EVENT_JOIN;
+		gce.time = 0;
+		if (!NotifyEventHooks(hHookEvent, 0, LPARAM(&gce)))
+			nUsers++;
+	}
+
+	LIST<USERINFO> arAdded(nUsers + 1);
+	UM_AddUsers(si, pUsers, nUsers, arAdded);
+	mir_free(pUsers);
+
+	for (auto &ui : arAdded)
+		if (g_chatApi.OnAddUser)
+			g_chatApi.OnAddUser(si, ui);
+
+	if (si->pDlg)
+		si->pDlg->UpdateNickList();
+
+	for (auto &ui : arAdded)
+		if (g_chatApi.OnNewUser)
+			g_chatApi.OnNewUser(si, ui);
+
+	return 0;
+}
+
+EXTERN_C MIR_APP_DLL(int) Chat_AddUsers(const char *szModule, const wchar_t *wszId, const GCEVENT *pUsers, int nCount)
+{
+	if (pUsers == nullptr || nCount <= 0)
+		return GC_EVENT_ERROR;
+
+	ChatAddUsersParam param = { szModule, wszId, pUsers, nCount };
+	return CallFunctionSync(sttAddUsersStub, &param);
+}
+
 /////////////////////////////////////////////////////////////////////////////////////////
 // chat control functions
 
@@ -621,6 +690,7 @@ MIR_APP_DLL(int) Chat_ChangeSessionName(const char *szModule, const wchar_t *wsz
 
 		replaceStrW(si->ptszName, wszNewName);
 		db_set_ws(si->hContact, szModule, "Nick", wszNewName);
+		Log_ResetRtfCache();
 		if (si->pDlg)
 			si->pDlg->UpdateTitle();
 	}
@@ -639,8 +709,12 @@ MIR_APP_DLL(int) Chat_ChangeUserId(const char *szModule, const wchar_t *wszId, c
 
 		USERINFO *ui = g_chatApi.UM_FindUser(si, wszOldId);
 		if (ui) {
+			auto &arKeys = si->getKeyList();
+			arKeys.remove(ui);
+			UM_Unlink(si, ui);
 			replaceStrW(ui->pszUID, wszNewId);
-			UM_SortKeys(si);
+			arKeys.insert(ui);
+			UM_Link(si, ui);
 		}
 		if (wszId)
 			break;
@@ -894,6 +968,7 @@ int LoadChatModule(void)
 	HookEvent(ME_SYSTEM_PRESHUTDOWN, PreShutdown);
 	HookEvent(ME_SKIN_ICONSCHANGED, IconsChanged);
 	HookEvent(ME_FONT_RELOAD, FontsChanged);
+	HookEvent(ME_LANGPACK_CHANGED, LangpackChanged);
 
 	g_hWindowList = WindowList_Create();
 	hHookEvent = CreateHookableEvent(ME_GC_HOOK_EVENT);
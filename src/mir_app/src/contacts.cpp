@@ -310,6 +310,207 @@ MIR_APP_DLL(void) Contact_RemoveFromList(MCONTACT hContact)
 	db_set_b(hContact, "CList", "NotOnList", 1);
 }
 
+/////////////////////////////////////////////////////////////////////////////////////////
+// index of contacts by the value of their unique id setting
+// built for an account on the first lookup, then kept current via database events.
+// numeric ids are stored as decimal strings, text ones - in utf8
+
+struct UniqueIdEntry
+{
+	char *pszValue;
+	MCONTACT hContact;
+
+	~UniqueIdEntry()
+	{
+		mir_free(pszValue);
+	}
+};
+
+static int CompareIdEntries(const UniqueIdEntry *p1, const UniqueIdEntry *p2)
+{
+	if (int ret = mir_strcmp(p1->pszValue, p2->pszValue))
+		return ret;
+
+	return (p1->hContact < p2->hContact) ? -1 : (p1->hContact > p2->hContact) ? 1 : 0;
+}
+
+static int CompareIdContacts(const UniqueIdEntry *p1, const UniqueIdEntry *p2)
+{
+	return (p1->hContact < p2->hContact) ? -1 : (p1->hContact > p2->hContact) ? 1 : 0;
+}
+
+struct UniqueIdIndex
+{
+	UniqueIdIndex(const char *szModule, const char *szSetting) :
+		m_szModule(mir_strdup(szModule)),
+		m_szSetting(mir_strdup(szSetting)),
+		m_byValue(50, CompareIdEntries),
+		m_byContact(50, CompareIdContacts)
+	{}
+
+	// search key for g_arIdIndexes
+	UniqueIdIndex(const char *szModule) :
+		UniqueIdIndex(szModule, nullptr)
+	{}
+
+	ptrA m_szModule, m_szSetting;
+	OBJLIST<UniqueIdEntry> m_byValue;
+	LIST<UniqueIdEntry> m_byContact;
+
+	void add(MCONTACT hContact, const DBVARIANT &dbv)
+	{
+		char szNum[20], *pszValue;
+		switch (dbv.type) {
+		case DBVT_BYTE:   pszValue = mir_strdup(_ultoa(dbv.bVal, szNum, 10)); break;
+		case DBVT_WORD:   pszValue = mir_strdup(_ultoa(dbv.wVal, szNum, 10)); break;
+		case DBVT_DWORD:  pszValue = mir_strdup(_ultoa(dbv.dVal, szNum, 10)); break;
+		case DBVT_ASCIIZ:
+		case DBVT_UTF8:   pszValue = mir_strdup(dbv.pszVal); break;
+		case DBVT_WCHAR:  pszValue = mir_utf8encodeW(dbv.pwszVal); break;
+		default:
+			return;
+		}
+
+		if (pszValue == nullptr)
+			return;
+
+		UniqueIdEntry *p = new UniqueIdEntry();
+		p->pszValue = pszValue;
+		p->hContact = hContact;
+		m_byValue.insert(p);
+		m_byContact.insert(p);
+	}
+
+	void remove(MCONTACT hContact)
+	{
+		UniqueIdEntry tmp = { nullptr, hContact };
+		UniqueIdEntry *p = m_byContact.find(&tmp);
+		if (p == nullptr)
+			return;
+
+		m_byContact.remove(p);
+		m_byValue.remove(p);
+	}
+
+	MCONTACT find(const char *pszValue) const
+	{
+		UniqueIdEntry tmp = { (char*)pszValue, 0 };
+		int idx;
+		List_GetIndex((SortedList*)&m_byValue, &tmp, &idx);
+		tmp.pszValue = nullptr;
+
+		// the same id might belong to several contacts, take the first one of this account
+		for (; idx < m_byValue.getCount(); idx++) {
+			UniqueIdEntry &p = m_byValue[idx];
+			if (mir_strcmp(p.pszValue, pszValue))
+				break;
+
+			if (!mir_strcmp(Proto_GetBaseAccountName(p.hContact), m_szModule))
+				return p.hContact;
+		}
+		return 0;
+	}
+};
+
+static int CompareIndexes(const UniqueIdIndex *p1, const UniqueIdIndex *p2)
+{
+	return mir_strcmp(p1->m_szModule, p2->m_szModule);
+}
+
+static OBJLIST<UniqueIdIndex> g_arIdIndexes(5, CompareIndexes);
+static mir_cs csIdIndexes;
+
+// these two must be called inside csIdIndexes
+static UniqueIdIndex* FindIdIndex(const char *szProto)
+{
+	UniqueIdIndex tmp(szProto);
+	return g_arIdIndexes.find(&tmp);
+}
+
+static UniqueIdIndex* GetIdIndex(const char *szProto)
+{
+	UniqueIdIndex *pIndex = FindIdIndex(szProto);
+	if (pIndex != nullptr)
+		return pIndex;
+
+	const char *szSetting = Proto_GetUniqueId(szProto);
+	if (szSetting == nullptr)
+		return nullptr;
+
+	pIndex = new UniqueIdIndex(szProto, szSetting);
+	for (auto &hContact : Contacts(szProto)) {
+		DBVARIANT dbv;
+		if (!db_get(hContact, szProto, szSetting, &dbv)) {
+			pIndex->add(hContact, dbv);
+			db_free(&dbv);
+		}
+	}
+
+	g_arIdIndexes.insert(pIndex);
+	return pIndex;
+}
+
+MIR_APP_DLL(MCONTACT) Contact_FindByUniqueId(const char *szProto, const char *pszUniqueId)
+{
+	if (szProto == nullptr || pszUniqueId == nullptr)
+		return 0;
+
+	mir_cslock lck(csIdIndexes);
+	UniqueIdIndex *pIndex = GetIdIndex(szProto);
+	return (pIndex == nullptr) ? 0 : pIndex->find(pszUniqueId);
+}
+
+MIR_APP_DLL(MCONTACT) Contact_FindByUniqueIdInt(const char *szProto, uint32_t dwUniqueId)
+{
+	char szNum[20];
+	return Contact_FindByUniqueId(szProto, _ultoa(dwUniqueId, szNum, 10));
+}
+
+static int OnIdSettingChanged(WPARAM hContact, LPARAM lParam)
+{
+	if (hContact == 0)
+		return 0;
+
+	auto *cws = (DBCONTACTWRITESETTING*)lParam;
+
+	// the hook is called for every setting, so most of them are filtered out without locking
+	const char *szUniqueId = Proto_GetUniqueId(cws->szModule);
+	if (szUniqueId == nullptr || mir_strcmp(szUniqueId, cws->szSetting))
+		return 0;
+
+	mir_cslock lck(csIdIndexes);
+	UniqueIdIndex *pIndex = FindIdIndex(cws->szModule);
+	if (pIndex == nullptr || mir_strcmp(pIndex->m_szSetting, cws->szSetting))
+		return 0;
+
+	pIndex->remove(hContact);
+	pIndex->add(hContact, cws->value); // DBVT_DELETED is ignored
+	return 0;
+}
+
+static int OnIdContactDeleted(WPARAM hContact, LPARAM)
+{
+	mir_cslock lck(csIdIndexes);
+	for (auto &it : g_arIdIndexes)
+		it->remove(hContact);
+	return 0;
+}
+
+static int OnIdAccListChanged(WPARAM eventCode, LPARAM lParam)
+{
+	if (eventCode != PRAC_REMOVED && eventCode != PRAC_CHANGED && eventCode != PRAC_UPGRADED)
+		return 0;
+
+	auto *pa = (PROTOACCOUNT*)lParam;
+
+	// the index will be rebuilt on the next lookup
+	mir_cslock lck(csIdIndexes);
+	UniqueIdIndex *pIndex = FindIdIndex(pa->szModuleName);
+	if (pIndex != nullptr)
+		g_arIdIndexes.remove(pIndex);
+	return 0;
+}
+
 /////////////////////////////////////////////////////////////////////////////////////////
 // Options dialog
 
@@ -389,5 +590,9 @@ int LoadContactsModule(void)
 	}
 
 	HookEvent(ME_OPT_INITIALISE, ContactOptInit);
+
+	HookEvent(ME_DB_CONTACT_SETTINGCHANGED, OnIdSettingChanged);
+	HookEvent(ME_DB_CONTACT_DELETED, OnIdContactDeleted);
+	HookEvent(ME_PROTO_ACCLISTCHANGED, OnIdAccListChanged);
 	return 0;
 }
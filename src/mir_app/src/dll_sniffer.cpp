@@ -25,30 +25,28 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
 #include "stdafx.h"
 #include "plugins.h"
 
-uint32_t dwVersion = 0;
+static void ProcessResourcesDirectory(PIMAGE_RESOURCE_DIRECTORY pIRD, uint8_t *pBase, uint32_t dwType, uint32_t &dwVersion);
 
-static void ProcessResourcesDirectory(PIMAGE_RESOURCE_DIRECTORY pIRD, uint8_t *pBase, uint32_t dwType);
-
-static void ProcessResourceEntry(PIMAGE_RESOURCE_DIRECTORY_ENTRY pIRDE, uint8_t *pBase, uint32_t dwType)
+static void ProcessResourceEntry(PIMAGE_RESOURCE_DIRECTORY_ENTRY pIRDE, uint8_t *pBase, uint32_t dwType, uint32_t &dwVersion)
 {
 	if (pIRDE->DataIsDirectory)
-		ProcessResourcesDirectory(PIMAGE_RESOURCE_DIRECTORY(pBase + pIRDE->OffsetToDirectory), pBase, dwType == 0 ? pIRDE->Name : dwType);
+		ProcessResourcesDirectory(PIMAGE_RESOURCE_DIRECTORY(pBase + pIRDE->OffsetToDirectory), pBase, dwType == 0 ? pIRDE->Name : dwType, dwVersion);
 	else if (dwType == 16) {
 		PIMAGE_RESOURCE_DATA_ENTRY pItem = PIMAGE_RESOURCE_DATA_ENTRY(pBase + pIRDE->OffsetToData);
 		dwVersion = pItem->OffsetToData;
 	}
 }
 
-static void ProcessResourcesDirectory(PIMAGE_RESOURCE_DIRECTORY pIRD, uint8_t *pBase, uint32_t dwType)
+static void ProcessResourcesDirectory(PIMAGE_RESOURCE_DIRECTORY pIRD, uint8_t *pBase, uint32_t dwType, uint32_t &dwVersion)
 {
 	UINT i;
 
 	PIMAGE_RESOURCE_DIRECTORY_ENTRY pIRDE = PIMAGE_RESOURCE_DIRECTORY_ENTRY(pIRD + 1);
 	for (i = 0; i < pIRD->NumberOfNamedEntries; i++, pIRDE++)
-		ProcessResourceEntry(pIRDE, pBase, dwType);
+		ProcessResourceEntry(pIRDE, pBase, dwType, dwVersion);
 
 	for (i = 0; i < pIRD->NumberOfIdEntries; i++, pIRDE++)
-		ProcessResourceEntry(pIRDE, pBase, dwType);
+		ProcessResourceEntry(pIRDE, pBase, dwType, dwVersion);
 }
 
 __forceinline bool Contains(PIMAGE_SECTION_HEADER pISH, uint32_t address, uint32_t size = 0)
@@ -172,11 +170,12 @@ MUUID* GetPluginInterfaces(const wchar_t *ptszFileName, bool &bIsPlugin)
 
 				// process resource version
 				if (resSize > 0 && Contains(pISH, resAddr, resSize)) {
-					dwVersion = 0;
+					// local, because plugins are sniffed in parallel
+					uint32_t dwVersion = 0;
 
 					uint8_t *pSecStart = ptr + pISH->PointerToRawData - pISH->VirtualAddress;
 					IMAGE_RESOURCE_DIRECTORY *pIRD = (IMAGE_RESOURCE_DIRECTORY*)&pSecStart[resAddr];
-					ProcessResourcesDirectory(pIRD, &pSecStart[resAddr], 0);
+					ProcessResourcesDirectory(pIRD, &pSecStart[resAddr], 0, dwVersion);
 
 					// patch version
 					if (dwVersion) {
@@ -208,3 +207,288 @@ MUUID* GetPluginInterfaces(const wchar_t *ptszFileName, bool &bIsPlugin)
 	bIsPlugin = nChecks == 2;
 	return pResult;
 }
+
+/////////////////////////////////////////////////////////////////////////////////////////
+// plugins' metadata cache
+// keeps the sniffer's results between starts, a record remains valid while the dll's
+// size & last write time remain the same. stored as Plugins\PluginCache.dat
+
+#define PLUGIN_CACHE_SIGNATURE 0x4D435050 // PPCM
+#define PLUGIN_CACHE_VERSION   1
+
+#pragma pack(push, 1)
+struct PluginCacheHeader
+{
+	uint32_t dwSignature, dwVersion;
+	uint32_t dwCoreVersion[4];     // sniffer's checks depend on the core version
+	uint32_t dwCount;
+};
+
+struct PluginCacheRecord
+{
+	uint64_t cbSize;
+	FILETIME ftWrite;
+	uint16_t cchPath;              // followed by wchar_t[cchPath]
+	uint16_t nIds;                 // followed by MUUID[nIds], 0 means no interfaces
+	uint8_t  bIsPlugin;
+};
+#pragma pack(pop)
+
+struct PluginCacheEntry
+{
+	wchar_t *pwszPath = nullptr;
+	uint64_t cbSize = 0;
+	FILETIME ftWrite = {};
+	MUUID *pIds = nullptr;
+	int nIds = 0;
+	bool bIsPlugin = false;
+
+	~PluginCacheEntry()
+	{
+		mir_free(pwszPath);
+		mir_free(pIds);
+	}
+
+	MUUID* copyIds() const
+	{
+		if (pIds == nullptr)
+			return nullptr;
+
+		MUUID *pRes = (MUUID*)mir_alloc(sizeof(MUUID) * nIds);
+		if (pRes)
+			memcpy(pRes, pIds, sizeof(MUUID) * nIds);
+		return pRes;
+	}
+};
+
+static int ComparePluginCache(const PluginCacheEntry *p1, const PluginCacheEntry *p2)
+{
+	return mir_wstrcmpi(p1->pwszPath, p2->pwszPath);
+}
+
+static OBJLIST<PluginCacheEntry> g_arPluginCache(50, ComparePluginCache);
+static mir_cs csPluginCache;
+static bool g_bPluginCacheDirty;
+
+static void GetPluginCachePath(wchar_t *pwszPath)
+{
+	PathToAbsoluteW(L"Plugins\\PluginCache.dat", pwszPath);
+}
+
+static bool GetPluginStamp(const wchar_t *pwszPath, uint64_t &cbSize, FILETIME &ftWrite)
+{
+	WIN32_FILE_ATTRIBUTE_DATA fad;
+	if (!GetFileAttributesExW(pwszPath, GetFileExInfoStandard, &fad))
+		return false;
+
+	cbSize = (uint64_t(fad.nFileSizeHigh) << 32) | fad.nFileSizeLow;
+	ftWrite = fad.ftLastWriteTime;
+	return true;
+}
+
+// returns a valid cache entry or nullptr, must be called inside csPluginCache
+static PluginCacheEntry* FindPluginCache(const wchar_t *pwszPath, uint64_t cbSize, const FILETIME &ftWrite)
+{
+	PluginCacheEntry *p = g_arPluginCache.find((PluginCacheEntry*)&pwszPath);
+	if (p == nullptr || p->cbSize != cbSize || CompareFileTime(&p->ftWrite, &ftWrite))
+		return nullptr;
+
+	return p;
+}
+
+MUUID* GetCachedPluginInterfaces(const wchar_t *pwszPath, bool &bIsPlugin)
+{
+	bIsPlugin = false;
+
+	uint64_t cbSize;
+	FILETIME ftWrite;
+	if (!GetPluginStamp(pwszPath, cbSize, ftWrite))
+		return nullptr;
+
+	{
+		mir_cslock lck(csPluginCache);
+		if (auto *p = FindPluginCache(pwszPath, cbSize, ftWrite)) {
+			bIsPlugin = p->bIsPlugin;
+			return p->copyIds();
+		}
+	}
+
+	MUUID *pIds = GetPluginInterfaces(pwszPath, bIsPlugin);
+
+	PluginCacheEntry *pNew = new PluginCacheEntry();
+	pNew->pwszPath = mir_wstrdup(pwszPath);
+	pNew->cbSize = cbSize;
+	pNew->ftWrite = ftWrite;
+	pNew->bIsPlugin = bIsPlugin;
+	if (pIds) {
+		pNew->nIds = 1; // one for MIID_LAST
+		for (MUUID *p = pIds; *p != miid_last; p++)
+			pNew->nIds++;
+	}
+	pNew->pIds = pNew->copyIds();
+
+	mir_cslock lck(csPluginCache);
+	int idx = g_arPluginCache.getIndex(pNew);
+	if (idx != -1)
+		g_arPluginCache.remove(idx);
+	g_arPluginCache.insert(pNew);
+	g_bPluginCacheDirty = true;
+	return pIds;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////
+// sniffs the dlls missing in the cache in parallel, so that the following calls of
+// GetCachedPluginInterfaces take the results from the cache
+
+static void __cdecl SniffPluginTask(void *param)
+{
+	bool bIsPlugin;
+	mir_free(GetCachedPluginInterfaces((const wchar_t*)param, bIsPlugin));
+}
+
+void PrefetchPluginInterfaces(const LIST<wchar_t> &arPaths)
+{
+	LIST<void> arTasks(10);
+
+	for (auto &it : arPaths) {
+		uint64_t cbSize;
+		FILETIME ftWrite;
+		if (!GetPluginStamp(it, cbSize, ftWrite))
+			continue;
+		{
+			mir_cslock lck(csPluginCache);
+			if (FindPluginCache(it, cbSize, ftWrite))
+				continue;
+		}
+
+		if (HANDLE hTask = Task_Create(SniffPluginTask, it, nullptr, TASK_PRIORITY_HIGH))
+			arTasks.insert(hTask);
+		else
+			SniffPluginTask(it);
+	}
+
+	for (auto &it : arTasks) {
+		Task_Wait(it);
+		Task_Close(it);
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////
+
+void LoadPluginCache()
+{
+	wchar_t wszPath[MAX_PATH];
+	GetPluginCachePath(wszPath);
+
+	HANDLE hFile = CreateFileW(wszPath, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, 0, nullptr);
+	if (hFile == INVALID_HANDLE_VALUE)
+		return;
+
+	DWORD dwSize = GetFileSize(hFile, nullptr), dwRead = 0;
+	mir_ptr<uint8_t> pBuf((uint8_t*)mir_alloc(dwSize + 1));
+	BOOL bRead = (dwSize != INVALID_FILE_SIZE && pBuf != nullptr) ? ReadFile(hFile, pBuf, dwSize, &dwRead, nullptr) : FALSE;
+	CloseHandle(hFile);
+	if (!bRead || dwRead != dwSize || dwSize < sizeof(PluginCacheHeader))
+		return;
+
+	UINT v[4] = { MIRANDA_VERSION_COREVERSION };
+	auto *pHdr = (PluginCacheHeader*)pBuf.get();
+	if (pHdr->dwSignature != PLUGIN_CACHE_SIGNATURE || pHdr->dwVersion != PLUGIN_CACHE_VERSION)
+		return;
+	for (int i = 0; i < 4; i++)
+		if (pHdr->dwCoreVersion[i] != v[i])
+			return;
+
+	uint8_t *p = pBuf.get() + sizeof(PluginCacheHeader), *pEnd = pBuf.get() + dwSize;
+	for (uint32_t i = 0; i < pHdr->dwCount; i++) {
+		if (p + sizeof(PluginCacheRecord) > pEnd)
+			break;
+
+		PluginCacheRecord rec;
+		memcpy(&rec, p, sizeof(rec)); p += sizeof(rec);
+		if (rec.cchPath == 0 || p + rec.cchPath * sizeof(wchar_t) + rec.nIds * sizeof(MUUID) > pEnd)
+			break;
+
+		PluginCacheEntry *pNew = new PluginCacheEntry();
+		pNew->pwszPath = mir_wstrndup((wchar_t*)p, rec.cchPath); p += rec.cchPath * sizeof(wchar_t);
+		pNew->cbSize = rec.cbSize;
+		pNew->ftWrite = rec.ftWrite;
+		pNew->bIsPlugin = rec.bIsPlugin != 0;
+		if (rec.nIds) {
+			pNew->nIds = rec.nIds;
+			pNew->pIds = (MUUID*)mir_alloc(sizeof(MUUID) * rec.nIds);
+			memcpy(pNew->pIds, p, sizeof(MUUID) * rec.nIds); p += sizeof(MUUID) * rec.nIds;
+
+			// the list must be terminated, otherwise the record is broken
+			if (pNew->pIds[rec.nIds - 1] != miid_last) {
+				delete pNew;
+				break;
+			}
+		}
+
+		if (g_arPluginCache.find(pNew))
+			delete pNew;
+		else
+			g_arPluginCache.insert(pNew);
+	}
+}
+
+void SavePluginCache()
+{
+	UINT v[4] = { MIRANDA_VERSION_COREVERSION };
+
+	MBinBuffer buf;
+	{
+		mir_cslock lck(csPluginCache);
+		if (!g_bPluginCacheDirty)
+			return;
+
+		PluginCacheHeader hdr = { PLUGIN_CACHE_SIGNATURE, PLUGIN_CACHE_VERSION };
+		for (int i = 0; i < 4; i++)
+			hdr.dwCoreVersion[i] = v[i];
+		buf.append(&hdr, sizeof(hdr));
+
+		for (auto &it : g_arPluginCache) {
+			// forget the dlls that were removed
+			if (GetFileAttributesW(it->pwszPath) == INVALID_FILE_ATTRIBUTES)
+				continue;
+
+			PluginCacheRecord rec = {};
+			rec.cbSize = it->cbSize;
+			rec.ftWrite = it->ftWrite;
+			rec.cchPath = (uint16_t)mir_wstrlen(it->pwszPath);
+			rec.nIds = (uint16_t)it->nIds;
+			rec.bIsPlugin = it->bIsPlugin;
+			buf.append(&rec, sizeof(rec));
+			buf.append(it->pwszPath, rec.cchPath * sizeof(wchar_t));
+			if (it->pIds)
+				buf.append(it->pIds, it->nIds * sizeof(MUUID));
+			((PluginCacheHeader*)buf.data())->dwCount++;
+		}
+		g_bPluginCacheDirty = false;
+	}
+
+	// write a temporary file first, a half-written cache would be thrown away anyway
+	wchar_t wszPath[MAX_PATH], wszTemp[MAX_PATH];
+	GetPluginCachePath(wszPath);
+	mir_snwprintf(wszTemp, L"%s.tmp", wszPath);
+
+	HANDLE hFile = CreateFileW(wszTemp, GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_HIDDEN, nullptr);
+	if (hFile == INVALID_HANDLE_VALUE)
+		return;
+
+	DWORD dwWritten = 0;
+	BOOL bWritten = WriteFile(hFile, buf.data(), (DWORD)buf.length(), &dwWritten, nullptr);
+	CloseHandle(hFile);
+
+	if (bWritten && dwWritten == buf.length())
+		MoveFileExW(wszTemp, wszPath, MOVEFILE_REPLACE_EXISTING);
+	else
+		DeleteFileW(wszTemp);
+}
+
+void UnloadPluginCache()
+{
+	SavePluginCache();
+	g_arPluginCache.destroy();
+}
@@ -59,6 +59,16 @@ static int sttCompareIcons(const IcolibItem *p1, const IcolibItem *p2)
 
 LIST<IcolibItem> iconList(20, sttCompareIcons);
 
+// reverse map: icons given out by IcoLib -> item & the source which owns the icon,
+// icolib handles are stored there too (with an empty source), as they can be passed instead of icons
+struct IconMapEntry
+{
+	IcolibItem *item;
+	IconSourceItem *source;
+};
+
+static std::unordered_map<HICON, IconMapEntry> iconMap;
+
 /////////////////////////////////////////////////////////////////////////////////////////
 // Utility functions
 
@@ -211,6 +221,9 @@ IconSourceItem::IconSourceItem(const IconSourceItemKey &_key)
 
 IconSourceItem::~IconSourceItem()
 {
+	if (icon)
+		iconMap.erase(icon);
+
 	IconSourceFile_Release(key.file);
 	SafeDestroyIcon(icon);
 	mir_free(icon_data);
@@ -293,6 +306,7 @@ int IconSourceItem::releaseIcon()
 		if (!icon_size)
 			if (getIconData(icon))
 				icon_size = 0; // Failure
+		iconMap.erase(icon);
 		SafeDestroyIcon(icon);
 	}
 
@@ -432,27 +446,44 @@ IcolibItem* IcoLib_FindIcon(const char *pszIconName)
 	return (indx != -1) ? iconList[indx] : nullptr;
 }
 
-IcolibItem* IcoLib_FindHIcon(HICON hIcon, bool &big)
+// returns an item which gave out this icon (or an item itself, if its handle was passed) and the icon's source
+IcolibItem* IcoLib_FindHIcon(HICON hIcon, IconSourceItem* &pSource)
 {
+	pSource = nullptr;
 	if (hIcon == nullptr)
 		return nullptr;
 
-	for (auto &p : iconList) {
-		if ((void*)p == hIcon) {
-			big = (p->source_small == nullptr);
-			return p;
-		}
-		if (p->source_small && p->source_small->icon == hIcon) {
-			big = false;
-			return p;
-		}
-		if (p->source_big && p->source_big->icon == hIcon) {
-			big = true;
-			return p;
-		}
+	auto it = iconMap.find(hIcon);
+	if (it == iconMap.end())
+		return nullptr;
+
+	IcolibItem *p = it->second.item;
+	pSource = it->second.source;
+	if (pSource == nullptr) {
+		bool big = (p->source_small == nullptr);
+		pSource = big && !p->cx ? p->source_big : p->source_small;
 	}
+	return p;
+}
 
-	return nullptr;
+IcolibItem::~IcolibItem()
+{
+	clear();
+
+	iconMap.erase((HICON)this);
+
+	// icons of shared sources might be still alive, bind them to another item
+	for (auto &it : iconMap) {
+		if (it.second.item != this)
+			continue;
+
+		it.second.item = nullptr;
+		for (auto &p : iconList)
+			if (p != this && (p->source_small == it.second.source || p->source_big == it.second.source)) {
+				it.second.item = p;
+				break;
+			}
+	}
 }
 
 void IcolibItem::clear()
@@ -484,6 +515,7 @@ MIR_APP_DLL(HANDLE) IcoLib_AddIcon(const SKINICONDESC *sid, HPLUGIN pPlugin)
 		item = new IcolibItem();
 		item->name = sid->pszName;
 		iconList.insert(item);
+		iconMap[(HICON)item] = { item, nullptr };
 	}
 	else item->clear();
 
@@ -516,10 +548,10 @@ MIR_APP_DLL(HANDLE) IcoLib_AddIcon(const SKINICONDESC *sid, HPLUGIN pPlugin)
 	item->pPlugin = pPlugin;
 
 	if (sid->hDefaultIcon) {
-		bool big;
-		IcolibItem *def_item = IcoLib_FindHIcon(sid->hDefaultIcon, big);
-		if (def_item) {
-			item->default_icon = big ? def_item->source_big : def_item->source_small;
+		IconSourceItem *def_source;
+		IcoLib_FindHIcon(sid->hDefaultIcon, def_source);
+		if (def_source) {
+			item->default_icon = def_source;
 			item->default_icon->addRef();
 		}
 		else {
@@ -545,12 +577,8 @@ MIR_APP_DLL(HANDLE) IcoLib_AddIcon(const SKINICONDESC *sid, HPLUGIN pPlugin)
 /////////////////////////////////////////////////////////////////////////////////////////
 // IcoLib_ReleaseIcon
 
-static int ReleaseIconInternal(IcolibItem *item, bool big)
+static int ReleaseIconInternal(IconSourceItem *source)
 {
-	if (item == nullptr)
-		return 1;
-
-	IconSourceItem *source = big && !item->cx ? item->source_big : item->source_small;
 	if (source && source->icon_ref_count) {
 		source->releaseIcon();
 		return 0;
@@ -559,17 +587,17 @@ static int ReleaseIconInternal(IcolibItem *item, bool big)
 	return 1;
 }
 
-MIR_APP_DLL(int) IcoLib_ReleaseIcon(HICON hIcon, bool big)
+MIR_APP_DLL(int) IcoLib_ReleaseIcon(HICON hIcon, bool)
 {
 	if (hIcon == nullptr)
 		return 1;
 
 	mir_cslock lck(csIconList);
 
-	// this call might change the 'big' parameter
-	// if inserted into the call of ReleaseIconInternal(), the unchanged 'big' will be passed first
-	IcolibItem *pItem = IcoLib_FindHIcon(hIcon, big);
-	return ReleaseIconInternal(pItem, big);
+	// the icon's owner is known exactly, so the 'big' parameter isn't needed
+	IconSourceItem *source;
+	IcoLib_FindHIcon(hIcon, source);
+	return ReleaseIconInternal(source);
 }
 
 MIR_APP_DLL(int) IcoLib_Release(const char *szIconName, bool big)
@@ -578,7 +606,11 @@ MIR_APP_DLL(int) IcoLib_Release(const char *szIconName, bool big)
 		return 1;
 
 	mir_cslock lck(csIconList);
-	return ReleaseIconInternal(IcoLib_FindIcon(szIconName), big);
+	IcolibItem *item = IcoLib_FindIcon(szIconName);
+	if (item == nullptr)
+		return 1;
+
+	return ReleaseIconInternal(big && !item->cx ? item->source_big : item->source_small);
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////
@@ -620,8 +652,9 @@ MIR_APP_DLL(void) KillModuleIcons(HPLUGIN pPlugin)
 
 /////////////////////////////////////////////////////////////////////////////////////////
 // IconItem_GetDefaultIcon
+// pSource receives the source which owns the returned icon
 
-HICON IconItem_GetDefaultIcon(IcolibItem *item, bool big)
+HICON IconItem_GetDefaultIcon(IcolibItem *item, bool big, IconSourceItem* &pSource)
 {
 	HICON hIcon = nullptr;
 
@@ -630,6 +663,8 @@ HICON IconItem_GetDefaultIcon(IcolibItem *item, bool big)
 		item->source_small = item->default_icon;
 		item->source_small->addRef();
 		hIcon = item->source_small->getIcon();
+		if (hIcon)
+			pSource = item->default_icon;
 	}
 
 	if (!hIcon && item->default_file) {
@@ -643,6 +678,8 @@ HICON IconItem_GetDefaultIcon(IcolibItem *item, bool big)
 				if (def_icon) {
 					def_icon->addRef();
 					hIcon = def_icon->getIcon();
+					if (hIcon)
+						pSource = def_icon;
 				}
 			}
 			else def_icon->release();
@@ -656,6 +693,8 @@ HICON IconItem_GetDefaultIcon(IcolibItem *item, bool big)
 					item->source_small = def_icon;
 					def_icon->addRef();
 					hIcon = def_icon->getIcon();
+					if (hIcon)
+						pSource = def_icon;
 				}
 			}
 			else def_icon->release();
@@ -687,15 +726,18 @@ HICON IconItem_GetIcon(HANDLE hIcoLib, bool big)
 	}
 
 	HICON hIcon = nullptr;
+	IconSourceItem *pOwner = source;
 	if (source)
 		hIcon = source->getIcon();
 
 	if (!hIcon)
-		hIcon = IconItem_GetDefaultIcon(item, big);
+		hIcon = IconItem_GetDefaultIcon(item, big, pOwner);
 
 	if (!hIcon)
 		return hIconBlank;
 
+	// remember the source which created the icon, it might be a default one
+	iconMap[hIcon] = { item, pOwner };
 	return hIcon;
 }
 
@@ -758,8 +800,8 @@ MIR_APP_DLL(HANDLE) IcoLib_IsManaged(HICON hIcon)
 {
 	mir_cslock lck(csIconList);
 
-	bool big;
-	return IcoLib_FindHIcon(hIcon, big);
+	IconSourceItem *source;
+	return IcoLib_FindHIcon(hIcon, source);
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////
@@ -771,14 +813,11 @@ MIR_APP_DLL(int) IcoLib_AddRef(HICON hIcon)
 {
 	mir_cslock lck(csIconList);
 
-	bool big;
-	IcolibItem *item = IcoLib_FindHIcon(hIcon, big);
-	if (item) {
-		IconSourceItem *source = big && !item->cx ? item->source_big : item->source_small;
-		if (source->icon_ref_count) {
-			source->icon_ref_count++;
-			return 0;
-		}
+	IconSourceItem *source;
+	IcoLib_FindHIcon(hIcon, source);
+	if (source && source->icon_ref_count) {
+		source->icon_ref_count++;
+		return 0;
 	}
 
 	return 1;
@@ -806,6 +845,7 @@ void UnloadIcoLibModule(void)
 
 	DestroyHookableEvent(hIconsChangedEvent);
 
+	iconMap.clear();
 	for (auto &p : iconList)
 		delete p;		
 	iconList.destroy();
@@ -288,6 +288,9 @@ MIR_APP_DLL(int) Netlib_CloseHandle(HANDLE hNetlib)
 	case NLH_USER:
 		{
 			NetlibUser *nlu = (NetlibUser*)hNetlib;
+
+			// queued log records might refer to this user
+			NetlibLogFlush();
 			{
 				mir_cslock lck(csNetlibUser);
 				int i = netlibUser.getIndex(nlu);
@@ -339,6 +342,10 @@ MIR_APP_DLL(int) Netlib_CloseHandle(HANDLE hNetlib)
 	}
 	break;
 
+	case NLH_STREAMREADER:
+		mir_free(((NetlibStreamReader *)hNetlib)->buffer);
+		break;
+
 	default:
 		SetLastError(ERROR_INVALID_PARAMETER);
 		return 0;
@@ -29,6 +29,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #define NLH_CONNECTION   'CONN'
 #define NLH_BOUNDPORT    'BIND'
 #define NLH_PACKETRECVER 'PCKT'
+#define NLH_STREAMREADER 'STRM'
 int GetNetlibHandleType(void*);
 
 #define NLHRF_SMARTREMOVEHOST	0x00000004	 // for internal purposes only
@@ -136,6 +137,16 @@ struct NetlibPacketRecver
 	NETLIBPACKETRECVER packetRecver;
 };
 
+struct NetlibStreamReader
+{
+	int handleType;
+	NetlibConnection *nlc;
+	int flags;             // passed to Netlib_Recv
+	int cbBuffer;          // allocated size
+	int offset, cbData;    // unread data lives in buffer[offset .. offset+cbData)
+	uint8_t *buffer;
+};
+
 //netlib.c
 void NetlibFreeUserSettingsStruct(NETLIBUSERSETTINGS *settings);
 void NetlibDoCloseSocket(NetlibConnection *nlc, bool noShutdown = false);
@@ -170,6 +181,7 @@ NETLIBHTTPREQUEST* NetlibHttpRecv(NetlibConnection* nlc, uint32_t hflags, uint32
 // netliblog.cpp
 void NetlibLogShowOptions(void);
 void NetlibLogInit(void);
+void NetlibLogFlush(void);
 void NetlibLogShutdown(void);
 
 // netlibopenconn.cpp
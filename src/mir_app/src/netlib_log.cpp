@@ -52,6 +52,7 @@ static __int64 mirandaStartTime, perfCounterFreq;
 static int bIsActive = TRUE;
 static HANDLE hLogEvent = nullptr;
 static HANDLE hLogger = nullptr;
+static mir_cs csLogWriter;
 
 static void InitLog()
 {
@@ -69,11 +70,6 @@ static void InitLog()
 	logOptions.toFile = db_get_b(0, "Netlib", "ToFile", false) != 0;
 	logOptions.toLog = db_get_dw(0, "Netlib", "NLlog", true) != 0;
 
-	if (hLogger) {
-		mir_closeLog(hLogger);
-		hLogger = nullptr;
-	}
-
 	ptrW szBuf(db_get_wsa(0, "Netlib", "File"));
 	if (mir_wstrlen(szBuf)) {
 		logOptions.tszUserFile = szBuf.get();
@@ -87,16 +83,22 @@ static void InitLog()
 		logOptions.tszFile = VARSW(logOptions.tszUserFile);
 	}
 
-	if (logOptions.toFile) {
-		CMStringW wszFileName = logOptions.tszFile;
-		if (logOptions.rotateLogs) {
-			int iLogNumber = db_get_dw(0, "Netlib", "RotateId");
-			wszFileName.AppendFormat(L".%d", iLogNumber);
-			db_set_dw(0, "Netlib", "RotateId", (iLogNumber + 1) % 10);
-		}
+	CMStringW wszFileName = logOptions.tszFile;
+	if (logOptions.toFile && logOptions.rotateLogs) {
+		int iLogNumber = db_get_dw(0, "Netlib", "RotateId");
+		wszFileName.AppendFormat(L".%d", iLogNumber);
+		db_set_dw(0, "Netlib", "RotateId", (iLogNumber + 1) % 10);
+	}
 
-		hLogger = mir_createLog("Netlib", LPGENW("Standard Netlib log"), wszFileName, 0);
+	// the writer thread might use the old log right now
+	mir_cslock lck(csLogWriter);
+	if (hLogger) {
+		mir_closeLog(hLogger);
+		hLogger = nullptr;
 	}
+
+	if (logOptions.toFile && !wszFileName.IsEmpty())
+		hLogger = mir_createLog("Netlib", LPGENW("Standard Netlib log"), wszFileName, 0);
 }
 
 static const wchar_t *szTimeFormats[] =
@@ -312,42 +314,70 @@ static INT_PTR ShowOptions(WPARAM, LPARAM)
 	return 0;
 }
 
-int NetlibLog_Worker(NetlibUser *nlu, const char *pszMsg, int flags)
-{
-	if (!bIsActive)
-		return 0;
+/////////////////////////////////////////////////////////////////////////////////////////
+// log records are pushed by the calling threads into a lock-free list, the writer thread
+// formats them and writes to a file in batches. if the writer falls behind, a producer
+// drains the list itself
 
-	uint32_t dwOriginalLastError = GetLastError();
+#define LOG_MAX_PENDING (8 * 1024 * 1024)
 
-	if ((nlu != nullptr && GetNetlibHandleType(nlu) != NLH_USER) || pszMsg == nullptr) {
-		SetLastError(ERROR_INVALID_PARAMETER);
-		return 0;
-	}
+struct LogRecord
+{
+	SLIST_ENTRY slist;            // must be aligned, so the record is allocated via _aligned_malloc
+	LogRecord *next;              // restored order of records inside the writer
+	NetlibUser *nlu;              // valid till NetlibLogFlush() is called in Netlib_CloseHandle
+	HNETLIBCONN nlc;              // only its value is used, for dumps
+	unsigned iSocket;
+	int flags;
+	bool bIsDump, bIsSent;
+	uint32_t dwThreadId;
+	SYSTEMTIME st;
+	LARGE_INTEGER liTime;
+	size_t cbData;
+	char data[1];
+};
 
-	/* if the Netlib user handle is nullptr, just pretend its not */
-	if (!(nlu != nullptr ? nlu->toLog : logOptions.toLog))
-		return 1;
+static SLIST_HEADER logQueue;
+static volatile LONG iPendingBytes;
+static HANDLE hLogWakeup, hLogThread;
+static volatile bool bLogStop;
+
+static LogRecord* CreateRecord(NetlibUser *nlu, const void *pData, size_t cbData, int flags)
+{
+	LogRecord *p = (LogRecord*)_aligned_malloc(sizeof(LogRecord) + cbData, MEMORY_ALLOCATION_ALIGNMENT);
+	if (p == nullptr)
+		return nullptr;
+
+	memset(p, 0, sizeof(LogRecord));
+	p->nlu = nlu;
+	p->flags = flags;
+	p->dwThreadId = GetCurrentThreadId();
+	GetLocalTime(&p->st);
+	QueryPerformanceCounter(&p->liTime);
+	p->cbData = cbData;
+	memcpy(p->data, pData, cbData);
+	p->data[cbData] = 0;
+	return p;
+}
 
-	LARGE_INTEGER liTimeNow;
-	char szDate[32], szTime[32], szHead[128];
+static void FormatHeader(const LogRecord *p, char *szHead, size_t cbHead)
+{
+	LONGLONG liTime;
+	char szDate[32], szTime[32];
 	switch (logOptions.timeFormat) {
 	case TIMEFORMAT_HHMMSS:
-		GetTimeFormatA(LOCALE_USER_DEFAULT, TIME_FORCE24HOURFORMAT | TIME_NOTIMEMARKER, nullptr, nullptr, szTime, _countof(szTime));
+		GetTimeFormatA(LOCALE_USER_DEFAULT, TIME_FORCE24HOURFORMAT | TIME_NOTIMEMARKER, &p->st, nullptr, szTime, _countof(szTime));
 		mir_strcat(szTime, " ");
 		break;
 
 	case TIMEFORMAT_MILLISECONDS:
-		QueryPerformanceCounter(&liTimeNow);
-		liTimeNow.QuadPart -= mirandaStartTime;
-		mir_snprintf(szTime, "%I64u.%03I64u ", liTimeNow.QuadPart / perfCounterFreq,
-			1000 * (liTimeNow.QuadPart % perfCounterFreq) / perfCounterFreq);
+		liTime = p->liTime.QuadPart - mirandaStartTime;
+		mir_snprintf(szTime, "%I64u.%03I64u ", liTime / perfCounterFreq, 1000 * (liTime % perfCounterFreq) / perfCounterFreq);
 		break;
 
 	case TIMEFORMAT_MICROSECONDS:
-		QueryPerformanceCounter(&liTimeNow);
-		liTimeNow.QuadPart -= mirandaStartTime;
-		mir_snprintf(szTime, "%I64u.%06I64u ", liTimeNow.QuadPart / perfCounterFreq,
-			1000000 * (liTimeNow.QuadPart % perfCounterFreq) / perfCounterFreq);
+		liTime = p->liTime.QuadPart - mirandaStartTime;
+		mir_snprintf(szTime, "%I64u.%06I64u ", liTime / perfCounterFreq, 1000000 * (liTime % perfCounterFreq) / perfCounterFreq);
 		break;
 
 	default:
@@ -356,35 +386,201 @@ int NetlibLog_Worker(NetlibUser *nlu, const char *pszMsg, int flags)
 	}
 
 	if (logOptions.bPrintDate) {
-		GetDateFormatA(LOCALE_USER_DEFAULT, 0, nullptr, "yyyy-MM-dd", szDate, _countof(szDate));
+		GetDateFormatA(LOCALE_USER_DEFAULT, 0, &p->st, "yyyy-MM-dd", szDate, _countof(szDate));
 		mir_strcat(szDate, " ");
 	}
 	else szDate[0] = 0;
 
-	if (flags & MSG_NOTITLE) 
-		szHead[0] = 0; 
+	if (p->flags & MSG_NOTITLE)
+		szHead[0] = 0;
 	else {
-		char *szUser = (logOptions.showUser) ? (nlu == nullptr ? nullptr : nlu->user.szSettingsModule) : nullptr;
+		char *szUser = (logOptions.showUser) ? (p->nlu == nullptr ? nullptr : p->nlu->user.szSettingsModule) : nullptr;
 		if (szUser)
-			mir_snprintf(szHead, "[%s%s%04X] [%s] ", szDate, szTime, GetCurrentThreadId(), szUser);
+			mir_snprintf(szHead, cbHead, "[%s%s%04X] [%s] ", szDate, szTime, p->dwThreadId, szUser);
 		else
-			mir_snprintf(szHead, "[%s%s%04X] ", szDate, szTime, GetCurrentThreadId());
+			mir_snprintf(szHead, cbHead, "[%s%s%04X] ", szDate, szTime, p->dwThreadId);
 	}
+}
+
+static void FormatDump(const LogRecord *pRec, CMStringA &str)
+{
+	str.Empty();
+	if (!(pRec->flags & MSG_NOTITLE))
+		str.Format("(%p:%u) Data %s%s\r\n", pRec->nlc, pRec->iSocket, pRec->bIsSent ? "sent" : "received", pRec->flags & MSG_DUMPPROXY ? " (proxy)" : "");
+
+	const uint8_t *buf = (const uint8_t *)pRec->data;
+	size_t len = pRec->cbData;
 
-	if (logOptions.toOutputDebugString) {
-		if (szHead[0])
-			OutputDebugStringA(szHead);
-		OutputDebugStringA(pszMsg);
-		OutputDebugStringA("\n");
+	bool isText = true;
+	if (!logOptions.textDumps)
+		isText = false;
+	else if (!(pRec->flags & MSG_DUMPASTEXT)) {
+		if (logOptions.autoDetectText) {
+			for (size_t i = 0; i < len; i++) {
+				if ((buf[i] < ' ' && buf[i] != '\t' && buf[i] != '\r' && buf[i] != '\n') || buf[i] >= 0x80) {
+					isText = false;
+					break;
+				}
+			}
+		}
+		else isText = false;
 	}
 
-	if (logOptions.toFile && !logOptions.tszFile.IsEmpty()) {
-		size_t len = mir_strlen(pszMsg);
-		mir_writeLogA(hLogger, "%s%s%s", szHead, pszMsg, pszMsg[len-1] == '\n' ? "" : "\r\n");
+	// Text data
+	if (isText) {
+		str.Append((const char*)buf, (int)len);
+	}
+	// Binary data
+	else {
+		for (int line = 0;; line += 16) {
+			auto *p = buf + line;
+			int colsInLine = min(16, (int)len - line);
+			if (colsInLine == 16)
+				str.AppendFormat("%08X: %02X %02X %02X %02X-%02X %02X %02X %02X-%02X %02X %02X %02X-%02X %02X %02X %02X  ",
+					line, p[0], p[1], p[2], p[3], p[4], p[5], p[6], p[7], p[8], p[9], p[10], p[11], p[12], p[13], p[14], p[15]);
+			else {
+				str.AppendFormat("%08X: ", line);
+				
+				// Dump data as hex
+				int col;
+				for (col = 0; col < colsInLine; col++)
+					str.AppendFormat("%02X%c", p[col], ((col & 3) == 3) ? '-' : ' ');
+
+				// Fill out last line with blanks
+				for (; col < 16; col++)
+					str.Append("   ");
+
+				str.AppendChar(' ');
+			}
+
+			for (int col = 0; col < colsInLine; col++)
+				str.AppendChar((p[col] < ' ') ? '.' : p[col]);
+
+			if (len - line <= 16)
+				break;
+
+			str.AppendChar('\r'); // End each line with a break
+			str.AppendChar('\n'); // End each line with a break
+		}
+	}
+}
+
+void NetlibLogFlush()
+{
+	mir_cslock lck(csLogWriter);
+
+	// the list is LIFO, restore the original order
+	LogRecord *pFirst = nullptr;
+	for (PSLIST_ENTRY e = InterlockedFlushSList(&logQueue); e != nullptr;) {
+		LogRecord *p = CONTAINING_RECORD(e, LogRecord, slist);
+		e = e->Next;
+		p->next = pFirst;
+		pFirst = p;
 	}
+	if (pFirst == nullptr)
+		return;
+
+	bool bToFile = hLogger != nullptr;
+	char szHead[128];
+	CMStringA szBatch, szDump;
+	LONG cbDone = 0;
+
+	for (LogRecord *p = pFirst; p != nullptr;) {
+		const char *pszMsg = p->data;
+		if (p->bIsDump) {
+			FormatDump(p, szDump);
+			pszMsg = szDump;
+		}
+
+		FormatHeader(p, szHead, sizeof(szHead));
+
+		if (logOptions.toOutputDebugString) {
+			if (szHead[0])
+				OutputDebugStringA(szHead);
+			OutputDebugStringA(pszMsg);
+			OutputDebugStringA("\n");
+		}
 
-	LOGMSG logMsg = { szHead, pszMsg };
-	NotifyFastHook(hLogEvent, (WPARAM)nlu, (LPARAM)&logMsg);
+		if (bToFile) {
+			size_t len = mir_strlen(pszMsg);
+			szBatch.Append(szHead);
+			szBatch.Append(pszMsg, (int)len);
+			if (len == 0 || pszMsg[len - 1] != '\n')
+				szBatch.Append("\r\n");
+		}
+
+		cbDone += (LONG)p->cbData;
+		LogRecord *pNext = p->next;
+		_aligned_free(p);
+		p = pNext;
+	}
+
+	if (!szBatch.IsEmpty())
+		mir_writeLogA(hLogger, "%s", szBatch.c_str());
+
+	InterlockedExchangeAdd(&iPendingBytes, -cbDone);
+}
+
+static void PushRecord(LogRecord *p)
+{
+	// subscribers are called by the logging thread itself, only files & debug output are delayed
+	if (GetSubscribersCount((THook*)hLogEvent) != 0) {
+		char szHead[128];
+		FormatHeader(p, szHead, sizeof(szHead));
+
+		CMStringA szDump;
+		const char *pszMsg = p->data;
+		if (p->bIsDump) {
+			FormatDump(p, szDump);
+			pszMsg = szDump;
+		}
+
+		LOGMSG logMsg = { szHead, pszMsg };
+		NotifyFastHook(hLogEvent, (WPARAM)p->nlu, (LPARAM)&logMsg);
+	}
+
+	LONG cbPending = InterlockedExchangeAdd(&iPendingBytes, (LONG)p->cbData) + (LONG)p->cbData;
+	if (InterlockedPushEntrySList(&logQueue, &p->slist) == nullptr && hLogWakeup)
+		SetEvent(hLogWakeup);
+
+	if (bLogStop || cbPending > LOG_MAX_PENDING)
+		NetlibLogFlush();
+}
+
+// the wait is alertable, so that Thread_Wait() could wake us up at exit
+static unsigned __stdcall LogWriterThread(void *)
+{
+	while (!Miranda_IsTerminated()) {
+		WaitForSingleObjectEx(hLogWakeup, INFINITE, TRUE);
+		NetlibLogFlush();
+	}
+
+	// the rest is written by the callers themselves
+	bLogStop = true;
+	NetlibLogFlush();
+	return 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////
+
+int NetlibLog_Worker(NetlibUser *nlu, const char *pszMsg, int flags)
+{
+	if (!bIsActive)
+		return 0;
+
+	uint32_t dwOriginalLastError = GetLastError();
+
+	if ((nlu != nullptr && GetNetlibHandleType(nlu) != NLH_USER) || pszMsg == nullptr) {
+		SetLastError(ERROR_INVALID_PARAMETER);
+		return 0;
+	}
+
+	/* if the Netlib user handle is nullptr, just pretend its not */
+	if (!(nlu != nullptr ? nlu->toLog : logOptions.toLog))
+		return 1;
+
+	if (LogRecord *p = CreateRecord(nlu, pszMsg, mir_strlen(pszMsg), flags))
+		PushRecord(p);
 
 	SetLastError(dwOriginalLastError);
 	return 1;
@@ -468,13 +664,12 @@ MIR_APP_DLL(void) Netlib_Dump(HNETLIBCONN nlc, const void *pBuf, size_t len, boo
 		return;
 
 	NetlibUser *nlu;
-	CMStringA str;
+	unsigned iSocket;
 	{
 		mir_cslock lock(csConnectionHeader);
 
 		nlu = nlc ? nlc->nlu : nullptr;
-		if (!(flags & MSG_NOTITLE))
-			str.Format("(%p:%u) Data %s%s\r\n", nlc, nlc ? (int)nlc->s : 0, bIsSent ? "sent" : "received", flags & MSG_DUMPPROXY ? " (proxy)" : "");
+		iSocket = nlc ? (unsigned)nlc->s : 0;
 	}
 
 	// check filter settings
@@ -485,62 +680,19 @@ MIR_APP_DLL(void) Netlib_Dump(HNETLIBCONN nlc, const void *pBuf, size_t len, boo
 	else if (!nlu->toLog)
 		return;
 
-	const uint8_t *buf = (const uint8_t *)pBuf;
-
-	bool isText = true;
-	if (!logOptions.textDumps)
-		isText = false;
-	else if (!(flags & MSG_DUMPASTEXT)) {
-		if (logOptions.autoDetectText) {
-			for (size_t i = 0; i < len; i++) {
-				if ((buf[i] < ' ' && buf[i] != '\t' && buf[i] != '\r' && buf[i] != '\n') || buf[i] >= 0x80) {
-					isText = false;
-					break;
-				}
-			}
-		}
-		else isText = false;
-	}
-
-	// Text data
-	if (isText) {
-		str.Append((const char*)buf, (int)len);
-	}
-	// Binary data
-	else {
-		for (int line = 0;; line += 16) {
-			auto *p = buf + line;
-			int colsInLine = min(16, (int)len - line);
-			if (colsInLine == 16)
-				str.AppendFormat("%08X: %02X %02X %02X %02X-%02X %02X %02X %02X-%02X %02X %02X %02X-%02X %02X %02X %02X  ",
-					line, p[0], p[1], p[2], p[3], p[4], p[5], p[6], p[7], p[8], p[9], p[10], p[11], p[12], p[13], p[14], p[15]);
-			else {
-				str.AppendFormat("%08X: ", line);
-				
-				// Dump data as hex
-				int col;
-				for (col = 0; col < colsInLine; col++)
-					str.AppendFormat("%02X%c", p[col], ((col & 3) == 3) ? '-' : ' ');
-
-				// Fill out last line with blanks
-				for (; col < 16; col++)
-					str.Append("   ");
-
-				str.AppendChar(' ');
-			}
-
-			for (int col = 0; col < colsInLine; col++)
-				str.AppendChar((p[col] < ' ') ? '.' : p[col]);
-
-			if (len - line <= 16)
-				break;
+	if (!bIsActive)
+		return;
 
-			str.AppendChar('\r'); // End each line with a break
-			str.AppendChar('\n'); // End each line with a break
-		}
+	// the data is copied as is, text detection & hex dump are made by the writer
+	uint32_t dwOriginalLastError = GetLastError();
+	if (LogRecord *p = CreateRecord(nlu, pBuf, len, flags)) {
+		p->bIsDump = true;
+		p->bIsSent = bIsSent;
+		p->nlc = nlc;
+		p->iSocket = iSocket;
+		PushRecord(p);
 	}
-
-	NetlibLog_Worker(nlu, str, flags);
+	SetLastError(dwOriginalLastError);
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////
@@ -558,6 +710,12 @@ void NetlibLogInit(void)
 
 	InitLog();
 
+	InitializeSListHead(&logQueue);
+	hLogWakeup = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+	hLogThread = mir_forkthreadex(LogWriterThread);
+	if (hLogThread == nullptr)
+		bLogStop = true;
+
 	if (db_get_b(0, "Netlib", "ShowLogOptsAtStart", 0))
 		NetlibLogShowOptions();
 
@@ -572,6 +730,15 @@ void NetlibLogInit(void)
 void NetlibLogShutdown(void)
 {
 	bIsActive = FALSE;
+
+	// the writer has already left at Thread_Wait()
+	bLogStop = true;
+	if (hLogThread) {
+		CloseHandle(hLogThread); hLogThread = nullptr;
+	}
+	NetlibLogFlush();
+	CloseHandle(hLogWakeup); hLogWakeup = nullptr;
+
 	DestroyHookableEvent(hLogEvent); hLogEvent = nullptr;
 	if (IsWindow(logOptions.hwndOpts))
 		DestroyWindow(logOptions.hwndOpts);
@@ -0,0 +1,175 @@
+/*
+
+Miranda NG: the free IM client for Microsoft* Windows*
+
+Copyright (C) 2012-22 Miranda NG team (https://miranda-ng.org),
+Copyright (c) 2000-12 Miranda IM project,
+all portions of this codebase are copyrighted to the people
+listed in contributors.txt.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+
+#include "stdafx.h"
+#include "netlib.h"
+
+#define STREAM_DEFAULT_SIZE 65536
+
+/////////////////////////////////////////////////////////////////////////////////////////
+// ensures that at least cbNeeded bytes are available in the buffer
+
+static int StreamFill(NetlibStreamReader *nlsr, int cbNeeded)
+{
+	if (nlsr->cbData >= cbNeeded)
+		return nlsr->cbData;
+
+	if (cbNeeded > nlsr->cbBuffer) {
+		int cbNew = nlsr->cbBuffer;
+		while (cbNew < cbNeeded)
+			cbNew *= 2;
+
+		nlsr->buffer = (uint8_t *)mir_realloc(nlsr->buffer, cbNew);
+		nlsr->cbBuffer = cbNew;
+	}
+
+	// move the unread tail to the beginning, if the rest doesn't fit
+	if (nlsr->offset + cbNeeded > nlsr->cbBuffer) {
+		memmove(nlsr->buffer, nlsr->buffer + nlsr->offset, nlsr->cbData);
+		nlsr->offset = 0;
+	}
+
+	while (nlsr->cbData < cbNeeded) {
+		int cbFree = nlsr->cbBuffer - nlsr->offset - nlsr->cbData;
+		int recvResult = Netlib_Recv(nlsr->nlc, (char *)nlsr->buffer + nlsr->offset + nlsr->cbData, cbFree, nlsr->flags);
+		if (recvResult <= 0)
+			return recvResult;
+
+		nlsr->cbData += recvResult;
+	}
+	return nlsr->cbData;
+}
+
+static void StreamConsume(NetlibStreamReader *nlsr, int cbLen)
+{
+	nlsr->cbData -= cbLen;
+	nlsr->offset = (nlsr->cbData == 0) ? 0 : nlsr->offset + cbLen;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////
+
+MIR_APP_DLL(HANDLE) Netlib_CreateStreamReader(HNETLIBCONN nlc, int iBufSize, int flags)
+{
+	if (GetNetlibHandleType(nlc) != NLH_CONNECTION || iBufSize < 0) {
+		SetLastError(ERROR_INVALID_PARAMETER);
+		return nullptr;
+	}
+
+	NetlibStreamReader *nlsr = (NetlibStreamReader *)mir_calloc(sizeof(NetlibStreamReader));
+	nlsr->handleType = NLH_STREAMREADER;
+	nlsr->nlc = nlc;
+	nlsr->flags = flags & ~MSG_PEEK;
+	nlsr->cbBuffer = (iBufSize == 0) ? STREAM_DEFAULT_SIZE : iBufSize;
+	nlsr->buffer = (uint8_t *)mir_alloc(nlsr->cbBuffer);
+	return nlsr;
+}
+
+MIR_APP_DLL(int) Netlib_StreamPending(HANDLE hReader)
+{
+	NetlibStreamReader *nlsr = (NetlibStreamReader *)hReader;
+	if (GetNetlibHandleType(nlsr) != NLH_STREAMREADER) {
+		SetLastError(ERROR_INVALID_PARAMETER);
+		return SOCKET_ERROR;
+	}
+
+	return nlsr->cbData;
+}
+
+MIR_APP_DLL(int) Netlib_StreamPeek(HANDLE hReader, void *buf, int len)
+{
+	NetlibStreamReader *nlsr = (NetlibStreamReader *)hReader;
+	if (GetNetlibHandleType(nlsr) != NLH_STREAMREADER || buf == nullptr || len <= 0) {
+		SetLastError(ERROR_INVALID_PARAMETER);
+		return SOCKET_ERROR;
+	}
+
+	int res = StreamFill(nlsr, len);
+	if (res <= 0)
+		return res;
+
+	memcpy(buf, nlsr->buffer + nlsr->offset, len);
+	return len;
+}
+
+MIR_APP_DLL(int) Netlib_StreamRead(HANDLE hReader, void *buf, int len)
+{
+	NetlibStreamReader *nlsr = (NetlibStreamReader *)hReader;
+	if (GetNetlibHandleType(nlsr) != NLH_STREAMREADER || buf == nullptr || len <= 0) {
+		SetLastError(ERROR_INVALID_PARAMETER);
+		return SOCKET_ERROR;
+	}
+
+	// small reads are served from the buffer
+	if (len <= nlsr->cbBuffer) {
+		int res = StreamFill(nlsr, len);
+		if (res <= 0)
+			return res;
+
+		memcpy(buf, nlsr->buffer + nlsr->offset, len);
+		StreamConsume(nlsr, len);
+		return len;
+	}
+
+	// large ones take what's buffered and receive the rest directly into buf
+	int cbDone = nlsr->cbData;
+	memcpy(buf, nlsr->buffer + nlsr->offset, cbDone);
+	StreamConsume(nlsr, cbDone);
+
+	while (cbDone < len) {
+		int recvResult = Netlib_Recv(nlsr->nlc, (char *)buf + cbDone, len - cbDone, nlsr->flags);
+		if (recvResult <= 0)
+			return recvResult;
+
+		cbDone += recvResult;
+	}
+	return len;
+}
+
+MIR_APP_DLL(int) Netlib_StreamReadVarInt(HANDLE hReader, uint32_t *pValue)
+{
+	NetlibStreamReader *nlsr = (NetlibStreamReader *)hReader;
+	if (GetNetlibHandleType(nlsr) != NLH_STREAMREADER || pValue == nullptr) {
+		SetLastError(ERROR_INVALID_PARAMETER);
+		return SOCKET_ERROR;
+	}
+
+	uint32_t result = 0;
+	for (int i = 0; i < 5; i++) {
+		int res = StreamFill(nlsr, 1);
+		if (res <= 0)
+			return res;
+
+		uint8_t b = nlsr->buffer[nlsr->offset];
+		StreamConsume(nlsr, 1);
+
+		result |= uint32_t(b & 0x7F) << (7 * i);
+		if ((b & 0x80) == 0) {
+			*pValue = result;
+			return i + 1;
+		}
+	}
+
+	SetLastError(ERROR_INVALID_DATA);
+	return SOCKET_ERROR;
+}
@@ -393,9 +393,9 @@ pluginEntry* OpenPlugin(wchar_t *tszFileName, wchar_t *dir, wchar_t *path)
 	wchar_t tszFullPath[MAX_PATH];
 	mir_snwprintf(tszFullPath, L"%s\\%s\\%s", path, dir, tszFileName);
 
-	// map dll into the memory and check its exports
+	// map dll into the memory and check its exports, unless it's already cached
 	bool bIsPlugin = false;
-	mir_ptr<MUUID> pIds(GetPluginInterfaces(tszFullPath, bIsPlugin));
+	mir_ptr<MUUID> pIds(GetCachedPluginInterfaces(tszFullPath, bIsPlugin));
 	if (!bIsPlugin)
 		return nullptr;
 
@@ -765,9 +765,10 @@ int LoadStdPlugins()
 // Plugins module initialization
 // called before anything real is loaded, incl. database
 
-static BOOL scanPluginsDir(WIN32_FIND_DATA *fd, wchar_t *path, WPARAM, LPARAM)
+static BOOL scanPluginsDir(WIN32_FIND_DATA *fd, wchar_t *path, WPARAM wParam, LPARAM)
 {
-	OpenPlugin(fd->cFileName, L"Plugins", path);
+	auto *pList = (LIST<wchar_t>*)wParam;
+	pList->insert(mir_wstrdup(CMStringW(FORMAT, L"%s\\Plugins\\%s", path, fd->cFileName)));
 	return TRUE;
 }
 
@@ -781,13 +782,30 @@ int LoadNewPluginsModuleInfos(void)
 	// remember where the mirandaboot.ini lays
 	PathToAbsoluteW(L"mirandaboot.ini", mirandabootini);
 
-	// look for all *.dll's
-	enumPlugins(scanPluginsDir, 0, 0);
+	wchar_t exe[MAX_PATH];
+	GetModuleFileName(nullptr, exe, _countof(exe));
+	wchar_t *slice = wcsrchr(exe, '\\');
+	if (slice)
+		*slice = 0;
+
+	LoadPluginCache();
+
+	// look for all *.dll's, sniff the unknown ones in parallel, then open them in the usual order
+	LIST<wchar_t> arPaths(50);
+	enumPlugins(scanPluginsDir, (WPARAM)&arPaths, 0);
+	PrefetchPluginInterfaces(arPaths);
+
+	for (auto &it : arPaths) {
+		OpenPlugin(wcsrchr(it, '\\') + 1, L"Plugins", exe);
+		mir_free(it);
+	}
 
 	MuuidReplacement stdCrypt = { MIID_CRYPTO, L"stdcrypt", nullptr };
 	if (!stdCrypt.Load())
 		return 1;
 
+	SavePluginCache();
+
 	SetServiceModePlugin(_T2A(CmdLine_GetOption(L"svc")));
 	return 0;
 }
@@ -827,4 +845,6 @@ void UnloadNewPluginsModule(void)
 
 	for (auto &it : pluginList.rev_iter())
 		Plugin_Uninit(it);
+
+	UnloadPluginCache();
 }
@@ -82,3 +82,11 @@ struct MuuidReplacement
 };
 
 MUUID* GetPluginInterfaces(const wchar_t *ptszFileName, bool &bIsPlugin);
+
+// the same, but the results are taken from the plugins' cache if a dll wasn't changed
+MUUID* GetCachedPluginInterfaces(const wchar_t *ptszFileName, bool &bIsPlugin);
+void   PrefetchPluginInterfaces(const LIST<wchar_t> &arPaths);
+
+void LoadPluginCache();
+void SavePluginCache();
+void UnloadPluginCache();
@@ -56,6 +56,7 @@ typedef struct SslHandle *HSSL;
 #include <locale.h>
 
 #include <memory>
+#include <unordered_map>
 
 #define __NO_CMPLUGIN_NEEDED
 #include <newpluginapi.h>
@@ -39,14 +39,13 @@ static HANDLE hevChanged = nullptr;
 
 static BOOL bModuleInitialized = FALSE;
 
+// an entry of a text langpack, used only while a langpack is being compiled
 struct LangPackEntry
 {
 	uint32_t englishHash;
-	char *szLocal;
-	char *utfLocal;
+	int iOrder;
 	wchar_t *wszLocal;
 	MUUID *pMuuid;
-	LangPackEntry* pNext;  // for langpack items with the same hash value
 };
 
 static LANGPACK_INFO langPack;
@@ -55,6 +54,46 @@ static wchar_t g_tszRoot[MAX_PATH];
 static LangPackEntry *g_pEntries;
 static int g_entryCount, g_entriesAlloced;
 
+static LIST<wchar_t> g_arSources(5);    // files read while compiling a langpack
+
+/////////////////////////////////////////////////////////////////////////////////////////
+// compiled langpack
+// a text langpack is compiled into a binary image once and stored near it as *.lpc,
+// the next starts map that image read-only. the image contains a perfect hash table
+// on English strings' hashes and the translations in ANSI, UTF-8 and UTF-16 forms
+
+#define LPC_SIGNATURE "MirLPC\x1a"
+#define LPC_VERSION 1
+#define LPC_NONE 0xFFFFFFFF
+
+struct LPC_HEADER
+{
+	char     signature[8];
+	uint32_t dwVersion, dwCodepage, cbTotal;
+	uint32_t nFiles, offFiles;       // LPC_FILE: source files, the langpack itself goes first
+	uint32_t nMuuids, offMuuids;     // MUUID: sorted array of plugins' uuids
+	uint32_t nBuckets, offBuckets;   // uint32_t: displacements of the perfect hash
+	uint32_t nSlots, offSlots;       // uint32_t: first entry for each slot or LPC_NONE
+	uint32_t nEntries, offEntries;   // LPC_ENTRY: sorted by hash, the ones without uuid go first
+};
+
+struct LPC_FILE
+{
+	uint64_t qwSize, qwTime;
+	uint32_t offName;                // UTF-16, relative to the langpack's folder
+	uint32_t dwReserved;
+};
+
+struct LPC_ENTRY
+{
+	uint32_t dwHash, iMuuid;
+	uint32_t offA, offU, offW;
+};
+
+static const LPC_HEADER *g_pLpc;
+static HANDLE g_hLpcFile, g_hLpcMap;
+static bool g_bLpcAllocated;
+
 static int IsEmpty(const char *str)
 {
 	for (int i = 0; str[i]; i++)
@@ -133,14 +172,41 @@ MIR_CORE_DLL(unsigned int) mir_hash(const void * key, unsigned int len)
 	return h;
 }
 
+// the same as mir_hash() over low bytes of a wide string's chars, but without copying them
 static unsigned int __fastcall hashstrW(const char *key)
 {
 	if (key == nullptr) return 0;
-	const unsigned int len = (unsigned int)wcslen((const wchar_t*)key);
-	char *buf = (char*)alloca(len + 1);
-	for (unsigned i = 0; i <= len; ++i)
-		buf[i] = key[i << 1];
-	return mir_hash(buf, len);
+
+	const wchar_t *p = (const wchar_t *)key;
+	unsigned int len = (unsigned int)wcslen(p);
+
+	const unsigned int m = 0x5bd1e995;
+	const int r = 24;
+	unsigned int h = len;
+
+	for (; len >= 4; len -= 4, p += 4) {
+		unsigned int k = (p[0] & 0xFF) | ((p[1] & 0xFF) << 8) | ((p[2] & 0xFF) << 16) | ((unsigned int)(p[3] & 0xFF) << 24);
+
+		k *= m;
+		k ^= k >> r;
+		k *= m;
+
+		h *= m;
+		h ^= k;
+	}
+
+	switch (len) {
+	case 3: h ^= (p[2] & 0xFF) << 16;
+	case 2: h ^= (p[1] & 0xFF) << 8;
+	case 1: h ^= (p[0] & 0xFF);
+		h *= m;
+	}
+
+	h ^= h >> 13;
+	h *= m;
+	h ^= h >> 15;
+
+	return h;
 }
 
 static const MUUID* GetMuid(HPLUGIN pPlugin)
@@ -162,7 +228,11 @@ static int SortLangPackHashesProc(LangPackEntry *arg1, LangPackEntry *arg2)
 	if (arg1->englishHash < arg2->englishHash) return -1;
 	if (arg1->englishHash > arg2->englishHash) return 1;
 
-	return (arg1->pMuuid < arg2->pMuuid) ? -1 : 1;
+	// common translations go first, then the plugins' ones in the order of a file
+	if ((arg1->pMuuid == nullptr) != (arg2->pMuuid == nullptr))
+		return (arg1->pMuuid == nullptr) ? -1 : 1;
+
+	return arg1->iOrder - arg2->iOrder;
 }
 
 static void swapBytes(void *p, size_t iSize)
@@ -240,6 +310,8 @@ static void LoadLangPackFile(FILE *fp, char *line)
 
 				FILE *fpNew = _wfopen(tszFileName, L"r");
 				if (fpNew) {
+					g_arSources.insert(mir_wstrdup(tszFileName));
+
 					line[0] = 0;
 					fgets(line, LANGPACK_BUF_SIZE, fpNew);
 
@@ -257,9 +329,13 @@ static void LoadLangPackFile(FILE *fp, char *line)
 				if (!EnterMuuid(line + 7, t))
 					continue;
 
-				MUUID *pNew = (MUUID*)mir_alloc(sizeof(MUUID));
-				memcpy(pNew, &t, sizeof(t));
-				lMuuids.insert(pNew);
+				// the same uuid might be met in several files
+				MUUID *pNew = lMuuids.find(&t);
+				if (pNew == nullptr) {
+					pNew = (MUUID*)mir_alloc(sizeof(MUUID));
+					memcpy(pNew, &t, sizeof(t));
+					lMuuids.insert(pNew);
+				}
 				pCurrentMuuid = pNew;
 			}
 
@@ -284,10 +360,9 @@ static void LoadLangPackFile(FILE *fp, char *line)
 
 			LangPackEntry *E = &g_pEntries[g_entryCount - 1];
 			E->englishHash = mir_hashstr(pszLine);
-			E->szLocal = E->utfLocal = nullptr;
+			E->iOrder = g_entryCount;
 			E->wszLocal = nullptr;
 			E->pMuuid = pCurrentMuuid;
-			E->pNext = nullptr;
 			continue;
 		}
 
@@ -388,6 +463,327 @@ static int LoadLangDescr(LANGPACK_INFO &lpinfo, FILE *fp, char *line, int &start
 	return 0;
 }
 
+/////////////////////////////////////////////////////////////////////////////////////////
+// langpack compiler
+
+static uint32_t __forceinline LpcMix(uint32_t k, uint32_t seed)
+{
+	k ^= seed * 0x9E3779B1;
+	k ^= k >> 16;
+	k *= 0x85EBCA6B;
+	k ^= k >> 13;
+	k *= 0xC2B2AE35;
+	k ^= k >> 16;
+	return k;
+}
+
+static bool GetFileStamp(const wchar_t *pwszFile, uint64_t &qwSize, uint64_t &qwTime)
+{
+	WIN32_FILE_ATTRIBUTE_DATA fad;
+	if (!GetFileAttributesExW(pwszFile, GetFileExInfoStandard, &fad))
+		return false;
+
+	qwSize = (uint64_t(fad.nFileSizeHigh) << 32) + fad.nFileSizeLow;
+	qwTime = (uint64_t(fad.ftLastWriteTime.dwHighDateTime) << 32) + fad.ftLastWriteTime.dwLowDateTime;
+	return true;
+}
+
+static uint32_t LpcAddString(MBinBuffer &pool, const void *pData, size_t cbLen, size_t cbAlign)
+{
+	if (pool.length() % cbAlign) {
+		uint32_t dwZero = 0;
+		pool.append(&dwZero, cbAlign - pool.length() % cbAlign);
+	}
+
+	uint32_t res = (uint32_t)pool.length();
+	pool.append(pData, cbLen);
+	return res;
+}
+
+// builds the hash & displace table: each key of a bucket gets its slot from LpcMix(key, d+1),
+// the smallest d that puts all keys of a bucket into free slots is stored for the bucket
+
+static bool LpcPlaceBucket(const uint32_t *pKeys, const uint32_t *pMembers, uint32_t nMembers, uint32_t nSlots, uint32_t *pSlots, uint32_t *pTemp, uint32_t &dwDisp)
+{
+	for (uint32_t d = 0; d < 0x100000; d++) {
+		uint32_t j;
+		for (j = 0; j < nMembers; j++) {
+			uint32_t slot = LpcMix(pKeys[pMembers[j]], d + 1) % nSlots;
+			if (pSlots[slot] != LPC_NONE)
+				break;
+
+			// keys of the same bucket must not collide too
+			pSlots[slot] = pMembers[j];
+			pTemp[j] = slot;
+		}
+
+		if (j == nMembers) {
+			dwDisp = d;
+			return true;
+		}
+
+		while (j-- > 0)
+			pSlots[pTemp[j]] = LPC_NONE;
+	}
+	return false;
+}
+
+static bool LpcBuildTable(const uint32_t *pKeys, uint32_t nKeys, uint32_t nBuckets, uint32_t nSlots, uint32_t *pDisp, uint32_t *pSlots)
+{
+	uint32_t *pStart = (uint32_t *)mir_calloc((nBuckets + 1) * sizeof(uint32_t));
+	uint32_t *pMembers = (uint32_t *)mir_alloc(nKeys * sizeof(uint32_t) + 1);
+	uint32_t *pTemp = (uint32_t *)mir_alloc((max(nKeys, nBuckets) + 1) * sizeof(uint32_t));
+
+	// group keys by buckets
+	for (uint32_t i = 0; i < nKeys; i++)
+		pStart[LpcMix(pKeys[i], 0) % nBuckets + 1]++;
+	for (uint32_t i = 0; i < nBuckets; i++)
+		pStart[i + 1] += pStart[i];
+
+	memcpy(pTemp, pStart, nBuckets * sizeof(uint32_t));
+	for (uint32_t i = 0; i < nKeys; i++)
+		pMembers[pTemp[LpcMix(pKeys[i], 0) % nBuckets]++] = i;
+
+	uint32_t nMaxMembers = 0;
+	for (uint32_t i = 0; i < nBuckets; i++) {
+		pDisp[i] = 0;
+		nMaxMembers = max(nMaxMembers, pStart[i + 1] - pStart[i]);
+	}
+
+	for (uint32_t i = 0; i < nSlots; i++)
+		pSlots[i] = LPC_NONE;
+
+	// the biggest buckets are placed first, while there're many free slots
+	bool bSuccess = true;
+	for (uint32_t nMembers = nMaxMembers; nMembers > 0 && bSuccess; nMembers--)
+		for (uint32_t b = 0; b < nBuckets && bSuccess; b++)
+			if (pStart[b + 1] - pStart[b] == nMembers)
+				bSuccess = LpcPlaceBucket(pKeys, pMembers + pStart[b], nMembers, nSlots, pSlots, pTemp, pDisp[b]);
+
+	mir_free(pStart);
+	mir_free(pMembers);
+	mir_free(pTemp);
+	return bSuccess;
+}
+
+static bool MapCompiledLangPack(const wchar_t *pwszCompiled);
+
+static void CompileLangPack(const wchar_t *pwszCompiled)
+{
+	// the last entry might have no translation
+	if (g_entryCount && g_pEntries[g_entryCount - 1].wszLocal == nullptr)
+		g_entryCount--;
+
+	qsort(g_pEntries, g_entryCount, sizeof(LangPackEntry), (int(*)(const void*, const void*))SortLangPackHashesProc);
+
+	// entries with the same hash go one after another, the first one is pointed by a slot
+	uint32_t nKeys = 0;
+	uint32_t *pKeys = (uint32_t *)mir_alloc(g_entryCount * sizeof(uint32_t) + 1);
+	uint32_t *pFirst = (uint32_t *)mir_alloc(g_entryCount * sizeof(uint32_t) + 1);
+	for (int i = 0; i < g_entryCount; i++) {
+		if (i == 0 || g_pEntries[i].englishHash != g_pEntries[i - 1].englishHash) {
+			pKeys[nKeys] = g_pEntries[i].englishHash;
+			pFirst[nKeys++] = i;
+		}
+	}
+
+	uint32_t nBuckets = nKeys / 4 + 1, nSlots = nKeys + nKeys / 4 + 1;
+	uint32_t *pDisp = (uint32_t *)mir_alloc(nBuckets * sizeof(uint32_t));
+	uint32_t *pSlots = (uint32_t *)mir_alloc(nSlots * sizeof(uint32_t));
+	while (!LpcBuildTable(pKeys, nKeys, nBuckets, nSlots, pDisp, pSlots)) {
+		nSlots += nSlots / 8 + 1;
+		pSlots = (uint32_t *)mir_realloc(pSlots, nSlots * sizeof(uint32_t));
+	}
+
+	for (uint32_t i = 0; i < nSlots; i++)
+		if (pSlots[i] != LPC_NONE)
+			pSlots[i] = pFirst[pSlots[i]];
+
+	// strings & file names
+	MBinBuffer pool;
+	LPC_FILE *pFiles = (LPC_FILE *)mir_calloc(g_arSources.getCount() * sizeof(LPC_FILE) + 1);
+	size_t cbRoot = wcsrchr(langPack.tszFullPath, '\\') - langPack.tszFullPath + 1;
+	for (int i = 0; i < g_arSources.getCount(); i++) {
+		const wchar_t *pwszName = g_arSources[i];
+		GetFileStamp(pwszName, pFiles[i].qwSize, pFiles[i].qwTime);
+		if (!wcsnicmp(pwszName, langPack.tszFullPath, cbRoot))
+			pwszName += cbRoot;
+		pFiles[i].offName = LpcAddString(pool, pwszName, (wcslen(pwszName) + 1) * sizeof(wchar_t), sizeof(wchar_t));
+	}
+
+	LPC_ENTRY *pEntries = (LPC_ENTRY *)mir_alloc(g_entryCount * sizeof(LPC_ENTRY) + 1);
+	for (int i = 0; i < g_entryCount; i++) {
+		LangPackEntry &E = g_pEntries[i];
+		LPC_ENTRY &D = pEntries[i];
+		D.dwHash = E.englishHash;
+		D.iMuuid = (E.pMuuid == nullptr) ? LPC_NONE : lMuuids.getIndex(E.pMuuid);
+		D.offW = LpcAddString(pool, E.wszLocal, (wcslen(E.wszLocal) + 1) * sizeof(wchar_t), sizeof(wchar_t));
+
+		ptrA szUtf(mir_utf8encodeW(E.wszLocal));
+		D.offU = LpcAddString(pool, szUtf, strlen(szUtf) + 1, 1);
+
+		ptrA szAnsi(mir_u2a_cp(E.wszLocal, langPack.codepage));
+		D.offA = LpcAddString(pool, szAnsi, strlen(szAnsi) + 1, 1);
+	}
+
+	// image itself
+	LPC_HEADER hdr = {};
+	memcpy(hdr.signature, LPC_SIGNATURE, sizeof(hdr.signature));
+	hdr.dwVersion = LPC_VERSION;
+	hdr.dwCodepage = langPack.codepage;
+	hdr.nFiles = g_arSources.getCount();
+	hdr.offFiles = sizeof(hdr);
+	hdr.nMuuids = lMuuids.getCount();
+	hdr.offMuuids = hdr.offFiles + hdr.nFiles * sizeof(LPC_FILE);
+	hdr.nBuckets = nBuckets;
+	hdr.offBuckets = hdr.offMuuids + hdr.nMuuids * sizeof(MUUID);
+	hdr.nSlots = nSlots;
+	hdr.offSlots = hdr.offBuckets + nBuckets * sizeof(uint32_t);
+	hdr.nEntries = g_entryCount;
+	hdr.offEntries = hdr.offSlots + nSlots * sizeof(uint32_t);
+
+	uint32_t offPool = hdr.offEntries + g_entryCount * sizeof(LPC_ENTRY);
+	hdr.cbTotal = offPool + (uint32_t)pool.length();
+	for (uint32_t i = 0; i < hdr.nFiles; i++)
+		pFiles[i].offName += offPool;
+	for (int i = 0; i < g_entryCount; i++) {
+		pEntries[i].offW += offPool;
+		pEntries[i].offU += offPool;
+		pEntries[i].offA += offPool;
+	}
+
+	MBinBuffer image;
+	image.append(&hdr, sizeof(hdr));
+	image.append(pFiles, hdr.nFiles * sizeof(LPC_FILE));
+	for (auto &it : lMuuids)
+		image.append(it, sizeof(MUUID));
+	image.append(pDisp, nBuckets * sizeof(uint32_t));
+	image.append(pSlots, nSlots * sizeof(uint32_t));
+	image.append(pEntries, g_entryCount * sizeof(LPC_ENTRY));
+	image.append(pool.data(), pool.length());
+
+	mir_free(pKeys);
+	mir_free(pFirst);
+	mir_free(pDisp);
+	mir_free(pSlots);
+	mir_free(pFiles);
+	mir_free(pEntries);
+
+	for (int i = 0; i < g_entryCount; i++)
+		mir_free(g_pEntries[i].wszLocal);
+	mir_free(g_pEntries);
+	g_pEntries = nullptr;
+	g_entryCount = g_entriesAlloced = 0;
+
+	// save it via a temporary file, another instance might be reading the old one
+	wchar_t wszTemp[MAX_PATH];
+	mir_snwprintf(wszTemp, L"%s.%u", pwszCompiled, GetCurrentProcessId());
+
+	bool bSaved = false;
+	FILE *out = _wfopen(wszTemp, L"wb");
+	if (out) {
+		bSaved = fwrite(image.data(), 1, image.length(), out) == image.length();
+		fclose(out);
+
+		if (!bSaved || !MoveFileExW(wszTemp, pwszCompiled, MOVEFILE_REPLACE_EXISTING)) {
+			DeleteFileW(wszTemp);
+			bSaved = false;
+		}
+	}
+
+	// a folder might be read-only, then we simply keep the image in memory
+	if (!bSaved || !MapCompiledLangPack(pwszCompiled)) {
+		void *pImage = mir_alloc(image.length());
+		memcpy(pImage, image.data(), image.length());
+		g_pLpc = (const LPC_HEADER *)pImage;
+		g_bLpcAllocated = true;
+	}
+}
+
+static bool CheckCompiledLangPack(const LPC_HEADER *pLpc, uint32_t cbSize)
+{
+	if (cbSize < sizeof(LPC_HEADER) || memcmp(pLpc->signature, LPC_SIGNATURE, sizeof(pLpc->signature)))
+		return false;
+
+	if (pLpc->dwVersion != LPC_VERSION || pLpc->cbTotal != cbSize || pLpc->dwCodepage != langPack.codepage)
+		return false;
+
+	if (pLpc->nFiles == 0 || pLpc->nBuckets == 0 || pLpc->nSlots == 0)
+		return false;
+
+	uint64_t cbTables = uint64_t(pLpc->offEntries) + uint64_t(pLpc->nEntries) * sizeof(LPC_ENTRY);
+	if (pLpc->offMuuids < pLpc->offFiles + uint64_t(pLpc->nFiles) * sizeof(LPC_FILE) || pLpc->offBuckets < pLpc->offMuuids + uint64_t(pLpc->nMuuids) * sizeof(MUUID)
+		|| pLpc->offSlots < pLpc->offBuckets + uint64_t(pLpc->nBuckets) * 4 || pLpc->offEntries < pLpc->offSlots + uint64_t(pLpc->nSlots) * 4 || cbTables > cbSize)
+		return false;
+
+	// all source files must be the same
+	wchar_t wszRoot[MAX_PATH];
+	wcsncpy_s(wszRoot, langPack.tszFullPath, _TRUNCATE);
+	wchar_t *p = wcsrchr(wszRoot, '\\');
+	if (p)
+		p[1] = 0;
+
+	const LPC_FILE *pFiles = (const LPC_FILE *)((const char *)pLpc + pLpc->offFiles);
+	for (uint32_t i = 0; i < pLpc->nFiles; i++) {
+		if (pFiles[i].offName >= cbSize)
+			return false;
+
+		wchar_t wszFile[MAX_PATH];
+		const wchar_t *pwszName = (const wchar_t *)((const char *)pLpc + pFiles[i].offName);
+		mir_snwprintf(wszFile, L"%s%.*s", wszRoot, int((cbSize - pFiles[i].offName) / sizeof(wchar_t)), pwszName);
+
+		uint64_t qwSize, qwTime;
+		if (!GetFileStamp(wszFile, qwSize, qwTime) || qwSize != pFiles[i].qwSize || qwTime != pFiles[i].qwTime)
+			return false;
+	}
+
+	return true;
+}
+
+static bool MapCompiledLangPack(const wchar_t *pwszCompiled)
+{
+	HANDLE hFile = CreateFileW(pwszCompiled, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (hFile == INVALID_HANDLE_VALUE)
+		return false;
+
+	DWORD cbSize = GetFileSize(hFile, nullptr);
+	HANDLE hMap = (cbSize == INVALID_FILE_SIZE || cbSize == 0) ? nullptr : CreateFileMappingW(hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	const LPC_HEADER *pLpc = (hMap == nullptr) ? nullptr : (const LPC_HEADER *)MapViewOfFile(hMap, FILE_MAP_READ, 0, 0, 0);
+	if (pLpc == nullptr || !CheckCompiledLangPack(pLpc, cbSize)) {
+		if (pLpc)
+			UnmapViewOfFile(pLpc);
+		if (hMap)
+			CloseHandle(hMap);
+		CloseHandle(hFile);
+		return false;
+	}
+
+	g_pLpc = pLpc;
+	g_hLpcFile = hFile;
+	g_hLpcMap = hMap;
+	return true;
+}
+
+static void UnloadCompiledLangPack()
+{
+	if (g_pLpc == nullptr)
+		return;
+
+	if (g_bLpcAllocated)
+		mir_free((void *)g_pLpc);
+	else {
+		UnmapViewOfFile(g_pLpc);
+		CloseHandle(g_hLpcMap);
+		CloseHandle(g_hLpcFile);
+	}
+
+	g_pLpc = nullptr;
+	g_hLpcFile = g_hLpcMap = nullptr;
+	g_bLpcAllocated = false;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////
+
 MIR_CORE_DLL(int) LoadLangPack(const wchar_t *ptszLangPack)
 {
 	if (ptszLangPack == nullptr || !mir_wstrcmpi(ptszLangPack, L""))
@@ -405,7 +801,7 @@ MIR_CORE_DLL(int) LoadLangPack(const wchar_t *ptszLangPack)
 		return 0;
 
 	// ok... loading a new langpack. remove the old one if needed
-	if (g_entryCount)
+	if (g_pLpc)
 		UnloadLangPackModule();
 
 	langPack.Locale = 0;
@@ -434,14 +830,28 @@ MIR_CORE_DLL(int) LoadLangPack(const wchar_t *ptszLangPack)
 		return 1;
 	}
 
+	// compiled langpack is up to date? use it
+	wchar_t wszCompiled[MAX_PATH];
+	wcsncpy_s(wszCompiled, tszFullPath, _TRUNCATE);
+	if (wchar_t *pExt = wcsrchr(wszCompiled, '.'))
+		if (!wcschr(pExt, '\\'))
+			*pExt = 0;
+	wcsncat_s(wszCompiled, L".lpc", _TRUNCATE);
+
+	if (MapCompiledLangPack(wszCompiled)) {
+		fclose(fp);
+		return 0;
+	}
+
 	// body
 	fseek(fp, startOfLine, SEEK_SET);
 
+	g_arSources.insert(mir_wstrdup(tszFullPath));
 	LoadLangPackFile(fp, line);
 	fclose(fp);
 	pCurrentMuuid = nullptr;
 
-	qsort(g_pEntries, g_entryCount, sizeof(LangPackEntry), (int(*)(const void*, const void*))SortLangPackHashesProc);
+	CompileLangPack(wszCompiled);
 	return 0;
 }
 
@@ -468,47 +878,47 @@ MIR_CORE_DLL(int) LoadLangPackDescr(const wchar_t *ptszLangPack, LANGPACK_INFO *
 
 /////////////////////////////////////////////////////////////////////////////////////////
 
-static int SortLangPackHashesProc2(LangPackEntry *arg1, LangPackEntry *arg2)
-{
-	if (arg1->englishHash < arg2->englishHash) return -1;
-	if (arg1->englishHash > arg2->englishHash) return 1;
-	return 0;
-}
-
 char* LangPackTranslateString(const MUUID *pUuid, const char *szEnglish, const int W)
 {
-	if (g_entryCount == 0 || szEnglish == nullptr)
+	const LPC_HEADER *pLpc = g_pLpc;
+	if (pLpc == nullptr || szEnglish == nullptr)
 		return (char*)szEnglish;
 
-	LangPackEntry key, *entry;
-	key.englishHash = (W == 1) ? hashstrW(szEnglish) : mir_hashstr(szEnglish);
-	entry = (LangPackEntry*)bsearch(&key, g_pEntries, g_entryCount, sizeof(LangPackEntry), (int(*)(const void*, const void*))SortLangPackHashesProc2);
-	if (entry == nullptr)
+	const char *pBase = (const char *)pLpc;
+	const uint32_t *pDisp = (const uint32_t *)(pBase + pLpc->offBuckets);
+	const uint32_t *pSlots = (const uint32_t *)(pBase + pLpc->offSlots);
+	const LPC_ENTRY *pEntries = (const LPC_ENTRY *)(pBase + pLpc->offEntries);
+
+	uint32_t dwHash = (W == 1) ? hashstrW(szEnglish) : mir_hashstr(szEnglish);
+	uint32_t idx = pSlots[LpcMix(dwHash, pDisp[LpcMix(dwHash, 0) % pLpc->nBuckets] + 1) % pLpc->nSlots];
+	if (idx == LPC_NONE || pEntries[idx].dwHash != dwHash)
 		return (char*)szEnglish;
 
 	// try to find the exact match, otherwise the first entry will be returned
-	if (pUuid) {
-		for (LangPackEntry *p = entry->pNext; p != nullptr; p = p->pNext) {
-			if (p->pMuuid && *p->pMuuid == *pUuid) {
-				entry = p;
-				break;
+	const LPC_ENTRY *entry = pEntries + idx;
+	if (pUuid && idx + 1 < pLpc->nEntries && entry[1].dwHash == dwHash) {
+		const MUUID *pMuuids = (const MUUID *)(pBase + pLpc->offMuuids);
+		const MUUID *pFound = (const MUUID *)bsearch(pUuid, pMuuids, pLpc->nMuuids, sizeof(MUUID), (int(*)(const void*, const void*))CompareMuuids);
+		if (pFound != nullptr) {
+			uint32_t iMuuid = uint32_t(pFound - pMuuids);
+			for (uint32_t i = idx; i < pLpc->nEntries && pEntries[i].dwHash == dwHash; i++) {
+				if (pEntries[i].iMuuid == iMuuid) {
+					entry = pEntries + i;
+					break;
+				}
 			}
 		}
 	}
 
 	switch (W) {
 	case 0:
-		if (entry->szLocal == nullptr && entry->wszLocal != nullptr)
-			entry->szLocal = mir_u2a_cp(entry->wszLocal, langPack.codepage);
-		return entry->szLocal;
+		return (char*)pBase + entry->offA;
 
 	case 1:
-		return (char*)entry->wszLocal;
+		return (char*)pBase + entry->offW;
 
 	case 2:
-		if (entry->utfLocal == nullptr && entry->wszLocal != nullptr)
-			entry->utfLocal = mir_utf8encodeW(entry->wszLocal);
-		return entry->utfLocal;
+		return (char*)pBase + entry->offU;
 	}
 
 	return nullptr;
@@ -615,36 +1025,9 @@ MIR_CORE_DLL(void) TranslateDialog_LP(HWND hDlg, HPLUGIN pPlugin)
 
 /////////////////////////////////////////////////////////////////////////////////////////
 
+// duplicates are grouped when a langpack is compiled, nothing to do here anymore
 MIR_CORE_DLL(void) Langpack_SortDuplicates(void)
 {
-	if (g_entryCount == 0)
-		return;
-
-	LangPackEntry *s = g_pEntries + 1, *d = s, *pLast = g_pEntries;
-	uint32_t dwSavedHash = g_pEntries->englishHash;
-	bool bSortNeeded = false;
-
-	for (int i = 1; i < g_entryCount; i++, s++) {
-		if (s->englishHash != dwSavedHash) {
-			pLast = d;
-			if (s != d)
-				*d++ = *s;
-			else
-				d++;
-			dwSavedHash = s->englishHash;
-		}
-		else {
-			bSortNeeded = true;
-			LangPackEntry *p = (LangPackEntry*)mir_alloc(sizeof(LangPackEntry));
-			*p = *s;
-			pLast->pNext = p; pLast = p;
-		}
-	}
-
-	if (bSortNeeded) {
-		g_entryCount = (int)(d - g_pEntries);
-		qsort(g_pEntries, g_entryCount, sizeof(LangPackEntry), (int(*)(const void*, const void*))SortLangPackHashesProc);
-	}
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////
@@ -740,26 +1123,11 @@ void UnloadLangPackModule()
 		mir_free(it);
 	lMuuids.destroy();
 
-	LangPackEntry *p = g_pEntries;
-	for (int i = 0; i < g_entryCount; i++, p++) {
-		if (p->pNext != nullptr) {
-			for (LangPackEntry *p1 = p->pNext; p1 != nullptr;) {
-				LangPackEntry *p2 = p1; p1 = p1->pNext;
-				mir_free(p2->szLocal);
-				mir_free(p2->wszLocal);
-				mir_free(p2);
-			}
-		}
-
-		mir_free(p->szLocal);
-		mir_free(p->wszLocal);
-	}
+	for (auto &it : g_arSources)
+		mir_free(it);
+	g_arSources.destroy();
 
-	if (g_entryCount) {
-		mir_free(g_pEntries);
-		g_pEntries = nullptr;
-		g_entryCount = g_entriesAlloced = 0;
-	}
+	UnloadCompiledLangPack();
 
 	langPack.tszFileName[0] = langPack.tszFullPath[0] = 0;
 }
@@ -0,0 +1,563 @@
+/*
+
+Miranda NG: the free IM client for Microsoft* Windows*
+
+Copyright (C) 2012-22 Miranda NG team (https://miranda-ng.org)
+all portions of this codebase are copyrighted to the people
+listed in contributors.txt.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+
+#include "../stdafx.h"
+
+/////////////////////////////////////////////////////////////////////////////////////////
+// shared thread pool for short background jobs
+//
+// each worker has its own deque: tasks submitted from a worker go there and are taken
+// back in LIFO order, idle workers steal from the other end. tasks submitted from the
+// other threads, and all high/low priority tasks, go to the global queues
+
+#define TASK_QUEUED    0
+#define TASK_RUNNING   1
+#define TASK_DONE      2
+#define TASK_CANCELLED 3
+
+#define MAX_WORKERS      64
+#define IDLE_TIMEOUT  30000 // extra workers exit after being idle that long
+#define START_DELAY     500 // extra workers are added not faster than one per that period
+
+struct MTask : public MZeroedObject
+{
+	MTask(pThreadFunc _func, void *_arg, void *_owner, int _prio) :
+		pFunc(_func),
+		arg(_arg),
+		pOwner(_owner),
+		iPriority(_prio),
+		lRefCount(1) // reference owned by a queue
+	{}
+
+	~MTask()
+	{
+		if (hDone)
+			CloseHandle(hDone);
+		delete pNext;
+	}
+
+	pThreadFunc pFunc;
+	void *arg, *pOwner;
+	int iPriority, iState;
+	bool bCancelled;
+	volatile long lRefCount;
+	HANDLE hDone;       // manual-reset event, exists only for tasks with a handle
+	LIST<MTask> *pNext; // continuations
+	MTask *pOuter;      // a task of the same worker, suspended in Task_Wait while this one runs
+};
+
+static void ReleaseTask(MTask *p)
+{
+	if (InterlockedDecrement(&p->lRefCount) == 0)
+		delete p;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////
+// ring buffer of tasks
+
+class CTaskDeque
+{
+	MTask **m_items = nullptr;
+	int m_head = 0, m_count = 0, m_size = 0;
+
+public:
+	mir_cs m_cs;
+
+	~CTaskDeque()
+	{
+		mir_free(m_items);
+	}
+
+	__forceinline int getCount() const { return m_count; }
+
+	void push(MTask *p)
+	{
+		mir_cslock lck(m_cs);
+		if (m_count == m_size) {
+			int newSize = (m_size == 0) ? 32 : m_size * 2;
+			MTask **newItems = (MTask **)mir_alloc(newSize * sizeof(MTask *));
+			for (int i = 0; i < m_count; i++)
+				newItems[i] = m_items[(m_head + i) % m_size];
+
+			mir_free(m_items);
+			m_items = newItems;
+			m_size = newSize;
+			m_head = 0;
+		}
+
+		m_items[(m_head + m_count) % m_size] = p;
+		m_count++;
+	}
+
+	// a popped task is stored into *ppClaim under the same lock, so that
+	// Task_CancelOwner() always finds it either in a queue or in a worker
+
+	MTask* popHead(MTask **ppClaim = nullptr)
+	{
+		if (m_count == 0)
+			return nullptr;
+
+		mir_cslock lck(m_cs);
+		if (m_count == 0)
+			return nullptr;
+
+		MTask *p = m_items[m_head];
+		m_head = (m_head + 1) % m_size;
+		m_count--;
+		if (ppClaim)
+			*ppClaim = p;
+		return p;
+	}
+
+	MTask* popTail(MTask **ppClaim = nullptr)
+	{
+		if (m_count == 0)
+			return nullptr;
+
+		mir_cslock lck(m_cs);
+		if (m_count == 0)
+			return nullptr;
+
+		m_count--;
+		MTask *p = m_items[(m_head + m_count) % m_size];
+		if (ppClaim)
+			*ppClaim = p;
+		return p;
+	}
+
+	// moves all tasks of the owner into the list, keeps the order of the rest
+	void extract(void *pOwner, LIST<MTask> &dest)
+	{
+		mir_cslock lck(m_cs);
+
+		int j = 0;
+		for (int i = 0; i < m_count; i++) {
+			MTask *p = m_items[(m_head + i) % m_size];
+			if (p->pOwner == pOwner)
+				dest.insert(p);
+			else
+				m_items[(m_head + j++) % m_size] = p;
+		}
+		m_count = j;
+	}
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////
+
+struct MWorker
+{
+	MWorker(int _idx) :
+		idx(_idx)
+	{}
+
+	CTaskDeque deque;
+	MTask *pCurrent = nullptr; // the innermost running task, the others are linked by pOuter
+	MTask *pClaimed = nullptr; // popped from a queue, but not started yet
+	int idx;
+	bool bActive = false;
+};
+
+static mir_cs csTasks; // protects tasks' states & continuations, workers' list
+static CTaskDeque g_queues[TASK_PRIORITY_HIGH + 1];
+static MWorker *g_workers[MAX_WORKERS];
+static HANDLE g_hSemaphore;
+static int g_nCoreWorkers, g_nMaxWorkers;
+static uint32_t g_dwLastStart;
+static volatile long g_nWorkers, g_nIdle;
+
+static __declspec(thread) MWorker *tls_pWorker;
+
+static MTask* FindTask(MWorker *w)
+{
+	MTask **ppClaim = &w->pClaimed;
+
+	MTask *p = g_queues[TASK_PRIORITY_HIGH].popHead(ppClaim);
+	if (p == nullptr)
+		p = w->deque.popTail(ppClaim);
+	if (p == nullptr)
+		p = g_queues[TASK_PRIORITY_NORMAL].popHead(ppClaim);
+
+	if (p == nullptr) {
+		for (int i = 0; i < MAX_WORKERS && p == nullptr; i++) {
+			MWorker *victim = g_workers[(w->idx + 1 + i) % MAX_WORKERS];
+			if (victim != nullptr && victim != w)
+				p = victim->deque.popHead(ppClaim);
+		}
+	}
+
+	if (p == nullptr)
+		p = g_queues[TASK_PRIORITY_LOW].popHead(ppClaim);
+	return p;
+}
+
+static void SubmitTask(MTask *p);
+
+static void CompleteTask(MTask *p, int iState)
+{
+	LIST<MTask> *pNext;
+	{
+		mir_cslock lck(csTasks);
+		p->iState = iState;
+		pNext = p->pNext; p->pNext = nullptr;
+		if (p->hDone)
+			SetEvent(p->hDone);
+	}
+
+	if (pNext) {
+		// continuations of the cancelled tasks are cancelled too
+		bool bRun = (iState == TASK_DONE && !p->bCancelled);
+		for (auto &it : *pNext) {
+			if (bRun)
+				SubmitTask(it);
+			else
+				CompleteTask(it, TASK_CANCELLED);
+		}
+		delete pNext;
+	}
+
+	ReleaseTask(p);
+}
+
+// all queued tasks are completed as cancelled, so that nobody waits for them forever
+static void DrainTasks()
+{
+	for (auto &it : g_queues)
+		while (MTask *p = it.popHead())
+			CompleteTask(p, TASK_CANCELLED);
+
+	for (auto &w : g_workers)
+		if (w != nullptr)
+			while (MTask *p = w->deque.popHead())
+				CompleteTask(p, TASK_CANCELLED);
+}
+
+static void RunTask(MWorker *w, MTask *p)
+{
+	MTask *pPrev = w->pCurrent; // Task_Wait might call us recursively
+	bool bRun;
+	{
+		mir_cslock lck(csTasks);
+		w->pClaimed = nullptr;
+		if (p->iState != TASK_QUEUED) {
+			ReleaseTask(p);
+			return;
+		}
+
+		// its owner could be cancelled after the task had been claimed
+		bRun = !p->bCancelled;
+		if (bRun) {
+			p->iState = TASK_RUNNING;
+			p->pOuter = pPrev;
+			w->pCurrent = p;
+		}
+	}
+
+	if (!bRun) {
+		CompleteTask(p, TASK_CANCELLED);
+		return;
+	}
+
+	p->pFunc(p->arg);
+
+	{
+		mir_cslock lck(csTasks);
+		w->pCurrent = pPrev;
+		p->pOuter = nullptr;
+	}
+	CompleteTask(p, TASK_DONE);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////
+
+static void __cdecl TaskWorker(void *param)
+{
+	MWorker *w = (MWorker *)param;
+	tls_pWorker = w;
+	Thread_SetName("Task pool worker");
+
+	// the semaphore's count isn't exact, so a worker can be woken up for nothing many times.
+	// that's why the idle time is counted from the last task, not from the last wakeup
+	uint32_t dwIdleSince = GetTickCount();
+	while (!Miranda_IsTerminated()) {
+		if (MTask *p = FindTask(w)) {
+			RunTask(w, p);
+			dwIdleSince = GetTickCount();
+			continue;
+		}
+
+		uint32_t dwIdle = GetTickCount() - dwIdleSince;
+		if (dwIdle >= IDLE_TIMEOUT) {
+			mir_cslock lck(csTasks);
+			if (g_nWorkers > g_nCoreWorkers && w->deque.getCount() == 0) {
+				w->bActive = false;
+				g_nWorkers--;
+				return;
+			}
+
+			dwIdleSince = GetTickCount();
+			dwIdle = 0;
+		}
+
+		InterlockedIncrement(&g_nIdle);
+		WaitForSingleObjectEx(g_hSemaphore, IDLE_TIMEOUT - dwIdle, TRUE);
+		InterlockedDecrement(&g_nIdle);
+	}
+
+	DrainTasks();
+
+	mir_cslock lck(csTasks);
+	w->bActive = false;
+	g_nWorkers--;
+}
+
+static void StartWorker()
+{
+	mir_cslock lck(csTasks);
+	if (g_nWorkers >= g_nMaxWorkers)
+		return;
+
+	// a burst of tasks shouldn't bring up all workers at once, the busy ones might finish soon
+	uint32_t dwNow = GetTickCount();
+	if (g_nWorkers >= g_nCoreWorkers && dwNow - g_dwLastStart < START_DELAY)
+		return;
+
+	g_dwLastStart = dwNow;
+	for (int i = 0; i < MAX_WORKERS; i++) {
+		MWorker *&w = g_workers[i];
+		if (w == nullptr)
+			w = new MWorker(i);
+		else if (w->bActive)
+			continue;
+
+		w->bActive = true;
+		g_nWorkers++;
+		mir_forkthread(TaskWorker, w);
+		return;
+	}
+}
+
+static void InitTasks()
+{
+	mir_cslock lck(csTasks);
+	if (g_hSemaphore != nullptr)
+		return;
+
+	SYSTEM_INFO si;
+	GetSystemInfo(&si);
+	g_nCoreWorkers = max(2, (int)si.dwNumberOfProcessors);
+	g_nMaxWorkers = min(MAX_WORKERS, g_nCoreWorkers * 4);
+	g_hSemaphore = CreateSemaphore(nullptr, 0, MAXLONG, nullptr);
+}
+
+static void SubmitTask(MTask *p)
+{
+	// continuations might be submitted at exit, when the workers are gone
+	if (Miranda_IsTerminated()) {
+		CompleteTask(p, TASK_CANCELLED);
+		return;
+	}
+
+	// normal priority tasks spawned by a task stay with their worker
+	MWorker *w = tls_pWorker;
+	if (w != nullptr && p->iPriority == TASK_PRIORITY_NORMAL)
+		w->deque.push(p);
+	else
+		g_queues[p->iPriority].push(p);
+
+	ReleaseSemaphore(g_hSemaphore, 1, nullptr);
+
+	// the workers might have already drained the queues
+	if (Miranda_IsTerminated()) {
+		DrainTasks();
+		return;
+	}
+
+	// nobody is waiting, the workers might be blocked by long tasks
+	if (g_nIdle == 0 && g_nWorkers < g_nMaxWorkers)
+		StartWorker();
+}
+
+static MTask* CreateTask(pThreadFunc aFunc, void *arg, void *owner, int iPriority)
+{
+	if (aFunc == nullptr || Miranda_IsTerminated())
+		return nullptr;
+
+	if (g_hSemaphore == nullptr)
+		InitTasks();
+
+	if (iPriority < TASK_PRIORITY_LOW || iPriority > TASK_PRIORITY_HIGH)
+		iPriority = TASK_PRIORITY_NORMAL;
+
+	return new MTask(aFunc, arg, owner, iPriority);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////
+
+MIR_CORE_DLL(int) mir_forktask(pThreadFunc aFunc, void *arg, void *owner, int iPriority)
+{
+	MTask *p = CreateTask(aFunc, arg, owner, iPriority);
+	if (p == nullptr)
+		return 0;
+
+	SubmitTask(p);
+	return 1;
+}
+
+MIR_CORE_DLL(HANDLE) Task_Create(pThreadFunc aFunc, void *arg, void *owner, int iPriority)
+{
+	MTask *p = CreateTask(aFunc, arg, owner, iPriority);
+	if (p == nullptr)
+		return nullptr;
+
+	p->lRefCount = 2; // the second reference is owned by a caller
+	p->hDone = CreateEvent(nullptr, TRUE, FALSE, nullptr);
+	SubmitTask(p);
+	return p;
+}
+
+MIR_CORE_DLL(HANDLE) Task_Then(HANDLE hTask, pThreadFunc aFunc, void *arg)
+{
+	MTask *pPrev = (MTask *)hTask;
+	if (pPrev == nullptr)
+		return nullptr;
+
+	MTask *p = CreateTask(aFunc, arg, pPrev->pOwner, pPrev->iPriority);
+	if (p == nullptr)
+		return nullptr;
+
+	p->lRefCount = 2;
+	p->hDone = CreateEvent(nullptr, TRUE, FALSE, nullptr);
+
+	int iState;
+	{
+		mir_cslock lck(csTasks);
+		iState = pPrev->iState;
+		if (iState == TASK_QUEUED || iState == TASK_RUNNING) {
+			if (pPrev->pNext == nullptr)
+				pPrev->pNext = new LIST<MTask>(1);
+			pPrev->pNext->insert(p);
+			return p;
+		}
+	}
+
+	if (iState == TASK_DONE && !pPrev->bCancelled)
+		SubmitTask(p);
+	else
+		CompleteTask(p, TASK_CANCELLED);
+	return p;
+}
+
+MIR_CORE_DLL(int) Task_Wait(HANDLE hTask, uint32_t dwTimeout)
+{
+	MTask *p = (MTask *)hTask;
+	if (p == nullptr || p->hDone == nullptr)
+		return WAIT_FAILED;
+
+	MWorker *w = tls_pWorker;
+	if (w == nullptr)
+		return WaitForSingleObject(p->hDone, dwTimeout);
+
+	// a worker doesn't block, it executes other tasks meanwhile
+	uint32_t dwStart = GetTickCount();
+	while (WaitForSingleObject(p->hDone, 0) == WAIT_TIMEOUT) {
+		if (dwTimeout != INFINITE && GetTickCount() - dwStart >= dwTimeout)
+			return WAIT_TIMEOUT;
+
+		if (MTask *pOther = FindTask(w))
+			RunTask(w, pOther);
+		else
+			WaitForSingleObject(p->hDone, 1);
+	}
+	return WAIT_OBJECT_0;
+}
+
+MIR_CORE_DLL(void) Task_Close(HANDLE hTask)
+{
+	if (hTask != nullptr)
+		ReleaseTask((MTask *)hTask);
+}
+
+MIR_CORE_DLL(bool) Task_IsCancelled(void)
+{
+	MWorker *w = tls_pWorker;
+	return w != nullptr && w->pCurrent != nullptr && w->pCurrent->bCancelled;
+}
+
+MIR_CORE_DLL(int) Task_CancelOwner(void *owner, uint32_t dwTimeout)
+{
+	if (owner == nullptr || g_hSemaphore == nullptr)
+		return 0;
+
+	// drop all queued tasks
+	LIST<MTask> arCancelled(10);
+	for (auto &it : g_queues)
+		it.extract(owner, arCancelled);
+
+	for (auto &w : g_workers)
+		if (w != nullptr)
+			w->deque.extract(owner, arCancelled);
+
+	for (auto &it : arCancelled)
+		CompleteTask(it, TASK_CANCELLED);
+
+	int nCancelled = arCancelled.getCount();
+
+	// and wait for the running ones, including those suspended in Task_Wait. a claimed
+	// task won't be started, but it still needs to be completed by its worker
+	uint32_t dwStart = GetTickCount();
+	for (;;) {
+		bool bRunning = false;
+		{
+			mir_cslock lck(csTasks);
+			for (auto &w : g_workers) {
+				if (w == nullptr || w == tls_pWorker)
+					continue;
+
+				for (MTask *p = w->pCurrent; p != nullptr; p = p->pOuter) {
+					if (p->pOwner == owner) {
+						p->bCancelled = true;
+						bRunning = true;
+					}
+				}
+
+				if (MTask *p = w->pClaimed) {
+					if (p->pOwner == owner) {
+						if (!p->bCancelled) {
+							p->bCancelled = true;
+							nCancelled++;
+						}
+						bRunning = true;
+					}
+				}
+			}
+		}
+
+		if (!bRunning || GetTickCount() - dwStart >= dwTimeout)
+			break;
+
+		SleepEx(10, TRUE);
+	}
+
+	return nCancelled;
+}
@@ -208,7 +208,7 @@ MIR_CORE_DLL(HANDLE) mir_forkthreadowner(pThreadFuncOwner aFunc, void *owner, vo
 
 /////////////////////////////////////////////////////////////////////////////////////////
 
-static void __cdecl KillObjectThreadsWorker(void* owner)
+static void KillOwnerThreads(void *owner)
 {
 	HANDLE *threadPool = (HANDLE*)alloca(threads.getCount() * sizeof(HANDLE));
 	int threadCount = 0;
@@ -244,14 +244,29 @@ static void __cdecl KillObjectThreadsWorker(void* owner)
 	}
 }
 
+static unsigned __stdcall KillObjectThreadsWorker(void *owner)
+{
+	// pool tasks cannot be killed: drop the queued ones at once and wait for the running ones
+	// as long as needed, because the owner is destroyed right after KillObjectThreads() returns
+	Task_CancelOwner(owner, 0);
+
+	KillOwnerThreads(owner);
+
+	Task_CancelOwner(owner, INFINITE);
+	return 0;
+}
+
 MIR_CORE_DLL(void) KillObjectThreads(void* owner)
 {
 	if (owner == nullptr)
 		return;
 
-	uint32_t dwTicks = GetTickCount() + 6000;
-	HANDLE hThread = mir_forkthread(KillObjectThreadsWorker, owner);
-	while (GetTickCount() < dwTicks) {
+	// the owner's threads are killed in 5 seconds, so only its pool tasks may keep us here longer
+	HANDLE hThread = mir_forkthreadex(KillObjectThreadsWorker, owner);
+	if (hThread == nullptr)
+		return;
+
+	for (;;) {
 		int res = MsgWaitForMultipleObjectsEx(1, &hThread, 50, QS_ALLPOSTMESSAGE | QS_ALLINPUT, MWMO_ALERTABLE);
 		if (res == WAIT_OBJECT_0 || res == WAIT_FAILED)
 			break;
@@ -262,6 +277,8 @@ MIR_CORE_DLL(void) KillObjectThreads(void* owner)
 			DispatchMessage(&msg);
 		}
 	}
+
+	CloseHandle(hThread);
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////
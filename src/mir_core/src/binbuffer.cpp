@@ -41,6 +41,20 @@ void MBinBuffer::append(const void *pBuf, size_t bufLen)
 	else m_len = 0;
 }
 
+char* MBinBuffer::appendSpace(size_t bufLen)
+{
+	if (bufLen == 0)
+		return nullptr;
+
+	char *p = (char*)mir_realloc(m_buf, bufLen + m_len);
+	if (p == nullptr)
+		return nullptr;
+
+	m_buf = p;
+	m_len += bufLen;
+	return m_buf + m_len - bufLen;
+}
+
 void MBinBuffer::appendBefore(const void *pBuf, size_t bufLen)
 {
 	if (pBuf == nullptr || bufLen == 0)